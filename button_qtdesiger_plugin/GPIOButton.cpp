@@ -2,18 +2,19 @@
 #include <string>
 #include <QTimer>
 #include <QDebug>
-#include <sys/shm.h>
 #include "GPIOButton.h"
 
 GPIOButton::GPIOButton(QWidget *parent) : QPushButton(parent),
     gpio_pin_(0),
-    click_duration_(100)
+    pin_numbering_(WiringPi),
+    board_rev_(1),
+    click_duration_(100),
+    pin_info_(NULL)
 {
 
     //Connect to GPIO shared memory
-    key_t key = ftok("/proc/cpuinfo",0x84);
-    int shmid = shmget(key, sizeof(shared_gpio_state), 0666);
-    gpio_state = (shared_gpio_state*)shmat(shmid, (void *)0, 0);
+    gpio_state = shared_gpio_state_attach();
+    if (gpio_state == NULL) qDebug() << "Error connecting to shared memory";
 
     set_gpio_pin(gpio_pin_);
     set_click_duration(click_duration_);
@@ -28,12 +29,36 @@ int GPIOButton::gpio_pin(){
     return gpio_pin_;
 }
 
+GPIOButton::PinNumbering GPIOButton::pin_numbering(){
+    return pin_numbering_;
+}
+
+int GPIOButton::board_rev(){
+    return board_rev_;
+}
+
 int GPIOButton::click_duration(){
     return click_duration_;
 }
 
 void GPIOButton::set_gpio_pin(int pin){
     gpio_pin_=pin;
+    update_pin_info();
+}
+
+void GPIOButton::set_pin_numbering(PinNumbering pin_numbering){
+    pin_numbering_=pin_numbering;
+    update_pin_info();
+}
+
+void GPIOButton::set_board_rev(int board_rev){
+    board_rev_=board_rev;
+    update_pin_info();
+}
+
+void GPIOButton::update_pin_info(){
+    pin_info_ = gpio_board_map_lookup(pin_numbering_, board_rev_, gpio_pin_);
+    if (pin_info_ == NULL) qDebug() << "GPIOButton: pin" << gpio_pin_ << "is not connected on this board";
 }
 
 void GPIOButton::set_click_duration(int duration){
@@ -44,12 +69,9 @@ void GPIOButton::set_click_duration(int duration){
 void GPIOButton::set_gpio(bool state){
 
 
-   if (get_gpio_pin_function() == 0){
+   if (get_gpio_pin_function() == GPIO_FSEL_INPUT){
        qDebug() << "Set pin " << gpio_pin_ << " to " << (state?"1":"0");
-        if (state)
-            gpio_state->GPLEV0 |= (1 << gpio_to_bcm2835_map[gpio_pin_]);
-        else
-            gpio_state->GPLEV0 &= (~(1 << gpio_to_bcm2835_map[gpio_pin_]));
+        gpio_pin_set_level(gpio_state, pin_info_, state);
     }
 
     update();
@@ -72,15 +94,8 @@ void GPIOButton::click_timeout(){
 int GPIOButton::
 get_gpio_pin_function(){
 
-  int pin = gpio_to_bcm2835_map[gpio_pin_];
+  if (gpio_state == NULL || pin_info_ == NULL) return -1;
 
-  if (pin<10)            return ((gpio_state->GPFSEL0 >> (3*pin))      & 0x7);
-  if (pin>=10 && pin<20) return ((gpio_state->GPFSEL1 >> (3*(pin-10))) & 0x7);
-  if (pin>=20 && pin<30) return ((gpio_state->GPFSEL2 >> (3*(pin-20))) & 0x7);
-  if (pin>=30 && pin<40) return ((gpio_state->GPFSEL3 >> (3*(pin-30))) & 0x7);
-  if (pin>=40 && pin<50) return ((gpio_state->GPFSEL4 >> (3*(pin-40))) & 0x7);
-  return ((gpio_state->GPFSEL5 >> (3*(pin-50))) & 0x7);
+  return gpio_pin_function(gpio_state, pin_info_);
 
 }
-
-
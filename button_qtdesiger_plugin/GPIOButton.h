@@ -6,20 +6,35 @@
 #include <QPushButton>
 #include <QMouseEvent>
 
+#include "gpio_board_map.h"
+
 class GPIOButton : public QPushButton
 {
     Q_OBJECT
 
     Q_PROPERTY(int gpio_pin READ gpio_pin WRITE set_gpio_pin)
+    Q_PROPERTY(PinNumbering pin_numbering READ pin_numbering WRITE set_pin_numbering)
+    Q_PROPERTY(int board_rev READ board_rev WRITE set_board_rev)
     Q_PROPERTY(int click_duration READ click_duration WRITE set_click_duration)
+    Q_ENUMS(PinNumbering)
 
 public:
+    enum PinNumbering {
+        WiringPi = GPIO_NUMBERING_WIRINGPI,
+        BCM      = GPIO_NUMBERING_BCM,
+        Physical = GPIO_NUMBERING_PHYSICAL
+    };
+
     GPIOButton(QWidget *parent = 0);
     ~GPIOButton();
 
     int gpio_pin();
+    PinNumbering pin_numbering();
+    int board_rev();
     int click_duration();
     void set_gpio_pin(int pin);
+    void set_pin_numbering(PinNumbering pin_numbering);
+    void set_board_rev(int board_rev);
     void set_click_duration(int duration);
     void set_gpio(bool state);
     int get_gpio_pin_function();
@@ -34,27 +49,17 @@ protected:
 private:
 
     int gpio_pin_;
+    PinNumbering pin_numbering_;
+    int board_rev_;  // 1 by default, matching the original wiringPi 0-7 map
     int click_duration_;
 
-    struct shared_gpio_state {
+    // Register lookup for the bound pin, NULL if it isn't on the header
+    const gpio_pin_info *pin_info_;
 
-      unsigned int GPFSEL0;
-      unsigned int GPFSEL1;
-      unsigned int GPFSEL2;
-      unsigned int GPFSEL3;
-      unsigned int GPFSEL4;
-      unsigned int GPFSEL5;
-      unsigned int GPLEV0;
-      unsigned int GPLEV1;
-      unsigned int outstate0;
-      unsigned int outstate1;
+    void update_pin_info();
 
-    };
     shared_gpio_state *gpio_state;
 
-    const int gpio_to_bcm2835_map[8] = {17,18,21,22,23,24,25,4};
-
-
 };
 
 #endif // SQUARE_H
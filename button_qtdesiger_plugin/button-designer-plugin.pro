@@ -17,11 +17,13 @@ TARGET = $$qtLibraryTarget($$TARGET)
 target.path = $$[QT_INSTALL_PLUGINS]/designer
 INSTALLS += target
 
-INCLUDEPATH += .
+INCLUDEPATH += . ../gpio_common
 
 # Input
 HEADERS += \
     GPIOButton.h \
+    ../gpio_common/shared_gpio_state.h \
+    ../gpio_common/gpio_board_map.h \
     GPIOButtonPlugin.h
 SOURCES += \
     GPIOButton.cpp \
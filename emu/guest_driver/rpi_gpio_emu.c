@@ -0,0 +1,478 @@
+/*
+ * rpi_gpio_emu.c - guest driver for QEMU's emulated BCM2835 GPIO block
+ *
+ * The rpi_gpio device that QEMU maps at 0x20200000 on versatilepb has the
+ * BCM2835 register layout and raises one interrupt (SIC line 10) whenever
+ * a GPEDS bit is set.  This driver registers it as a gpiochip with an
+ * irqchip, so that
+ *
+ *   - on 4.4 the sysfs interface works, which is what wiringPi's "gpio"
+ *     command, wiringPiSetupSys() and wiringPiISR() use;
+ *   - on 4.8 and later the gpiochip character device works too, giving
+ *     kernel-timestamped line events and multi-line get/set requests
+ *     without /dev/mem or root.
+ *
+ * Lines are numbered like the BCM GPIOs (base=0 by default).
+ *
+ * Licensed under the GPL version 2.
+ */
+
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/platform_device.h>
+#include <linux/of.h>
+#include <linux/io.h>
+#include <linux/irq.h>
+#include <linux/irqchip/chained_irq.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/gpio/driver.h>
+
+#define RPI_GPIO_NR	54
+
+#define GPFSEL0		0x00
+#define GPSET0		0x1c
+#define GPCLR0		0x28
+#define GPLEV0		0x34
+#define GPEDS0		0x40
+#define GPREN0		0x4c
+#define GPFEN0		0x58
+#define GPHEN0		0x64
+#define GPLEN0		0x70
+
+#define BANK(n)		((n) / 32)
+#define BIT_OF(n)	BIT((n) % 32)
+#define REG(r, n)	((r) + 4 * BANK(n))
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+#define RPI_GPIO_DOMAIN(gc)	((gc)->irq.domain)
+#else
+#define RPI_GPIO_DOMAIN(gc)	((gc)->irqdomain)
+#endif
+
+/* Used when the kernel has no device tree (the 4.4 versatilepb kernel):
+ * IRQ_SIC_START (64) + SIC line 10.
+ */
+static unsigned long mem = 0x20200000;
+module_param(mem, ulong, 0444);
+MODULE_PARM_DESC(mem, "Physical base of the rpi_gpio block (non-DT kernels)");
+
+static int irq = 74;
+module_param(irq, int, 0444);
+MODULE_PARM_DESC(irq, "Linux IRQ of the rpi_gpio block (non-DT kernels), 0 for none");
+
+static int base;
+module_param(base, int, 0444);
+MODULE_PARM_DESC(base, "First GPIO number, -1 for dynamic");
+
+struct rpi_gpio_emu {
+	struct gpio_chip gc;
+	void __iomem *base;
+	spinlock_t lock;
+	u32 out[2];		/* GPLEV only reflects inputs in the model */
+	unsigned int type[RPI_GPIO_NR];
+	u32 requested[2];	/* lines in use as interrupts */
+	u32 enabled[2];		/* of those, the unmasked ones */
+};
+
+static struct rpi_gpio_emu *to_rge(struct gpio_chip *gc)
+{
+	return container_of(gc, struct rpi_gpio_emu, gc);
+}
+
+static void rge_rmw(struct rpi_gpio_emu *rge, unsigned int reg, u32 clr, u32 set)
+{
+	u32 v = readl(rge->base + reg);
+
+	writel((v & ~clr) | set, rge->base + reg);
+}
+
+static int rge_fsel(struct rpi_gpio_emu *rge, unsigned int off)
+{
+	return (readl(rge->base + GPFSEL0 + 4 * (off / 10)) >> (3 * (off % 10))) & 7;
+}
+
+static void rge_set_fsel(struct rpi_gpio_emu *rge, unsigned int off, u32 fsel)
+{
+	unsigned int shift = 3 * (off % 10);
+
+	rge_rmw(rge, GPFSEL0 + 4 * (off / 10), 7 << shift, fsel << shift);
+}
+
+static void rge_write(struct rpi_gpio_emu *rge, int bank, u32 mask, u32 bits)
+{
+	rge->out[bank] = (rge->out[bank] & ~mask) | (bits & mask);
+	if (bits & mask)
+		writel(bits & mask, rge->base + GPSET0 + 4 * bank);
+	if (~bits & mask)
+		writel(~bits & mask, rge->base + GPCLR0 + 4 * bank);
+}
+
+static int rge_get_direction(struct gpio_chip *gc, unsigned int off)
+{
+	return rge_fsel(to_rge(gc), off) == 1 ? 0 : 1;
+}
+
+static int rge_direction_input(struct gpio_chip *gc, unsigned int off)
+{
+	struct rpi_gpio_emu *rge = to_rge(gc);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	rge_set_fsel(rge, off, 0);
+	spin_unlock_irqrestore(&rge->lock, flags);
+	return 0;
+}
+
+static int rge_direction_output(struct gpio_chip *gc, unsigned int off, int value)
+{
+	struct rpi_gpio_emu *rge = to_rge(gc);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	rge_write(rge, BANK(off), BIT_OF(off), value ? BIT_OF(off) : 0);
+	rge_set_fsel(rge, off, 1);
+	spin_unlock_irqrestore(&rge->lock, flags);
+	return 0;
+}
+
+static int rge_get(struct gpio_chip *gc, unsigned int off)
+{
+	struct rpi_gpio_emu *rge = to_rge(gc);
+
+	if (rge_fsel(rge, off) == 1)
+		return !!(rge->out[BANK(off)] & BIT_OF(off));
+	return !!(readl(rge->base + REG(GPLEV0, off)) & BIT_OF(off));
+}
+
+static void rge_set(struct gpio_chip *gc, unsigned int off, int value)
+{
+	struct rpi_gpio_emu *rge = to_rge(gc);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	rge_write(rge, BANK(off), BIT_OF(off), value ? BIT_OF(off) : 0);
+	spin_unlock_irqrestore(&rge->lock, flags);
+}
+
+/* One GPSET and one GPCLR write per bank, however many lines change */
+static void rge_set_multiple(struct gpio_chip *gc, unsigned long *mask,
+			     unsigned long *bits)
+{
+	struct rpi_gpio_emu *rge = to_rge(gc);
+	unsigned long flags;
+	u32 m[2], b[2];
+	int bank;
+
+#if BITS_PER_LONG == 64
+	m[0] = mask[0];
+	m[1] = mask[0] >> 32;
+	b[0] = bits[0];
+	b[1] = bits[0] >> 32;
+#else
+	m[0] = mask[0];
+	m[1] = mask[1];
+	b[0] = bits[0];
+	b[1] = bits[1];
+#endif
+
+	spin_lock_irqsave(&rge->lock, flags);
+	for (bank = 0; bank < 2; bank++)
+		if (m[bank])
+			rge_write(rge, bank, m[bank], b[bank]);
+	spin_unlock_irqrestore(&rge->lock, flags);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+/* One GPLEV read per bank */
+static int rge_get_multiple(struct gpio_chip *gc, unsigned long *mask,
+			    unsigned long *bits)
+{
+	struct rpi_gpio_emu *rge = to_rge(gc);
+	u32 lev[2], out[2] = { 0, 0 };
+	int i;
+
+	for (i = 0; i < RPI_GPIO_NR; i++)
+		if (test_bit(i, mask) && rge_fsel(rge, i) == 1)
+			out[BANK(i)] |= BIT_OF(i);
+
+	lev[0] = (readl(rge->base + GPLEV0) & ~out[0]) | (rge->out[0] & out[0]);
+	lev[1] = (readl(rge->base + GPLEV0 + 4) & ~out[1]) | (rge->out[1] & out[1]);
+
+	for (i = 0; i < RPI_GPIO_NR; i++)
+		if (test_bit(i, mask)) {
+			if (lev[BANK(i)] & BIT_OF(i))
+				__set_bit(i, bits);
+			else
+				__clear_bit(i, bits);
+		}
+	return 0;
+}
+#endif
+
+/* Program the detect enables for one line from its trigger type.
+ *
+ * Edge detection stays on while the line is masked, so an edge in that
+ * time is latched in GPEDS and replayed by the edge flow handler when the
+ * line is unmasked; masking only stops the chained handler dispatching
+ * it.  Level detection is switched off, as a held level would keep
+ * setting GPEDS, and comes back with the level on unmask anyway.
+ */
+static void rge_program(struct rpi_gpio_emu *rge, unsigned int off)
+{
+	unsigned int type = rge->type[off];
+	bool used = rge->requested[BANK(off)] & BIT_OF(off);
+	bool on = used && (rge->enabled[BANK(off)] & BIT_OF(off));
+	u32 bit = BIT_OF(off);
+
+	rge_rmw(rge, REG(GPREN0, off), bit, used && (type & IRQ_TYPE_EDGE_RISING) ? bit : 0);
+	rge_rmw(rge, REG(GPFEN0, off), bit, used && (type & IRQ_TYPE_EDGE_FALLING) ? bit : 0);
+	rge_rmw(rge, REG(GPHEN0, off), bit, on && (type & IRQ_TYPE_LEVEL_HIGH) ? bit : 0);
+	rge_rmw(rge, REG(GPLEN0, off), bit, on && (type & IRQ_TYPE_LEVEL_LOW) ? bit : 0);
+}
+
+static unsigned int rge_irq_startup(struct irq_data *d)
+{
+	struct rpi_gpio_emu *rge = to_rge(irq_data_get_irq_chip_data(d));
+	unsigned int off = irqd_to_hwirq(d);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	writel(BIT_OF(off), rge->base + REG(GPEDS0, off));
+	rge->requested[BANK(off)] |= BIT_OF(off);
+	rge->enabled[BANK(off)] |= BIT_OF(off);
+	rge_program(rge, off);
+	spin_unlock_irqrestore(&rge->lock, flags);
+	return 0;
+}
+
+static void rge_irq_shutdown(struct irq_data *d)
+{
+	struct rpi_gpio_emu *rge = to_rge(irq_data_get_irq_chip_data(d));
+	unsigned int off = irqd_to_hwirq(d);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	rge->requested[BANK(off)] &= ~BIT_OF(off);
+	rge->enabled[BANK(off)] &= ~BIT_OF(off);
+	rge_program(rge, off);
+	writel(BIT_OF(off), rge->base + REG(GPEDS0, off));
+	spin_unlock_irqrestore(&rge->lock, flags);
+}
+
+static void rge_irq_ack(struct irq_data *d)
+{
+	struct rpi_gpio_emu *rge = to_rge(irq_data_get_irq_chip_data(d));
+	unsigned int off = irqd_to_hwirq(d);
+
+	writel(BIT_OF(off), rge->base + REG(GPEDS0, off));
+}
+
+static void rge_irq_mask(struct irq_data *d)
+{
+	struct rpi_gpio_emu *rge = to_rge(irq_data_get_irq_chip_data(d));
+	unsigned int off = irqd_to_hwirq(d);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	rge->enabled[BANK(off)] &= ~BIT_OF(off);
+	rge_program(rge, off);
+	spin_unlock_irqrestore(&rge->lock, flags);
+}
+
+static void rge_irq_unmask(struct irq_data *d)
+{
+	struct rpi_gpio_emu *rge = to_rge(irq_data_get_irq_chip_data(d));
+	unsigned int off = irqd_to_hwirq(d);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	rge->enabled[BANK(off)] |= BIT_OF(off);
+	rge_program(rge, off);
+	spin_unlock_irqrestore(&rge->lock, flags);
+}
+
+static int rge_irq_set_type(struct irq_data *d, unsigned int type)
+{
+	struct rpi_gpio_emu *rge = to_rge(irq_data_get_irq_chip_data(d));
+	unsigned int off = irqd_to_hwirq(d);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rge->lock, flags);
+	rge->type[off] = type & IRQ_TYPE_SENSE_MASK;
+	rge_program(rge, off);
+	spin_unlock_irqrestore(&rge->lock, flags);
+
+	if (type & IRQ_TYPE_LEVEL_MASK)
+		irq_set_handler_locked(d, handle_level_irq);
+	else
+		irq_set_handler_locked(d, handle_edge_irq);
+	return 0;
+}
+
+static struct irq_chip rge_irq_chip = {
+	.name		= "rpi_gpio",
+	.irq_startup	= rge_irq_startup,
+	.irq_shutdown	= rge_irq_shutdown,
+	.irq_ack	= rge_irq_ack,
+	.irq_mask	= rge_irq_mask,
+	.irq_unmask	= rge_irq_unmask,
+	.irq_set_type	= rge_irq_set_type,
+};
+
+static void rge_irq_handler(struct irq_desc *desc)
+{
+	struct gpio_chip *gc = irq_desc_get_handler_data(desc);
+	struct irq_chip *chip = irq_desc_get_chip(desc);
+	struct rpi_gpio_emu *rge = to_rge(gc);
+	unsigned long pending;
+	int bank, bit;
+
+	/* Masked lines are dispatched too: the flow handler sees they are
+	 * masked or disabled, marks them pending and acks them, rather than
+	 * leaving GPEDS set and the parent interrupt asserted
+	 */
+	chained_irq_enter(chip, desc);
+	for (bank = 0; bank < 2; bank++) {
+		pending = readl(rge->base + GPEDS0 + 4 * bank) & rge->requested[bank];
+		for_each_set_bit(bit, &pending, 32)
+			generic_handle_irq(irq_find_mapping(RPI_GPIO_DOMAIN(gc),
+							    bank * 32 + bit));
+	}
+	chained_irq_exit(chip, desc);
+}
+
+static int rge_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct rpi_gpio_emu *rge;
+	struct resource *res;
+	int parent_irq, ret;
+
+	rge = devm_kzalloc(dev, sizeof(*rge), GFP_KERNEL);
+	if (!rge)
+		return -ENOMEM;
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	rge->base = devm_ioremap_resource(dev, res);
+	if (IS_ERR(rge->base))
+		return PTR_ERR(rge->base);
+
+	spin_lock_init(&rge->lock);
+
+	/* Nothing is enabled until a line is requested as an interrupt */
+	writel(0, rge->base + GPREN0);
+	writel(0, rge->base + GPREN0 + 4);
+	writel(0, rge->base + GPFEN0);
+	writel(0, rge->base + GPFEN0 + 4);
+	writel(0, rge->base + GPHEN0);
+	writel(0, rge->base + GPHEN0 + 4);
+	writel(0, rge->base + GPLEN0);
+	writel(0, rge->base + GPLEN0 + 4);
+	writel(~0, rge->base + GPEDS0);
+	writel(~0, rge->base + GPEDS0 + 4);
+
+	rge->gc.label = "rpi_gpio";
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 5, 0)
+	rge->gc.parent = dev;
+#else
+	rge->gc.dev = dev;
+#endif
+	rge->gc.owner = THIS_MODULE;
+	rge->gc.base = base;
+	rge->gc.ngpio = RPI_GPIO_NR;
+	rge->gc.get_direction = rge_get_direction;
+	rge->gc.direction_input = rge_direction_input;
+	rge->gc.direction_output = rge_direction_output;
+	rge->gc.get = rge_get;
+	rge->gc.set = rge_set;
+	rge->gc.set_multiple = rge_set_multiple;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+	rge->gc.get_multiple = rge_get_multiple;
+#endif
+
+	ret = gpiochip_add(&rge->gc);
+	if (ret)
+		return ret;
+
+	parent_irq = platform_get_irq(pdev, 0);
+	if (parent_irq > 0) {
+		ret = gpiochip_irqchip_add(&rge->gc, &rge_irq_chip, 0,
+					   handle_edge_irq, IRQ_TYPE_NONE);
+		if (ret) {
+			gpiochip_remove(&rge->gc);
+			return ret;
+		}
+		gpiochip_set_chained_irqchip(&rge->gc, &rge_irq_chip, parent_irq,
+					     rge_irq_handler);
+	} else {
+		dev_warn(dev, "no interrupt, line events unavailable\n");
+	}
+
+	platform_set_drvdata(pdev, rge);
+	dev_info(dev, "%d lines at %pa, irq %d\n", RPI_GPIO_NR, &res->start, parent_irq);
+	return 0;
+}
+
+static int rge_remove(struct platform_device *pdev)
+{
+	struct rpi_gpio_emu *rge = platform_get_drvdata(pdev);
+
+	gpiochip_remove(&rge->gc);
+	return 0;
+}
+
+static const struct of_device_id rge_of_match[] = {
+	{ .compatible = "qemu,rpi-gpio" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, rge_of_match);
+
+static struct platform_driver rge_driver = {
+	.probe	= rge_probe,
+	.remove	= rge_remove,
+	.driver	= {
+		.name		= "rpi_gpio",
+		.of_match_table	= rge_of_match,
+	},
+};
+
+static struct platform_device *rge_pdev;
+
+static int __init rge_init(void)
+{
+	struct resource res[2] = {
+		DEFINE_RES_MEM(mem, 0x1000),
+		DEFINE_RES_IRQ(irq),
+	};
+	int ret;
+
+	ret = platform_driver_register(&rge_driver);
+	if (ret)
+		return ret;
+
+	/* Device tree kernels describe the block themselves (rpi_gpio.dtsi) */
+	if (of_have_populated_dt())
+		return 0;
+
+	rge_pdev = platform_device_register_simple("rpi_gpio", -1, res,
+						   irq > 0 ? 2 : 1);
+	if (IS_ERR(rge_pdev)) {
+		platform_driver_unregister(&rge_driver);
+		return PTR_ERR(rge_pdev);
+	}
+	return 0;
+}
+
+static void __exit rge_exit(void)
+{
+	if (rge_pdev)
+		platform_device_unregister(rge_pdev);
+	platform_driver_unregister(&rge_driver);
+}
+
+module_init(rge_init);
+module_exit(rge_exit);
+
+MODULE_DESCRIPTION("QEMU rpi_gpio (emulated BCM2835 GPIO) driver");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,177 @@
+/*
+ * gpio_board_map.h
+ *
+ * Pin numbering and register lookup shared by the host-side GPIO tools.
+ *
+ * Translates wiringPi, physical header and BCM pin numbers to a BCM2835 GPIO
+ * (0-53) for either board revision, and gives each BCM GPIO a precomputed
+ * entry saying which GPFSEL register and shift hold its function and which
+ * bank and bit hold its level, so that polling a pin is a couple of table
+ * lookups rather than a chain of range checks.
+ *
+ * The wiringPi and physical tables are the ones in wiringEmuPi/wiringPi/wiringPi.c.
+ */
+
+#ifndef GPIO_BOARD_MAP_H
+#define GPIO_BOARD_MAP_H
+
+#include <stdint.h>
+#include "shared_gpio_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_NUM_BCM_PINS 54
+#define GPIO_NUM_MAP_PINS 64
+
+// Pin numbering schemes
+
+#define GPIO_NUMBERING_WIRINGPI 0
+#define GPIO_NUMBERING_BCM      1
+#define GPIO_NUMBERING_PHYSICAL 2
+
+// Function select values (3 bits per pin in GPFSELn)
+
+#define GPIO_FSEL_INPUT  0
+#define GPIO_FSEL_OUTPUT 1
+
+typedef struct gpio_pin_info {
+
+  uint8_t  fsel ;   // GPFSEL register index (0-5)
+  uint8_t  shift ;  // bit offset of the 3 function bits within it
+  uint8_t  bank ;   // GPLEV/OUTSTATE register index (0-1)
+  uint32_t mask ;   // bit within that bank
+
+} gpio_pin_info ;
+
+#define GPIO_PIN_INFO(n) { (n) / 10, ((n) % 10) * 3, (n) >> 5, 1u << ((n) & 31) }
+
+static const gpio_pin_info gpio_pin_info_table [GPIO_NUM_BCM_PINS] =
+{
+  GPIO_PIN_INFO( 0), GPIO_PIN_INFO( 1), GPIO_PIN_INFO( 2), GPIO_PIN_INFO( 3), GPIO_PIN_INFO( 4),
+  GPIO_PIN_INFO( 5), GPIO_PIN_INFO( 6), GPIO_PIN_INFO( 7), GPIO_PIN_INFO( 8), GPIO_PIN_INFO( 9),
+  GPIO_PIN_INFO(10), GPIO_PIN_INFO(11), GPIO_PIN_INFO(12), GPIO_PIN_INFO(13), GPIO_PIN_INFO(14),
+  GPIO_PIN_INFO(15), GPIO_PIN_INFO(16), GPIO_PIN_INFO(17), GPIO_PIN_INFO(18), GPIO_PIN_INFO(19),
+  GPIO_PIN_INFO(20), GPIO_PIN_INFO(21), GPIO_PIN_INFO(22), GPIO_PIN_INFO(23), GPIO_PIN_INFO(24),
+  GPIO_PIN_INFO(25), GPIO_PIN_INFO(26), GPIO_PIN_INFO(27), GPIO_PIN_INFO(28), GPIO_PIN_INFO(29),
+  GPIO_PIN_INFO(30), GPIO_PIN_INFO(31), GPIO_PIN_INFO(32), GPIO_PIN_INFO(33), GPIO_PIN_INFO(34),
+  GPIO_PIN_INFO(35), GPIO_PIN_INFO(36), GPIO_PIN_INFO(37), GPIO_PIN_INFO(38), GPIO_PIN_INFO(39),
+  GPIO_PIN_INFO(40), GPIO_PIN_INFO(41), GPIO_PIN_INFO(42), GPIO_PIN_INFO(43), GPIO_PIN_INFO(44),
+  GPIO_PIN_INFO(45), GPIO_PIN_INFO(46), GPIO_PIN_INFO(47), GPIO_PIN_INFO(48), GPIO_PIN_INFO(49),
+  GPIO_PIN_INFO(50), GPIO_PIN_INFO(51), GPIO_PIN_INFO(52), GPIO_PIN_INFO(53),
+} ;
+
+#undef GPIO_PIN_INFO
+
+// wiringPi pin -> BCM GPIO, revision 1 and revision 2 boards
+
+static const int8_t gpio_wpi_to_bcm [2][GPIO_NUM_MAP_PINS] =
+{
+  {
+    17, 18, 21, 22, 23, 24, 25,  4,	// wpi  0 -  7
+     0,  1,				// I2C
+     8,  7,				// SPI CE1, CE0
+    10,  9, 11,				// SPI MOSI, MISO, SCLK
+    14, 15,				// UART Tx, Rx
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  },
+  {
+    17, 18, 27, 22, 23, 24, 25,  4,	// wpi  0 -  7
+     2,  3,				// I2C
+     8,  7,				// SPI CE1, CE0
+    10,  9, 11,				// SPI MOSI, MISO, SCLK
+    14, 15,				// UART Tx, Rx
+    28, 29, 30, 31,			// Rev 2 P5 header
+     5,  6, 13, 19, 26,			// B+
+    12, 16, 20, 21,			// B+
+     0,  1,				// B+
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  },
+} ;
+
+// Physical header pin -> BCM GPIO, revision 1 and revision 2 boards
+
+static const int8_t gpio_phys_to_bcm [2][GPIO_NUM_MAP_PINS] =
+{
+  {
+    -1,
+    -1, -1,  0, -1,  1, -1,  4, 14, -1, 15, 17, 18, 21, -1,	//  1 - 14
+    22, 23, -1, 24, 10, -1,  9, 25, 11,  8, -1,  7,		// 15 - 26
+                    -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  },
+  {
+    -1,
+    -1, -1,  2, -1,  3, -1,  4, 14, -1, 15, 17, 18, 27, -1,	//  1 - 14
+    22, 23, -1, 24, 10, -1,  9, 25, 11,  8, -1,  7,		// 15 - 26
+     0,  1,  5, -1,  6, 12, 13, -1, 19, 16, 26, 20, -1, 21,	// 27 - 40 (B+)
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 28, 29, 30, 31,	// P5 header
+    -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  },
+} ;
+
+// Translate a pin in the given numbering scheme to a BCM GPIO.
+//	Returns -1 if the pin is not connected on that board revision.
+
+static inline int gpio_board_map_to_bcm (int numbering, int board_rev, int pin)
+{
+  int rev = (board_rev == 1) ? 0 : 1 ;
+
+  if ((pin < 0) || (pin >= GPIO_NUM_MAP_PINS))
+    return -1 ;
+
+  switch (numbering)
+  {
+    case GPIO_NUMBERING_WIRINGPI:
+      return gpio_wpi_to_bcm [rev][pin] ;
+    case GPIO_NUMBERING_PHYSICAL:
+      return gpio_phys_to_bcm [rev][pin] ;
+    case GPIO_NUMBERING_BCM:
+      return (pin < GPIO_NUM_BCM_PINS) ? pin : -1 ;
+    default:
+      return -1 ;
+  }
+}
+
+// Look up the register/bank entry for a pin, or NULL if it is not connected.
+
+static inline const gpio_pin_info *gpio_board_map_lookup (int numbering, int board_rev, int pin)
+{
+  int bcm = gpio_board_map_to_bcm (numbering, board_rev, pin) ;
+
+  return (bcm < 0) ? NULL : &gpio_pin_info_table [bcm] ;
+}
+
+static inline int gpio_pin_function (const volatile shared_gpio_state *s, const gpio_pin_info *p)
+{
+  return (s->GPFSEL [p->fsel] >> p->shift) & 0x7 ;
+}
+
+static inline int gpio_pin_output (const volatile shared_gpio_state *s, const gpio_pin_info *p)
+{
+  return (s->OUTSTATE [p->bank] & p->mask) != 0 ;
+}
+
+static inline int gpio_pin_level (const volatile shared_gpio_state *s, const gpio_pin_info *p)
+{
+  return (s->GPLEV [p->bank] & p->mask) != 0 ;
+}
+
+static inline void gpio_pin_set_level (volatile shared_gpio_state *s, const gpio_pin_info *p, int level)
+{
+  if (level)
+    s->GPLEV [p->bank] |= p->mask ;
+  else
+    s->GPLEV [p->bank] &= ~p->mask ;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * shared_gpio_state.h
+ *
+ * Layout of the SysV shared memory segment that the rpi_gpio device in QEMU
+ * (qemu/hw/gpio/rpi_gpio.c) publishes to host-side tools such as the Qt
+ * designer plugins and the test programs.  The field order must match the
+ * shared_gpio_state struct in rpi_gpio.c.
+ *
+ * With -global rpi_gpio.pv=on the segment is a whole page that the guest
+ * also maps, read only, to read pin levels without leaving translated code.
+ * The guest's own output writes go to a page of its own, and QEMU publishes
+ * them here like any other.
+ */
+
+#ifndef SHARED_GPIO_STATE_H
+#define SHARED_GPIO_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shared_gpio_state {
+
+  uint32_t GPFSEL[6];    // Function Select, 10 pins per register
+  uint32_t GPLEV[2];     // Input level for pins 0-31 / 32-53 (written by the host)
+  uint32_t OUTSTATE[2];  // Output state for pins 0-31 / 32-53 (written by QEMU)
+
+  // Running totals kept by QEMU for benchmarks; use the difference
+  // between two samples
+
+  uint64_t MMIO_READS;   // Guest register reads, each an exit from translated code
+  uint64_t MMIO_WRITES;  // Guest register writes
+  uint64_t OUTPUT_EDGES; // Level changes on output pins
+
+  uint32_t SEQ;          // Odd while QEMU updates GPFSEL/OUTSTATE, see below
+  uint32_t WAITERS;      // Readers blocked in shared_gpio_state_wait
+  int64_t CHANGE_NS;     // CLOCK_MONOTONIC of the last change, updated with it
+  int64_t INPUT_NS;      // CLOCK_MONOTONIC of the host's last GPLEV write, optional:
+                         // set it after changing GPLEV and rpi_gpio's input-latency
+                         // statistic times the guest's reaction from then
+
+  uint32_t PV_MASK[2];   // Under pv, written by QEMU for the guest: the GPLEV bits
+  uint32_t PV_LEV[2];    // it does not take from the host, and their levels
+
+} shared_gpio_state;
+
+// Path and project id used by QEMU to create the segment.  With several
+// QEMUs on one host each has its own id (-global rpi_gpio.shm-id=...), and
+// host programs are pointed at one with the RPI_GPIO_SHM_ID environment
+// variable.
+
+#define SHARED_GPIO_STATE_PATH  "/proc/cpuinfo"
+#define SHARED_GPIO_STATE_ID    0x84
+#define SHARED_GPIO_STATE_ENV   "RPI_GPIO_SHM_ID"
+
+// Attach to the segment created by QEMU.  Returns NULL if QEMU is not running
+// (or has not created the segment yet).
+
+static inline shared_gpio_state *shared_gpio_state_attach (void)
+{
+  key_t key ;
+  int shmid, id = SHARED_GPIO_STATE_ID ;
+  const char *env ;
+  void *ptr ;
+
+  if ((env = getenv (SHARED_GPIO_STATE_ENV)) != NULL && *env)
+    id = (int)strtol (env, NULL, 0) ;
+
+  key = ftok (SHARED_GPIO_STATE_PATH, id) ;
+  if ((shmid = shmget (key, sizeof (shared_gpio_state), 0666)) == -1)
+    return NULL ;
+
+  ptr = shmat (shmid, NULL, 0) ;
+  if (ptr == (void *)-1)
+    return NULL ;
+
+  return (shared_gpio_state *)ptr ;
+}
+
+// Take a consistent copy of the segment: QEMU makes SEQ odd while it
+// changes GPFSEL and OUTSTATE.  Returns the number of retries it took, or
+// -1 if QEMU kept updating it (or stopped halfway).
+
+#define SHARED_GPIO_STATE_RETRIES 1000
+
+static inline int shared_gpio_state_snapshot (const shared_gpio_state *shm, shared_gpio_state *copy)
+{
+  uint32_t seq ;
+  int retries ;
+
+  for (retries = 0 ; retries < SHARED_GPIO_STATE_RETRIES ; ++retries)
+  {
+    seq = __atomic_load_n (&shm->SEQ, __ATOMIC_ACQUIRE) ;
+    if (seq & 1)
+      continue ;
+    memcpy (copy, (const void *)shm, sizeof (*copy)) ;
+    __atomic_thread_fence (__ATOMIC_ACQUIRE) ;
+    if (__atomic_load_n (&shm->SEQ, __ATOMIC_RELAXED) == seq)
+      return retries ;
+  }
+  return -1 ;
+}
+
+// Block until GPFSEL or OUTSTATE changes from the state seen at seq (as
+// returned in a snapshot), instead of polling.  Returns the new SEQ, which
+// is still seq if timeout_ms ran out first (or was interrupted).
+
+static inline uint32_t shared_gpio_state_wait (shared_gpio_state *shm, uint32_t seq, int timeout_ms)
+{
+  struct timespec ts ;
+  uint32_t now ;
+
+  ts.tv_sec  = timeout_ms / 1000 ;
+  ts.tv_nsec = (timeout_ms % 1000) * 1000000L ;
+
+// QEMU only makes the wake up call when it sees waiters, so announce
+//	this one before looking at SEQ for the last time
+
+  __atomic_fetch_add (&shm->WAITERS, 1, __ATOMIC_SEQ_CST) ;
+  now = __atomic_load_n (&shm->SEQ, __ATOMIC_SEQ_CST) ;
+  while ((now == seq) || (now & 1))
+  {
+    if (syscall (SYS_futex, &shm->SEQ, FUTEX_WAIT, now, &ts, NULL, 0) != 0 && (errno == ETIMEDOUT || errno == EINTR))
+      break ;
+    now = __atomic_load_n (&shm->SEQ, __ATOMIC_SEQ_CST) ;
+  }
+  __atomic_fetch_sub (&shm->WAITERS, 1, __ATOMIC_SEQ_CST) ;
+
+  return __atomic_load_n (&shm->SEQ, __ATOMIC_SEQ_CST) ;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * shared_hd44780_state.h
+ *
+ * Layout of the SysV shared memory segment that the rpi-hd44780 device in
+ * QEMU (qemu/hw/display/rpi_hd44780.c) publishes after every write to the
+ * display.  The field order must match the shared_hd44780_state struct in
+ * rpi_hd44780.c.
+ *
+ * QEMU makes seq odd while it updates the segment, so readers copy it out
+ * and retry until they see the same even seq before and after.
+ */
+
+#ifndef SHARED_HD44780_STATE_H
+#define SHARED_HD44780_STATE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shared_hd44780_state {
+
+  uint32_t seq ;          // Odd while QEMU is updating
+  uint8_t rows ;
+  uint8_t cols ;
+  uint8_t display ;       // Display on
+  uint8_t cursor ;        // Underline cursor on
+  uint8_t blink ;         // Blinking block cursor on
+  uint8_t cursor_row ;    // 0xff when the cursor is off screen
+  uint8_t cursor_col ;
+  uint8_t pad ;
+  uint8_t text[4][40] ;   // Visible characters, rows x cols are used
+  uint8_t cgram[8][8] ;   // User defined characters 0-7, 5 bits per row
+
+} shared_hd44780_state ;
+
+// Path and project id used by QEMU to create the segment (the shm-id
+// property of the device overrides the id)
+
+#define SHARED_HD44780_STATE_PATH  "/proc/cpuinfo"
+#define SHARED_HD44780_STATE_ID    0x85
+
+// Attach to the segment created by QEMU.  Returns NULL if there is no
+// display attached to the running QEMU.
+
+static inline shared_hd44780_state *shared_hd44780_state_attach (int id)
+{
+  key_t key ;
+  int shmid ;
+  void *ptr ;
+
+  key = ftok (SHARED_HD44780_STATE_PATH, id) ;
+  if ((shmid = shmget (key, sizeof (shared_hd44780_state), 0666)) == -1)
+    return NULL ;
+
+  ptr = shmat (shmid, NULL, 0) ;
+  if (ptr == (void *)-1)
+    return NULL ;
+
+  return (shared_hd44780_state *)ptr ;
+}
+
+// Take a consistent copy of the segment.  Returns 0 if QEMU kept updating it.
+
+static inline int shared_hd44780_state_read (const shared_hd44780_state *shm, shared_hd44780_state *copy)
+{
+  uint32_t seq ;
+  int tries ;
+
+  for (tries = 0 ; tries < 100 ; ++tries)
+  {
+    seq = __atomic_load_n (&shm->seq, __ATOMIC_ACQUIRE) ;
+    if (seq & 1)
+      continue ;
+    memcpy (copy, (const void *)shm, sizeof (*copy)) ;
+    __atomic_thread_fence (__ATOMIC_ACQUIRE) ;
+    if (__atomic_load_n (&shm->seq, __ATOMIC_RELAXED) == seq)
+      return 1 ;
+  }
+  return 0 ;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
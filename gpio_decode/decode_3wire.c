@@ -0,0 +1,97 @@
+/*
+ * decode_3wire.c
+ *
+ * DS1302 style 3-wire serial interface (devLib/ds1302.c): CE high frames a
+ * transfer, bits are LSB first on a single I/O line and are valid on the
+ * rising edge of CLK.  The first byte of a transfer is the command byte.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gpio_decode.h"
+
+enum { CE, CLK, IO } ;
+
+static const char *const roles [] = { "ce", "clk", "io", NULL } ;
+
+struct threewire
+{
+  int active ;
+  int bits ;
+  int value ;
+  int nbytes ;
+  int read ;
+} ;
+
+
+static void threewire_byte (gpio_decoder *d, int64_t t)
+{
+  struct threewire *w = d->priv ;
+  int cmd = w->value ;
+
+  if (w->nbytes++ != 0)
+  {
+    gpio_decode_byte (d, t, "%s 0x%02X", w->read ? "RD" : "WR", w->value) ;
+    return ;
+  }
+
+  w->read = cmd & 1 ;
+  if ((cmd & 0x80) == 0)
+  {
+    ++d->errors ;
+    gpio_decode_byte (d, t, "CMD 0x%02X (bit 7 clear: write protected)", cmd) ;
+  }
+  else if (((cmd >> 1) & 0x1F) == 0x1F)
+    gpio_decode_byte (d, t, "CMD 0x%02X %s %s burst", cmd,
+      w->read ? "read" : "write", (cmd & 0x40) ? "ram" : "clock") ;
+  else
+    gpio_decode_byte (d, t, "CMD 0x%02X %s %s %d", cmd,
+      w->read ? "read" : "write", (cmd & 0x40) ? "ram" : "clock", (cmd >> 1) & 0x1F) ;
+}
+
+static void threewire_sample (gpio_decoder *d, int64_t t, const uint32_t *prev, const uint32_t *lev)
+{
+  struct threewire *w = d->priv ;
+
+  if (gpio_decode_rose (d, prev, lev, CE))
+  {
+    memset (w, 0, sizeof (*w)) ;
+    w->active = 1 ;
+    return ;
+  }
+
+  if (gpio_decode_fell (d, prev, lev, CE))
+  {
+    if (w->bits != 0)
+    {
+      ++d->errors ;
+      gpio_decode_note (d, t, "ERR %d stray bits", w->bits) ;
+    }
+    if (w->nbytes != 0)
+      ++d->frames ;
+    w->active = 0 ;
+    return ;
+  }
+
+  if (!w->active || !gpio_decode_rose (d, prev, lev, CLK))
+    return ;
+
+  w->value |= gpio_decode_pin (d, prev, IO) << w->bits ;
+  if (++w->bits == 8)
+  {
+    threewire_byte (d, t) ;
+    w->bits = 0 ;
+    w->value = 0 ;
+  }
+}
+
+const gpio_decoder_type gpio_decoder_3wire =
+{
+  .name      = "3wire",
+  .usage     = "ce=,clk=,io=   (DS1302)",
+  .roles     = roles,
+  .nrequired = 3,
+  .priv_size = sizeof (struct threewire),
+  .sample    = threewire_sample,
+} ;
@@ -0,0 +1,216 @@
+/*
+ * decode_hd44780.c
+ *
+ * HD44780 character LCD, as driven by devLib/lcd.c.  Data is latched on the
+ * falling edge of E.  Like the real controller we start in 8-bit mode and
+ * follow the DL bit of Function Set, so the 4-bit initialisation sequence
+ * in lcdInit() (three 0x3 nibbles, then 0x2) is decoded the same way the
+ * display sees it.  The display RAM is tracked so the final screen can be
+ * printed and compared in a test.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpio_decode.h"
+
+enum { RS, E, D0, D1, D2, D3, D4, D5, D6, D7 } ;
+
+static const char *const roles [] =
+  { "rs", "e", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", NULL } ;
+
+static const int rowOff [4] = { 0x00, 0x40, 0x14, 0x54 } ;
+
+struct hd44780
+{
+  int wide ;			// All of d0-d7 are wired
+  int dl ;			// Controller interface is 8 bits
+  int have_nibble ;
+  int nibble ;
+  int rows, cols ;
+  int addr ;
+  int increment ;
+  int cgram ;
+  unsigned char ddram [128] ;
+} ;
+
+
+static int hd44780_option (gpio_decoder *d, const char *key, const char *value)
+{
+  struct hd44780 *h = d->priv ;
+
+  if (strcmp (key, "rows") == 0)
+    h->rows = atoi (value) ;
+  else if (strcmp (key, "cols") == 0)
+    h->cols = atoi (value) ;
+  else
+    return -1 ;
+
+  return 0 ;
+}
+
+static int hd44780_start (gpio_decoder *d)
+{
+  struct hd44780 *h = d->priv ;
+  int i ;
+
+  if ((d->pins [D4] < 0) || (d->pins [D5] < 0) || (d->pins [D6] < 0) || (d->pins [D7] < 0))
+  {
+    fprintf (stderr, "hd44780: d4-d7 are required\n") ;
+    return -1 ;
+  }
+
+  h->wide = 1 ;
+  for (i = D0 ; i <= D3 ; ++i)
+    if (d->pins [i] < 0)
+      h->wide = 0 ;
+
+  if ((h->rows < 1) || (h->rows > 4)) h->rows = 2 ;
+  if ((h->cols < 1) || (h->cols > 40)) h->cols = 16 ;
+
+  h->dl = 1 ;
+  h->increment = 1 ;
+  memset (h->ddram, ' ', sizeof (h->ddram)) ;
+  return 0 ;
+}
+
+static void hd44780_command (gpio_decoder *d, int64_t t, int cmd)
+{
+  struct hd44780 *h = d->priv ;
+
+  if (cmd & 0x80)
+  {
+    h->addr = cmd & 0x7F ;
+    h->cgram = 0 ;
+    gpio_decode_byte (d, t, "CMD 0x%02X ddram 0x%02X", cmd, h->addr) ;
+  }
+  else if (cmd & 0x40)
+  {
+    h->cgram = 1 ;
+    gpio_decode_byte (d, t, "CMD 0x%02X cgram 0x%02X", cmd, cmd & 0x3F) ;
+  }
+  else if (cmd & 0x20)
+  {
+    h->dl = (cmd >> 4) & 1 ;
+    gpio_decode_byte (d, t, "CMD 0x%02X function %d-bit %d-line", cmd,
+      h->dl ? 8 : 4, (cmd & 0x08) ? 2 : 1) ;
+  }
+  else if (cmd & 0x10)
+    gpio_decode_byte (d, t, "CMD 0x%02X shift", cmd) ;
+  else if (cmd & 0x08)
+    gpio_decode_byte (d, t, "CMD 0x%02X display %s cursor %s blink %s", cmd,
+      (cmd & 4) ? "on" : "off", (cmd & 2) ? "on" : "off", (cmd & 1) ? "on" : "off") ;
+  else if (cmd & 0x04)
+  {
+    h->increment = (cmd >> 1) & 1 ;
+    gpio_decode_byte (d, t, "CMD 0x%02X entry", cmd) ;
+  }
+  else if (cmd & 0x02)
+  {
+    h->addr = 0 ;
+    h->cgram = 0 ;
+    gpio_decode_byte (d, t, "CMD 0x%02X home", cmd) ;
+  }
+  else if (cmd & 0x01)
+  {
+    h->addr = 0 ;
+    h->cgram = 0 ;
+    h->increment = 1 ;
+    memset (h->ddram, ' ', sizeof (h->ddram)) ;
+    gpio_decode_byte (d, t, "CMD 0x%02X clear", cmd) ;
+  }
+  else
+    gpio_decode_byte (d, t, "CMD 0x%02X", cmd) ;
+}
+
+static void hd44780_data (gpio_decoder *d, int64_t t, int data)
+{
+  struct hd44780 *h = d->priv ;
+
+  if (h->cgram)
+  {
+    gpio_decode_byte (d, t, "DATA 0x%02X cgram", data) ;
+    return ;
+  }
+
+  gpio_decode_byte (d, t, "DATA 0x%02X '%c'", data, ((data >= 0x20) && (data < 0x7F)) ? data : '.') ;
+  h->ddram [h->addr] = data ;
+  h->addr = (h->addr + (h->increment ? 1 : -1)) & 0x7F ;
+}
+
+static void hd44780_sample (gpio_decoder *d, int64_t t, const uint32_t *prev, const uint32_t *lev)
+{
+  struct hd44780 *h = d->priv ;
+  int i, value ;
+
+  if (!gpio_decode_fell (d, prev, lev, E))
+    return ;
+
+// RS and the data lines are set up well before E drops, so prev is what the
+//	controller latches
+
+  value = 0 ;
+  for (i = D7 ; i >= D0 ; --i)
+    value = (value << 1) | gpio_decode_pin (d, prev, i) ;
+
+  if (h->dl)
+  {
+    if (!h->wide)
+      value &= 0xF0 ;		// D0-D3 are not connected
+  }
+  else
+  {
+    value >>= 4 ;
+    if (!h->have_nibble)
+    {
+      h->nibble = value ;
+      h->have_nibble = 1 ;
+      return ;
+    }
+    value = (h->nibble << 4) | value ;
+    h->have_nibble = 0 ;
+  }
+
+  if (gpio_decode_pin (d, prev, RS))
+    hd44780_data (d, t, value) ;
+  else
+  {
+    hd44780_command (d, t, value) ;
+    ++d->frames ;
+  }
+}
+
+static void hd44780_finish (gpio_decoder *d)
+{
+  struct hd44780 *h = d->priv ;
+  int row, col ;
+
+  if (d->bytes == 0)
+    return ;
+
+  fprintf (d->out, "%s screen:\n", d->label) ;
+  for (row = 0 ; row < h->rows ; ++row)
+  {
+    fputs ("  |", d->out) ;
+    for (col = 0 ; col < h->cols ; ++col)
+    {
+      int c = h->ddram [(rowOff [row] + col) & 0x7F] ;
+      fputc (((c >= 0x20) && (c < 0x7F)) ? c : '.', d->out) ;
+    }
+    fputs ("|\n", d->out) ;
+  }
+}
+
+const gpio_decoder_type gpio_decoder_hd44780 =
+{
+  .name      = "hd44780",
+  .usage     = "rs=,e=,d4=..d7= [d0=..d3=] [rows=2] [cols=16]",
+  .roles     = roles,
+  .nrequired = 2,
+  .priv_size = sizeof (struct hd44780),
+  .option    = hd44780_option,
+  .start     = hd44780_start,
+  .sample    = hd44780_sample,
+  .finish    = hd44780_finish,
+} ;
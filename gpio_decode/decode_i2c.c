@@ -0,0 +1,88 @@
+/*
+ * decode_i2c.c
+ *
+ * Bit-banged I2C.  START/STOP are SDA edges while SCL is high, data bits
+ * are sampled on the rising edge of SCL, MSB first, with the 9th bit being
+ * the ACK (low) or NACK.  The first byte after a START is the address.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gpio_decode.h"
+
+enum { SCL, SDA } ;
+
+static const char *const roles [] = { "scl", "sda", NULL } ;
+
+struct i2c
+{
+  int active ;
+  int bits ;
+  int value ;
+  int nbytes ;
+} ;
+
+
+static void i2c_sample (gpio_decoder *d, int64_t t, const uint32_t *prev, const uint32_t *lev)
+{
+  struct i2c *c = d->priv ;
+  int ack ;
+
+  if (gpio_decode_pin (d, prev, SCL) && gpio_decode_pin (d, lev, SCL))
+  {
+    if (gpio_decode_fell (d, prev, lev, SDA))
+    {
+      gpio_decode_note (d, t, c->active ? "RESTART" : "START") ;
+      if (c->active && (c->nbytes != 0))
+        ++d->frames ;
+      memset (c, 0, sizeof (*c)) ;
+      c->active = 1 ;
+    }
+    else if (c->active && gpio_decode_rose (d, prev, lev, SDA))
+    {
+
+// The SCL rise that sets up a STOP looks like the first bit of a byte
+
+      if (c->bits > 1)
+      {
+        ++d->errors ;
+        gpio_decode_note (d, t, "ERR %d stray bits", c->bits) ;
+      }
+      if (c->nbytes != 0)
+        ++d->frames ;
+      gpio_decode_note (d, t, "STOP") ;
+      c->active = 0 ;
+    }
+    return ;
+  }
+
+  if (!c->active || !gpio_decode_rose (d, prev, lev, SCL))
+    return ;
+
+  if (c->bits < 8)
+  {
+    c->value = (c->value << 1) | gpio_decode_pin (d, prev, SDA) ;
+    c->bits++ ;
+    return ;
+  }
+
+  ack = !gpio_decode_pin (d, prev, SDA) ;
+  if (c->nbytes++ == 0)
+    gpio_decode_byte (d, t, "ADDR 0x%02X %c %s", c->value >> 1, (c->value & 1) ? 'R' : 'W', ack ? "ACK" : "NACK") ;
+  else
+    gpio_decode_byte (d, t, "DATA 0x%02X %s", c->value, ack ? "ACK" : "NACK") ;
+
+  c->bits = 0 ;
+  c->value = 0 ;
+}
+
+const gpio_decoder_type gpio_decoder_i2c =
+{
+  .name      = "i2c",
+  .usage     = "scl=,sda=",
+  .roles     = roles,
+  .nrequired = 2,
+  .priv_size = sizeof (struct i2c),
+  .sample    = i2c_sample,
+} ;
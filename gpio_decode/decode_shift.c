@@ -0,0 +1,109 @@
+/*
+ * decode_shift.c
+ *
+ * Clocked serial data with no framing: wiringShift.c shiftOut/shiftIn and
+ * 74x595 shift registers (sr595.c).  A word is emitted every "bits" clocks;
+ * if a latch pin is given, the register contents are also printed on every
+ * rising edge of the latch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpio_decode.h"
+
+enum { DATA, CLK, LATCH } ;
+
+static const char *const roles [] = { "data", "clk", "latch", NULL } ;
+
+struct shift
+{
+  int lsb_first ;
+  int falling ;
+  int width ;
+  int bits ;
+  uint32_t word ;
+  uint32_t reg ;		// What a 74x595 would hold, newest bit in bit 0
+  int reg_bits ;
+} ;
+
+
+static int shift_option (gpio_decoder *d, const char *key, const char *value)
+{
+  struct shift *s = d->priv ;
+
+  if (strcmp (key, "order") == 0)
+    s->lsb_first = (strcmp (value, "lsb") == 0) ;
+  else if (strcmp (key, "edge") == 0)
+    s->falling = (strcmp (value, "falling") == 0) ;
+  else if (strcmp (key, "bits") == 0)
+    s->width = atoi (value) ;
+  else
+    return -1 ;
+
+  return 0 ;
+}
+
+static int shift_start (gpio_decoder *d)
+{
+  struct shift *s = d->priv ;
+
+  if (s->width == 0)
+    s->width = 8 ;
+  if ((s->width < 1) || (s->width > 32))
+  {
+    fprintf (stderr, "shift: bits must be 1-32\n") ;
+    return -1 ;
+  }
+  return 0 ;
+}
+
+static void shift_sample (gpio_decoder *d, int64_t t, const uint32_t *prev, const uint32_t *lev)
+{
+  struct shift *s = d->priv ;
+  int bit ;
+
+  if (gpio_decode_rose (d, prev, lev, LATCH))
+  {
+    ++d->frames ;
+    gpio_decode_note (d, t, "LATCH 0x%0*X (%d bits)",
+      ((s->reg_bits > 32 ? 32 : s->reg_bits) + 3) / 4, s->reg, s->reg_bits) ;
+    s->reg_bits = 0 ;
+  }
+
+  if (s->falling ? !gpio_decode_fell (d, prev, lev, CLK) : !gpio_decode_rose (d, prev, lev, CLK))
+    return ;
+
+// shiftOut sets the data line before raising the clock; shiftIn reads it
+//	with the clock high, so the value before a falling edge is what it sees.
+
+  bit = gpio_decode_pin (d, prev, DATA) ;
+  s->reg = (s->reg << 1) | bit ;
+  s->reg_bits++ ;
+
+  if (s->lsb_first)
+    s->word |= (uint32_t)bit << s->bits ;
+  else
+    s->word = (s->word << 1) | bit ;
+
+  if (++s->bits == s->width)
+  {
+    gpio_decode_byte (d, t, "0x%0*X", (s->width + 3) / 4, s->word) ;
+    d->bytes += (s->width - 1) / 8 ;
+    s->bits = 0 ;
+    s->word = 0 ;
+  }
+}
+
+const gpio_decoder_type gpio_decoder_shift =
+{
+  .name      = "shift",
+  .usage     = "data=,clk= [latch=] [order=msb|lsb] [edge=rising|falling] [bits=8]",
+  .roles     = roles,
+  .nrequired = 2,
+  .priv_size = sizeof (struct shift),
+  .option    = shift_option,
+  .start     = shift_start,
+  .sample    = shift_sample,
+} ;
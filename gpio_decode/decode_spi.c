@@ -0,0 +1,123 @@
+/*
+ * decode_spi.c
+ *
+ * Bit-banged SPI.  CS (optional, active low) frames a transfer; MOSI and
+ * MISO are sampled on the edge selected by the SPI mode.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpio_decode.h"
+
+enum { SCLK, MOSI, MISO, CS } ;
+
+static const char *const roles [] = { "sclk", "mosi", "miso", "cs", NULL } ;
+
+struct spi
+{
+  int mode ;
+  int lsb_first ;
+  int active ;
+  int bits ;
+  int mosi, miso ;
+  int nbytes ;
+} ;
+
+
+static int spi_option (gpio_decoder *d, const char *key, const char *value)
+{
+  struct spi *s = d->priv ;
+
+  if (strcmp (key, "mode") == 0)
+    s->mode = atoi (value) & 3 ;
+  else if (strcmp (key, "order") == 0)
+    s->lsb_first = (strcmp (value, "lsb") == 0) ;
+  else
+    return -1 ;
+
+  return 0 ;
+}
+
+static int spi_start (gpio_decoder *d)
+{
+  struct spi *s = d->priv ;
+
+  if ((d->pins [MOSI] < 0) && (d->pins [MISO] < 0))
+  {
+    fprintf (stderr, "spi: need at least one of mosi= and miso=\n") ;
+    return -1 ;
+  }
+  s->active = (d->pins [CS] < 0) ;
+  return 0 ;
+}
+
+static void spi_sample (gpio_decoder *d, int64_t t, const uint32_t *prev, const uint32_t *lev)
+{
+  struct spi *s = d->priv ;
+  int sample_rising = ((s->mode >> 1) ^ (s->mode & 1)) == 0 ;
+  int mosi, miso ;
+
+  if (gpio_decode_fell (d, prev, lev, CS))
+  {
+    s->active = 1 ;
+    s->bits = s->mosi = s->miso = s->nbytes = 0 ;
+    return ;
+  }
+
+  if (gpio_decode_rose (d, prev, lev, CS))
+  {
+    if (s->bits != 0)
+    {
+      ++d->errors ;
+      gpio_decode_note (d, t, "ERR %d stray bits", s->bits) ;
+    }
+    if (s->nbytes != 0)
+      ++d->frames ;
+    s->active = 0 ;
+    return ;
+  }
+
+  if (!s->active)
+    return ;
+  if (sample_rising ? !gpio_decode_rose (d, prev, lev, SCLK) : !gpio_decode_fell (d, prev, lev, SCLK))
+    return ;
+
+  mosi = gpio_decode_pin (d, prev, MOSI) ;
+  miso = gpio_decode_pin (d, prev, MISO) ;
+  if (s->lsb_first)
+  {
+    s->mosi |= mosi << s->bits ;
+    s->miso |= miso << s->bits ;
+  }
+  else
+  {
+    s->mosi = (s->mosi << 1) | mosi ;
+    s->miso = (s->miso << 1) | miso ;
+  }
+
+  if (++s->bits == 8)
+  {
+    if (d->pins [MISO] < 0)
+      gpio_decode_byte (d, t, "MOSI 0x%02X", s->mosi) ;
+    else if (d->pins [MOSI] < 0)
+      gpio_decode_byte (d, t, "MISO 0x%02X", s->miso) ;
+    else
+      gpio_decode_byte (d, t, "MOSI 0x%02X MISO 0x%02X", s->mosi, s->miso) ;
+    s->nbytes++ ;
+    s->bits = s->mosi = s->miso = 0 ;
+  }
+}
+
+const gpio_decoder_type gpio_decoder_spi =
+{
+  .name      = "spi",
+  .usage     = "sclk=,mosi=|miso= [cs=] [mode=0] [order=msb|lsb]",
+  .roles     = roles,
+  .nrequired = 1,
+  .priv_size = sizeof (struct spi),
+  .option    = spi_option,
+  .start     = spi_start,
+  .sample    = spi_sample,
+} ;
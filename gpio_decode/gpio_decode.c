@@ -0,0 +1,282 @@
+/*
+ * gpio_decode.c
+ *
+ * Decode bit-banged protocols from a VCD dump of the emulated GPIO pins.
+ *
+ * Usage: gpio-decode [-q] [-n bcm|wpi|phys] [-r board_rev] [-i file.vcd] decoder:spec ...
+ *
+ *   qemu-system-arm ... -global rpi_gpio.vcd=gpio.vcd
+ *   gpio-decode -i gpio.vcd hd44780:rs=25,e=24,d4=23,d5=17,d6=18,d7=22
+ *
+ * Each decoder spec is a comma separated list of role=pin and option=value
+ * pairs; label=<name> changes the name printed on each line.  Decoded lines
+ * go to stdout, throughput statistics to stderr.  With no -i the VCD is read
+ * from stdin, so QEMU can write straight into a FIFO.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../gpio_common/gpio_board_map.h"
+#include "gpio_decode.h"
+
+#define MAX_DECODERS	16
+
+static const gpio_decoder_type *decoder_types [] =
+{
+  &gpio_decoder_hd44780,
+  &gpio_decoder_3wire,
+  &gpio_decoder_shift,
+  &gpio_decoder_spi,
+  &gpio_decoder_i2c,
+  NULL
+} ;
+
+static gpio_decoder decoders [MAX_DECODERS] ;
+static int ndecoders ;
+
+
+static void decode_line (gpio_decoder *d, int64_t t, const char *fmt, va_list ap)
+{
+  if (d->quiet)
+    return ;
+
+  fprintf (d->out, "%lld %s ", (long long)t, d->label) ;
+  vfprintf (d->out, fmt, ap) ;
+  fputc ('\n', d->out) ;
+}
+
+void gpio_decode_byte (gpio_decoder *d, int64_t t, const char *fmt, ...)
+{
+  va_list ap ;
+
+  if (d->bytes++ == 0)
+    d->first_ns = t ;
+  d->last_ns = t ;
+
+  va_start (ap, fmt) ;
+  decode_line (d, t, fmt, ap) ;
+  va_end (ap) ;
+}
+
+void gpio_decode_note (gpio_decoder *d, int64_t t, const char *fmt, ...)
+{
+  va_list ap ;
+
+  va_start (ap, fmt) ;
+  decode_line (d, t, fmt, ap) ;
+  va_end (ap) ;
+}
+
+static void usage (const char *argv0)
+{
+  int i ;
+
+  fprintf (stderr, "Usage: %s [-q] [-n bcm|wpi|phys] [-r board_rev] [-i file.vcd] decoder:spec ...\n", argv0) ;
+  fprintf (stderr, "Decoders:\n") ;
+  for (i = 0 ; decoder_types [i] != NULL ; ++i)
+    fprintf (stderr, "  %-8s %s\n", decoder_types [i]->name, decoder_types [i]->usage) ;
+  exit (EXIT_FAILURE) ;
+}
+
+// Parse "<type>:key=value,key=value,..." into the next decoder slot
+
+static int add_decoder (char *spec, int numbering, int board_rev, int quiet)
+{
+  const gpio_decoder_type *type = NULL ;
+  gpio_decoder *d ;
+  char *args, *kv, *value, *save ;
+  int i, pin ;
+
+  if (ndecoders == MAX_DECODERS)
+  {
+    fprintf (stderr, "Too many decoders\n") ;
+    return -1 ;
+  }
+
+  if ((args = strchr (spec, ':')) != NULL)
+    *args++ = 0 ;
+
+  for (i = 0 ; decoder_types [i] != NULL ; ++i)
+    if (strcmp (decoder_types [i]->name, spec) == 0)
+      type = decoder_types [i] ;
+
+  if (type == NULL)
+  {
+    fprintf (stderr, "Unknown decoder: %s\n", spec) ;
+    return -1 ;
+  }
+
+  d = &decoders [ndecoders] ;
+  d->type  = type ;
+  d->label = type->name ;
+  d->out   = stdout ;
+  d->quiet = quiet ;
+  d->priv  = calloc (1, type->priv_size ? type->priv_size : 1) ;
+  for (i = 0 ; i < GPIO_DECODE_MAX_ROLES ; ++i)
+    d->pins [i] = -1 ;
+
+  for (kv = strtok_r (args, ",", &save) ; kv != NULL ; kv = strtok_r (NULL, ",", &save))
+  {
+    if ((value = strchr (kv, '=')) == NULL)
+    {
+      fprintf (stderr, "%s: expected key=value, got %s\n", type->name, kv) ;
+      return -1 ;
+    }
+    *value++ = 0 ;
+
+    if (strcmp (kv, "label") == 0)
+    {
+      d->label = value ;
+      continue ;
+    }
+
+    for (i = 0 ; type->roles [i] != NULL ; ++i)
+      if (strcmp (type->roles [i], kv) == 0)
+        break ;
+
+    if (type->roles [i] != NULL)
+    {
+      if ((pin = gpio_board_map_to_bcm (numbering, board_rev, atoi (value))) < 0)
+      {
+        fprintf (stderr, "%s: pin %s is not a GPIO\n", type->name, value) ;
+        return -1 ;
+      }
+      d->pins [i] = pin ;
+      d->mask [pin >> 5] |= 1u << (pin & 31) ;
+    }
+    else if ((type->option == NULL) || (type->option (d, kv, value) < 0))
+    {
+      fprintf (stderr, "%s: unknown option %s\n", type->name, kv) ;
+      return -1 ;
+    }
+  }
+
+  for (i = 0 ; i < type->nrequired ; ++i)
+    if (d->pins [i] < 0)
+    {
+      fprintf (stderr, "%s: %s= is required\n", type->name, type->roles [i]) ;
+      return -1 ;
+    }
+
+  if ((type->start != NULL) && (type->start (d) < 0))
+    return -1 ;
+
+  ++ndecoders ;
+  return 0 ;
+}
+
+static double now (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return ts.tv_sec + ts.tv_nsec / 1e9 ;
+}
+
+static void print_stats (uint64_t samples, int64_t span_ns, uint64_t in_bytes, double wall)
+{
+  gpio_decoder *d ;
+  double vt ;
+  int i ;
+
+  fprintf (stderr, "\n%-10s %10s %8s %6s %12s %12s\n", "decoder", "bytes", "frames", "errors", "span(us)", "bytes/s") ;
+  for (i = 0 ; i < ndecoders ; ++i)
+  {
+    d = &decoders [i] ;
+    vt = (d->last_ns - d->first_ns) / 1e9 ;
+    fprintf (stderr, "%-10s %10llu %8llu %6llu %12.1f %12.1f\n", d->label,
+      (unsigned long long)d->bytes, (unsigned long long)d->frames, (unsigned long long)d->errors,
+      vt * 1e6, (vt > 0) ? (d->bytes - 1) / vt : 0.0) ;
+  }
+
+  fprintf (stderr, "\n%llu samples over %.6f s of guest time; decoded in %.3f s (%.0f samples/s, %.1f MB/s)\n",
+    (unsigned long long)samples, span_ns / 1e9, wall,
+    (wall > 0) ? samples / wall : 0.0, (wall > 0) ? in_bytes / wall / 1e6 : 0.0) ;
+}
+
+int main (int argc, char *argv [])
+{
+  int opt, i, rc ;
+  int numbering = GPIO_NUMBERING_BCM ;
+  int board_rev = 2 ;
+  int quiet = 0 ;
+  FILE *in = stdin ;
+  vcd_reader *r ;
+  uint32_t prev [GPIO_DECODE_BANKS], lev [GPIO_DECODE_BANKS] ;
+  int64_t t, t0 = 0 ;
+  uint64_t samples = 0 ;
+  double start ;
+
+  while ((opt = getopt (argc, argv, "qn:r:i:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'q':
+        quiet = 1 ;
+        break ;
+      case 'n':
+        if      (strcmp (optarg, "bcm")  == 0) numbering = GPIO_NUMBERING_BCM ;
+        else if (strcmp (optarg, "wpi")  == 0) numbering = GPIO_NUMBERING_WIRINGPI ;
+        else if (strcmp (optarg, "phys") == 0) numbering = GPIO_NUMBERING_PHYSICAL ;
+        else usage (argv [0]) ;
+        break ;
+      case 'r':
+        board_rev = atoi (optarg) ;
+        break ;
+      case 'i':
+        if ((in = fopen (optarg, "r")) == NULL)
+        {
+          perror (optarg) ;
+          return EXIT_FAILURE ;
+        }
+        break ;
+      default:
+        usage (argv [0]) ;
+    }
+  }
+
+  if (optind == argc)
+    usage (argv [0]) ;
+
+  for (i = optind ; i < argc ; ++i)
+    if (add_decoder (argv [i], numbering, board_rev, quiet) < 0)
+      return EXIT_FAILURE ;
+
+  if ((r = vcd_reader_open (in)) == NULL)
+    return EXIT_FAILURE ;
+
+  memset (prev, 0, sizeof (prev)) ;
+  start = now () ;
+
+// Only wake the decoders whose pins changed
+
+  while ((rc = vcd_reader_next (r, &t, lev)) > 0)
+  {
+    if (samples++ == 0)
+      t0 = t ;
+
+    for (i = 0 ; i < ndecoders ; ++i)
+      if (((prev [0] ^ lev [0]) & decoders [i].mask [0]) || ((prev [1] ^ lev [1]) & decoders [i].mask [1]))
+        decoders [i].type->sample (&decoders [i], t, prev, lev) ;
+
+    memcpy (prev, lev, sizeof (prev)) ;
+  }
+
+  if (rc < 0)
+    fprintf (stderr, "VCD parse error after %llu bytes\n", (unsigned long long)vcd_reader_bytes (r)) ;
+
+  for (i = 0 ; i < ndecoders ; ++i)
+    if (decoders [i].type->finish != NULL)
+      decoders [i].type->finish (&decoders [i]) ;
+
+  fflush (stdout) ;
+  print_stats (samples, samples ? t - t0 : 0, vcd_reader_bytes (r), now () - start) ;
+
+  vcd_reader_close (r) ;
+  return (rc < 0) ? EXIT_FAILURE : EXIT_SUCCESS ;
+}
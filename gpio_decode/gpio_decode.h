@@ -0,0 +1,125 @@
+/*
+ * gpio_decode.h
+ *
+ * Streaming protocol decoders for bit-banged traffic on the emulated GPIO
+ * pins.  The input is a stream of pin level snapshots, one per point in time
+ * at which any pin changed (as written by the rpi_gpio device's VCD export,
+ * -global rpi_gpio.vcd=<file>).  Each decoder watches a handful of pins and
+ * prints what it decodes, one line per byte/command, prefixed with the
+ * virtual time in ns.
+ */
+
+#ifndef GPIO_DECODE_H
+#define GPIO_DECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define GPIO_DECODE_MAX_ROLES	12
+#define GPIO_DECODE_BANKS	2
+
+typedef struct gpio_decoder gpio_decoder ;
+
+typedef struct gpio_decoder_type
+{
+  const char *name ;
+  const char *usage ;
+  const char *const *roles ;		// NULL terminated pin role names
+  int nrequired ;			// The first nrequired roles must be given
+  size_t priv_size ;
+
+// Handle a non-pin key=value option.  Returns -1 if the key is unknown
+
+  int  (*option) (gpio_decoder *d, const char *key, const char *value) ;
+
+// Called once all options are known.  Returns -1 if the setup is unusable
+
+  int  (*start)  (gpio_decoder *d) ;
+
+// Called whenever one of the decoder's pins changed
+
+  void (*sample) (gpio_decoder *d, int64_t t, const uint32_t *prev, const uint32_t *lev) ;
+
+// Called at end of input, may be NULL
+
+  void (*finish) (gpio_decoder *d) ;
+} gpio_decoder_type ;
+
+struct gpio_decoder
+{
+  const gpio_decoder_type *type ;
+  const char *label ;			// Printed on every output line
+  int pins [GPIO_DECODE_MAX_ROLES] ;	// BCM pin per role, -1 if unused
+  uint32_t mask [GPIO_DECODE_BANKS] ;	// Bits of all used pins
+  FILE *out ;
+  int quiet ;				// Statistics only
+
+// Statistics
+
+  uint64_t bytes ;
+  uint64_t frames ;
+  uint64_t errors ;
+  int64_t  first_ns ;
+  int64_t  last_ns ;
+
+  void *priv ;
+} ;
+
+extern const gpio_decoder_type gpio_decoder_hd44780 ;
+extern const gpio_decoder_type gpio_decoder_3wire ;
+extern const gpio_decoder_type gpio_decoder_shift ;
+extern const gpio_decoder_type gpio_decoder_spi ;
+extern const gpio_decoder_type gpio_decoder_i2c ;
+
+
+static inline int gpio_decode_level (const uint32_t *lev, int pin)
+{
+  return (lev [pin >> 5] >> (pin & 31)) & 1 ;
+}
+
+static inline int gpio_decode_rose (const gpio_decoder *d, const uint32_t *prev, const uint32_t *lev, int role)
+{
+  int pin = d->pins [role] ;
+
+  return (pin >= 0) && !gpio_decode_level (prev, pin) && gpio_decode_level (lev, pin) ;
+}
+
+static inline int gpio_decode_fell (const gpio_decoder *d, const uint32_t *prev, const uint32_t *lev, int role)
+{
+  int pin = d->pins [role] ;
+
+  return (pin >= 0) && gpio_decode_level (prev, pin) && !gpio_decode_level (lev, pin) ;
+}
+
+static inline int gpio_decode_pin (const gpio_decoder *d, const uint32_t *lev, int role)
+{
+  int pin = d->pins [role] ;
+
+  return (pin >= 0) ? gpio_decode_level (lev, pin) : 0 ;
+}
+
+// Account for one decoded byte and print a line (unless quiet)
+
+extern void gpio_decode_byte (gpio_decoder *d, int64_t t, const char *fmt, ...)
+  __attribute__ ((format (printf, 3, 4))) ;
+
+// Print a line that does not carry a byte (start/stop conditions, errors)
+
+extern void gpio_decode_note (gpio_decoder *d, int64_t t, const char *fmt, ...)
+  __attribute__ ((format (printf, 3, 4))) ;
+
+
+// VCD input
+
+typedef struct vcd_reader vcd_reader ;
+
+extern vcd_reader *vcd_reader_open  (FILE *f) ;
+extern void        vcd_reader_close (vcd_reader *r) ;
+
+// Fetch the pin levels after all changes at the next timestamp.
+//	Returns 1 on success, 0 at end of input and -1 on a parse error.
+
+extern int         vcd_reader_next  (vcd_reader *r, int64_t *t, uint32_t *lev) ;
+extern uint64_t    vcd_reader_bytes (const vcd_reader *r) ;
+
+#endif
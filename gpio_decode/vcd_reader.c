@@ -0,0 +1,234 @@
+/*
+ * vcd_reader.c
+ *
+ * Minimal streaming Value Change Dump reader.  Only single bit variables
+ * named gpio<N> (as written by the rpi_gpio device) are tracked; anything
+ * else in the file is parsed and ignored.  The file is never loaded in
+ * full, so it can be a pipe or a FIFO that QEMU is still writing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "gpio_decode.h"
+
+#define VCD_BUF_SIZE	(1 << 16)
+#define VCD_TOKEN_MAX	256
+#define VCD_MAX_VARS	256
+
+struct vcd_var
+{
+  char id [16] ;
+  int pin ;
+} ;
+
+struct vcd_reader
+{
+  FILE *f ;
+  unsigned char buf [VCD_BUF_SIZE] ;
+  size_t len, pos ;
+  uint64_t consumed ;
+
+  int in_header ;
+  int pin_by_char [128] ;		// Fast path for single character ids
+  struct vcd_var vars [VCD_MAX_VARS] ;
+  int nvars ;
+
+  uint32_t lev [GPIO_DECODE_BANKS] ;
+  int64_t time ;
+  int have_time ;
+  int dirty ;				// Changes seen since the last #time
+} ;
+
+
+static int vcd_getc (vcd_reader *r)
+{
+  if (r->pos == r->len)
+  {
+    r->consumed += r->len ;
+    r->len = fread (r->buf, 1, VCD_BUF_SIZE, r->f) ;
+    r->pos = 0 ;
+    if (r->len == 0)
+      return EOF ;
+  }
+  return r->buf [r->pos++] ;
+}
+
+// Read the next whitespace separated token.  Returns its length, 0 at EOF
+
+static int vcd_token (vcd_reader *r, char *tok)
+{
+  int c, n = 0 ;
+
+  while (((c = vcd_getc (r)) != EOF) && isspace (c))
+    ;
+
+  while ((c != EOF) && !isspace (c))
+  {
+    if (n < VCD_TOKEN_MAX - 1)
+      tok [n++] = c ;
+    c = vcd_getc (r) ;
+  }
+  tok [n] = 0 ;
+  return n ;
+}
+
+static void vcd_skip_to_end (vcd_reader *r, char *tok)
+{
+  while (vcd_token (r, tok) && (strcmp (tok, "$end") != 0))
+    ;
+}
+
+static int vcd_lookup (vcd_reader *r, const char *id)
+{
+  int i ;
+
+  if ((id [1] == 0) && ((unsigned char)id [0] < 128))
+    return r->pin_by_char [(unsigned char)id [0]] ;
+
+  for (i = 0 ; i < r->nvars ; ++i)
+    if (strcmp (r->vars [i].id, id) == 0)
+      return r->vars [i].pin ;
+
+  return -1 ;
+}
+
+// $var <type> <size> <id> <reference> [<index>] $end
+
+static void vcd_parse_var (vcd_reader *r, char *tok)
+{
+  char id [16] ;
+  int size, pin ;
+
+  if (!vcd_token (r, tok)) return ;		// type
+  if (!vcd_token (r, tok)) return ;		// size
+  size = atoi (tok) ;
+  if (!vcd_token (r, tok)) return ;
+  snprintf (id, sizeof (id), "%.15s", tok) ;
+  if (!vcd_token (r, tok)) return ;
+
+  pin = -1 ;
+  if ((size == 1) && (strncasecmp (tok, "gpio", 4) == 0) && isdigit ((unsigned char)tok [4]))
+    pin = atoi (tok + 4) ;
+
+  if ((pin >= 0) && (pin < 32 * GPIO_DECODE_BANKS))
+  {
+    if ((id [1] == 0) && ((unsigned char)id [0] < 128))
+      r->pin_by_char [(unsigned char)id [0]] = pin ;
+    else if (r->nvars < VCD_MAX_VARS)
+    {
+      strcpy (r->vars [r->nvars].id, id) ;
+      r->vars [r->nvars].pin = pin ;
+      r->nvars++ ;
+    }
+  }
+
+  if (strcmp (tok, "$end") != 0)
+    vcd_skip_to_end (r, tok) ;
+}
+
+vcd_reader *vcd_reader_open (FILE *f)
+{
+  vcd_reader *r ;
+  int i ;
+
+  if ((r = calloc (1, sizeof (*r))) == NULL)
+    return NULL ;
+
+  r->f = f ;
+  r->in_header = 1 ;
+  for (i = 0 ; i < 128 ; ++i)
+    r->pin_by_char [i] = -1 ;
+
+  return r ;
+}
+
+void vcd_reader_close (vcd_reader *r)
+{
+  free (r) ;
+}
+
+uint64_t vcd_reader_bytes (const vcd_reader *r)
+{
+  return r->consumed + r->pos ;
+}
+
+int vcd_reader_next (vcd_reader *r, int64_t *t, uint32_t *lev)
+{
+  char tok [VCD_TOKEN_MAX] ;
+  int pin, value ;
+  int64_t next ;
+
+  while (vcd_token (r, tok))
+  {
+    if (tok [0] == '$')
+    {
+      if (strcmp (tok, "$var") == 0)
+        vcd_parse_var (r, tok) ;
+      else if (strcmp (tok, "$enddefinitions") == 0)
+      {
+        vcd_skip_to_end (r, tok) ;
+        r->in_header = 0 ;
+      }
+      else if (r->in_header || (strcmp (tok, "$comment") == 0))
+        vcd_skip_to_end (r, tok) ;
+
+// $dumpvars, $dumpall, $dumpon, $dumpoff and their $end carry no information we need
+
+      continue ;
+    }
+
+    if (r->in_header)
+      continue ;
+
+    switch (tok [0])
+    {
+      case '#':
+        next = strtoll (tok + 1, NULL, 10) ;
+        if (r->have_time && r->dirty && (next != r->time))
+        {
+          *t = r->time ;
+          memcpy (lev, r->lev, sizeof (r->lev)) ;
+          r->time = next ;
+          r->dirty = 0 ;
+          return 1 ;
+        }
+        r->time = next ;
+        r->have_time = 1 ;
+        break ;
+
+      case '0': case '1':
+      case 'x': case 'X': case 'z': case 'Z':
+        if ((pin = vcd_lookup (r, tok + 1)) < 0)
+          break ;
+        value = (tok [0] == '1') ;
+        if (value)
+          r->lev [pin >> 5] |=  (1u << (pin & 31)) ;
+        else
+          r->lev [pin >> 5] &= ~(1u << (pin & 31)) ;
+        r->dirty = 1 ;
+        break ;
+
+      case 'b': case 'B':
+      case 'r': case 'R':
+        vcd_token (r, tok) ;		// Vector/real values: skip the id
+        break ;
+
+      default:
+        return -1 ;
+    }
+  }
+
+  if (r->dirty)
+  {
+    *t = r->time ;
+    memcpy (lev, r->lev, sizeof (r->lev)) ;
+    r->dirty = 0 ;
+    return 1 ;
+  }
+
+  return 0 ;
+}
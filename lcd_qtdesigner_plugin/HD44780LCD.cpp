@@ -0,0 +1,204 @@
+#include <string.h>
+
+#include <QPainter>
+#include <QTimer>
+#include <QDebug>
+#include "HD44780LCD.h"
+
+// Size of one character cell in pixels, 5x8 dots plus a gap
+
+#define CELL_W 12
+#define CELL_H 18
+
+HD44780LCD::
+HD44780LCD(QWidget* parent) :
+	QWidget(parent),
+	color_(QColor(120, 190, 40)),
+	text_color_(QColor(20, 30, 10)),
+	shm_id_(SHARED_HD44780_STATE_ID),
+	refresh_rate_(50),
+	seq_(1),
+	blink_on_(false),
+	ticks_(0),
+	lcd_timer_(NULL),
+	lcd_state(NULL)
+{
+
+    memset(&state_, 0, sizeof(state_));
+    state_.rows = 2;
+    state_.cols = 16;
+
+    connect_lcd();
+
+    lcd_timer_ = new QTimer(this);
+    connect(lcd_timer_, SIGNAL(timeout()), this, SLOT(lcd_refresh()));
+
+    //start lcd readings
+    lcd_timer_->start(refresh_rate_);
+
+}
+
+HD44780LCD::
+~HD44780LCD()
+{
+    if (lcd_state != NULL) shmdt(lcd_state);
+}
+
+void HD44780LCD::
+connect_lcd()
+{
+
+    if (lcd_state != NULL) shmdt(lcd_state);
+
+    lcd_state = shared_hd44780_state_attach(shm_id_);
+    if (lcd_state == NULL) qDebug() << "HD44780LCD: no display in shared memory";
+
+    update();
+
+}
+
+QColor HD44780LCD::
+color() const
+{
+	return color_;
+}
+
+void HD44780LCD::
+setColor(const QColor& color)
+{
+	color_ = color;
+	update();
+}
+
+QColor HD44780LCD::
+text_color() const
+{
+	return text_color_;
+}
+
+void HD44780LCD::
+set_text_color(const QColor& text_color)
+{
+	text_color_ = text_color;
+	update();
+}
+
+void HD44780LCD::
+set_shm_id(int shm_id)
+{
+    shm_id_ = shm_id;
+    connect_lcd();
+}
+
+void HD44780LCD::
+set_refresh_rate(int refresh_rate)
+{
+    refresh_rate_ = refresh_rate;
+    if (lcd_timer_ != NULL) lcd_timer_->start(refresh_rate_);
+}
+
+int HD44780LCD::
+shm_id() const
+{
+    return shm_id_;
+}
+
+int HD44780LCD::
+refresh_rate() const
+{
+    return refresh_rate_;
+}
+
+void HD44780LCD::
+lcd_refresh()
+{
+    shared_hd44780_state copy;
+    bool blink_on;
+
+    // QEMU may only have been started after the widget
+    if (lcd_state == NULL) {
+        if (++ticks_ * refresh_rate_ >= 1000) {
+            ticks_ = 0;
+            lcd_state = shared_hd44780_state_attach(shm_id_);
+        }
+        return;
+    }
+
+    // The controller blinks the cursor at about 2Hz
+    blink_on = (++ticks_ * refresh_rate_ / 400) & 1;
+
+    if (!shared_hd44780_state_read(lcd_state, &copy)) return;
+    if (copy.seq == seq_ && (!copy.blink || blink_on == blink_on_)) return;
+
+    if (copy.rows != state_.rows || copy.cols != state_.cols) updateGeometry();
+    state_ = copy;
+    seq_ = copy.seq;
+    blink_on_ = blink_on;
+
+    update();
+}
+
+QSize HD44780LCD::
+sizeHint() const
+{
+	return QSize(state_.cols * CELL_W + CELL_W, state_.rows * CELL_H + CELL_H);
+}
+
+QSize HD44780LCD::
+minimumSizeHint() const
+{
+	return sizeHint();
+}
+
+void HD44780LCD::
+draw_pattern(QPainter& p, const QRect& cell, const uint8_t* rows)
+{
+    int dot_w = cell.width() / 6, dot_h = cell.height() / 9;
+    int r, c;
+
+    for (r = 0; r < 8; r++)
+        for (c = 0; c < 5; c++)
+            if ((rows[r] >> (4 - c)) & 1)
+                p.fillRect(cell.x() + c * dot_w, cell.y() + r * dot_h, dot_w - 1, dot_h - 1, text_color_);
+}
+
+void HD44780LCD::
+paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+	QPainter p(this);
+	int rows = qMin<int>(state_.rows, 4), cols = qMin<int>(state_.cols, 40);
+	int cell_w = width() / (cols + 1), cell_h = height() / (rows + 1);
+	int r, c;
+	uint8_t ch;
+
+	p.fillRect(rect(), color_);
+	if (!state_.display || lcd_state == NULL)
+		return;
+
+	QFont font("Monospace");
+	font.setStyleHint(QFont::TypeWriter);
+	font.setPixelSize(cell_h * 3 / 4);
+	p.setFont(font);
+	p.setPen(text_color_);
+
+	for (r = 0; r < rows; r++) {
+		for (c = 0; c < cols; c++) {
+			QRect cell(cell_w / 2 + c * cell_w, cell_h / 2 + r * cell_h, cell_w, cell_h);
+
+			ch = state_.text[r][c];
+			if (ch < 16)
+				draw_pattern(p, cell, state_.cgram[ch & 7]);
+			else if (ch >= 0x20 && ch < 0x7f)
+				p.drawText(cell, Qt::AlignCenter, QString(QChar(ch)));
+
+			if (r != state_.cursor_row || c != state_.cursor_col)
+				continue;
+			if (state_.blink && blink_on_)
+				p.fillRect(cell.adjusted(0, 0, -cell_w / 6, -cell_h / 9), text_color_);
+			if (state_.cursor)
+				p.fillRect(cell.x(), cell.y() + cell_h * 7 / 9, cell_w * 5 / 6, cell_h / 9, text_color_);
+		}
+	}
+}
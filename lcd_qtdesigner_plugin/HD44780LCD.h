@@ -0,0 +1,74 @@
+#ifndef _HD44780LCD_H_
+#define _HD44780LCD_H_
+
+#include <QtDesigner/QtDesigner>
+#include <QWidget>
+
+#include "shared_hd44780_state.h"
+
+class QTimer;
+
+//
+// Shows the text of the rpi-hd44780 device in QEMU.  Characters 0-7 are
+// drawn from the user defined patterns, everything else with a monospace
+// font.
+//
+class QDESIGNER_WIDGET_EXPORT HD44780LCD : public QWidget
+{
+	Q_OBJECT
+
+	Q_PROPERTY(QColor color READ color WRITE setColor)
+	Q_PROPERTY(QColor text_color READ text_color WRITE set_text_color)
+	Q_PROPERTY(int shm_id READ shm_id WRITE set_shm_id)
+	Q_PROPERTY(int refresh_rate READ refresh_rate WRITE set_refresh_rate)
+
+public:
+	explicit HD44780LCD(QWidget* parent=0);
+	~HD44780LCD();
+
+	QColor color() const;
+	void setColor(const QColor& color);
+
+	QColor text_color() const;
+	void set_text_color(const QColor& text_color);
+
+	void set_shm_id(int shm_id);
+	void set_refresh_rate(int refresh_rate);
+	int shm_id() const;
+	int refresh_rate() const;
+	void connect_lcd();
+
+public slots:
+	void lcd_refresh();
+
+public:
+	QSize sizeHint() const;
+	QSize minimumSizeHint() const;
+
+protected:
+	void paintEvent(QPaintEvent* event);
+
+private:
+	QColor color_;
+	QColor text_color_;
+	int shm_id_;
+	int refresh_rate_;
+
+	//
+	// Last consistent copy of the segment, and its seq so unchanged
+	// frames aren't repainted.
+	//
+	shared_hd44780_state state_;
+	uint32_t seq_;
+	bool blink_on_;
+	int ticks_;
+
+	QTimer* lcd_timer_;
+
+	void draw_pattern(QPainter& p, const QRect& cell, const uint8_t* rows);
+
+	shared_hd44780_state *lcd_state;
+
+};
+
+#endif
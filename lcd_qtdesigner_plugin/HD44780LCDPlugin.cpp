@@ -0,0 +1,63 @@
+#include "HD44780LCD.h"
+#include "HD44780LCDPlugin.h"
+
+#include <QtPlugin>
+
+HD44780LCDPlugin::
+HD44780LCDPlugin(QObject* parent) :
+	QObject(parent),
+	initialized(false)
+{
+}
+
+QString HD44780LCDPlugin::
+name() const
+{
+	return "HD44780LCD";
+}
+
+QString HD44780LCDPlugin::
+group() const
+{
+    return tr("Evan Platt");
+}
+
+QString HD44780LCDPlugin::
+toolTip() const
+{
+    return tr("PiGPIO HD44780 character LCD");
+}
+
+QString HD44780LCDPlugin::
+whatsThis() const
+{
+    return tr("PiGPIO HD44780 character LCD");
+}
+
+QString HD44780LCDPlugin::
+includeFile() const
+{
+	return "HD44780LCD.h";
+}
+
+QIcon HD44780LCDPlugin::
+icon() const
+{
+	return QIcon();
+}
+
+bool HD44780LCDPlugin::
+isContainer() const
+{
+	return false;
+}
+
+QWidget * HD44780LCDPlugin::
+createWidget(QWidget *parent)
+{
+	return new HD44780LCD(parent);
+}
+
+#if QT_VERSION < QT_VERSION_CHECK(5,0,0)
+Q_EXPORT_PLUGIN2(hd44780lcdplugin, HD44780LCDPlugin)
+#endif
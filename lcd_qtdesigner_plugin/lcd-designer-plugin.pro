@@ -0,0 +1,24 @@
+######################################################################
+# Designer plugin for the rpi-hd44780 display in QEMU
+######################################################################
+
+greaterThan(QT_MAJOR_VERSION, 4) {
+    QT += widgets designer
+}
+
+lessThan(QT_MAJOR_VERSION, 5) {
+    CONFIG += designer 
+}
+
+CONFIG += plugin release
+
+TEMPLATE = lib
+TARGET = $$qtLibraryTarget($$TARGET)
+target.path = $$[QT_INSTALL_PLUGINS]/designer
+INSTALLS += target
+
+INCLUDEPATH += . ../gpio_common
+
+# Input
+HEADERS += HD44780LCD.h HD44780LCDPlugin.h ../gpio_common/shared_hd44780_state.h
+SOURCES += HD44780LCD.cpp HD44780LCDPlugin.cpp
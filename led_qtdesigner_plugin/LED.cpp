@@ -5,7 +5,6 @@
 #include <QPaintDevice>
 #include <QTimer>
 #include <QDebug>
-#include <sys/shm.h>
 #include "LED.h"
 
 LED::
@@ -17,7 +16,11 @@ LED(QWidget* parent) :
 	initialState_(true),
 	state_(true),
   gpio_pin_(0),
-  refresh_rate_(10)
+  pin_numbering_(WiringPi),
+  board_rev_(1),
+  refresh_rate_(10),
+  pin_info_(NULL),
+  gpio_state(NULL)
 {
 
     setDiameter(diameter_);
@@ -43,10 +46,8 @@ void LED::
 connect_gpio()
 {
 
-    key_t key = ftok("/proc/cpuinfo",0x84);
-    int shmid = shmget(key, sizeof(shared_gpio_state), 0666);
-    if (shmid == -1) qDebug() << "Error connecting to shared memory";
-    gpio_state = (shared_gpio_state*)shmat(shmid, (void *)0, 0);
+    gpio_state = shared_gpio_state_attach();
+    if (gpio_state == NULL) qDebug() << "Error connecting to shared memory";
 
     update();
 
@@ -104,10 +105,36 @@ void LED::
 set_gpio_pin(int gpio_pin)
 {
     gpio_pin_ = gpio_pin;
+    update_pin_info();
 
     update();
 }
 
+void LED::
+set_pin_numbering(PinNumbering pin_numbering)
+{
+    pin_numbering_ = pin_numbering;
+    update_pin_info();
+
+    update();
+}
+
+void LED::
+set_board_rev(int board_rev)
+{
+    board_rev_ = board_rev;
+    update_pin_info();
+
+    update();
+}
+
+void LED::
+update_pin_info()
+{
+    pin_info_ = gpio_board_map_lookup(pin_numbering_, board_rev_, gpio_pin_);
+    if (pin_info_ == NULL) qDebug() << "LED: pin" << gpio_pin_ << "is not connected on this board";
+}
+
 void LED::
 set_refresh_rate(int refresh_rate)
 {
@@ -129,7 +156,7 @@ gpio_refresh()
 {
 
     //make sure it's an output then set the LED state
-    if (get_gpio_pin_function() == 1) state_ = ((gpio_state->outstate0 & (1 << gpio_to_bcm2835_map[gpio_pin_])) > 0);
+    if (get_gpio_pin_function() == GPIO_FSEL_OUTPUT) state_ = gpio_pin_output(gpio_state, pin_info_);
     else state_ = false;
 
     update();
@@ -210,6 +237,18 @@ gpio_pin() const
     return gpio_pin_;
 }
 
+LED::PinNumbering LED::
+pin_numbering() const
+{
+    return pin_numbering_;
+}
+
+int LED::
+board_rev() const
+{
+    return board_rev_;
+}
+
 int LED::
 refresh_rate() const
 {
@@ -219,13 +258,8 @@ refresh_rate() const
 int LED::
 get_gpio_pin_function(){
 
-  int pin = gpio_to_bcm2835_map[gpio_pin_];
+  if (gpio_state == NULL || pin_info_ == NULL) return -1;
 
-  if (pin<10)            return ((gpio_state->GPFSEL0 >> (3*pin))      & 0x7);
-  if (pin>=10 && pin<20) return ((gpio_state->GPFSEL1 >> (3*(pin-10))) & 0x7);
-  if (pin>=20 && pin<30) return ((gpio_state->GPFSEL2 >> (3*(pin-20))) & 0x7);
-  if (pin>=30 && pin<40) return ((gpio_state->GPFSEL3 >> (3*(pin-30))) & 0x7);
-  if (pin>=40 && pin<50) return ((gpio_state->GPFSEL4 >> (3*(pin-40))) & 0x7);
-  return ((gpio_state->GPFSEL5 >> (3*(pin-50))) & 0x7);
+  return gpio_pin_function(gpio_state, pin_info_);
 
 }
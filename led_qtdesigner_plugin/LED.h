@@ -4,6 +4,8 @@
 #include <QtDesigner/QtDesigner>
 #include <QWidget>
 
+#include "gpio_board_map.h"
+
 class QTimer;
 
 class QDESIGNER_WIDGET_EXPORT LED : public QWidget
@@ -15,9 +17,18 @@ class QDESIGNER_WIDGET_EXPORT LED : public QWidget
 	Q_PROPERTY(Qt::Alignment alignment READ alignment WRITE setAlignment)
 	Q_PROPERTY(bool state READ state WRITE setState)
   Q_PROPERTY(int gpio_pin READ gpio_pin WRITE set_gpio_pin)
+  Q_PROPERTY(PinNumbering pin_numbering READ pin_numbering WRITE set_pin_numbering)
+  Q_PROPERTY(int board_rev READ board_rev WRITE set_board_rev)
   Q_PROPERTY(int refresh_rate READ refresh_rate WRITE set_refresh_rate)
+  Q_ENUMS(PinNumbering)
 
 public:
+  enum PinNumbering {
+    WiringPi = GPIO_NUMBERING_WIRINGPI,
+    BCM      = GPIO_NUMBERING_BCM,
+    Physical = GPIO_NUMBERING_PHYSICAL
+  };
+
 	explicit LED(QWidget* parent=0);
 	~LED();
 
@@ -33,8 +44,12 @@ public:
   bool state() const;
 
 	void set_gpio_pin(int gpio_pin);
+	void set_pin_numbering(PinNumbering pin_numbering);
+	void set_board_rev(int board_rev);
 	void set_refresh_rate(int refresh_rate);
 	int gpio_pin() const;
+	PinNumbering pin_numbering() const;
+	int board_rev() const;
 	int refresh_rate() const;
 	void connect_gpio();
     int get_gpio_pin_function();
@@ -59,8 +74,15 @@ private:
 	bool state_;
 
 	int gpio_pin_;
+	PinNumbering pin_numbering_;
+	int board_rev_;  // 1 by default, matching the original wiringPi 0-7 map
 	int refresh_rate_;
 
+	//
+	// Register lookup for the bound pin, NULL if it isn't on the header.
+	//
+	const gpio_pin_info *pin_info_;
+
 	//
 	// Pixels per mm for x and y...
 	//
@@ -75,22 +97,7 @@ private:
 	QTimer* timer_;
   QTimer* gpio_timer_;
 
-  struct shared_gpio_state {
-
-    unsigned int GPFSEL0;
-    unsigned int GPFSEL1;
-    unsigned int GPFSEL2;
-    unsigned int GPFSEL3;
-    unsigned int GPFSEL4;
-    unsigned int GPFSEL5;
-    unsigned int GPLEV0;
-    unsigned int GPLEV1;
-    unsigned int outstate0;
-    unsigned int outstate1;
-
-  };
-
-  const int gpio_to_bcm2835_map[8] = {17,18,21,22,23,24,25,4};
+  void update_pin_info();
 
   shared_gpio_state *gpio_state;
 
@@ -17,8 +17,8 @@ TARGET = $$qtLibraryTarget($$TARGET)
 target.path = $$[QT_INSTALL_PLUGINS]/designer
 INSTALLS += target
 
-INCLUDEPATH += .
+INCLUDEPATH += . ../gpio_common
 
 # Input
-HEADERS += LED.h LEDPlugin.h
+HEADERS += LED.h LEDPlugin.h ../gpio_common/shared_gpio_state.h ../gpio_common/gpio_board_map.h
 SOURCES += LED.cpp LEDPlugin.cpp
@@ -0,0 +1,275 @@
+#include <QFile>
+#include <QTimer>
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QWidget>
+#include "LED.h"
+#include "GPIOButton.h"
+#include "PanelRunner.h"
+
+PanelUiLoader::
+PanelUiLoader(QObject* parent) :
+    QUiLoader(parent)
+{
+}
+
+//
+// Build the custom widgets directly rather than through the designer
+// plugins, so the runner does not depend on what is installed under
+// QT_INSTALL_PLUGINS.
+//
+QWidget* PanelUiLoader::
+createWidget(const QString& className, QWidget* parent, const QString& name)
+{
+    QWidget* w;
+
+    if (className == "LED")
+        w = new LED(parent);
+    else if (className == "GPIOButton")
+        w = new GPIOButton(parent);
+    else
+        return QUiLoader::createWidget(className, parent, name);
+
+    w->setObjectName(name);
+    return w;
+}
+
+PanelRunner::
+PanelRunner(QObject* parent) :
+    QObject(parent),
+    panel_(0),
+    server_(new QLocalServer(this)),
+    poll_timer_(new QTimer(this))
+{
+    connect(server_, SIGNAL(newConnection()), this, SLOT(new_connection()));
+    connect(poll_timer_, SIGNAL(timeout()), this, SLOT(poll()));
+
+    poll_timer_->start(1);
+}
+
+PanelRunner::
+~PanelRunner()
+{
+    delete panel_;
+}
+
+bool PanelRunner::
+load(const QString& ui_file)
+{
+    PanelUiLoader loader;
+    QFile file(ui_file);
+
+    if (!file.open(QFile::ReadOnly)) {
+        qWarning() << "Unable to open" << ui_file;
+        return false;
+    }
+
+    panel_ = loader.load(&file);
+    if (panel_ == 0) {
+        qWarning() << "Unable to load" << ui_file << ":" << loader.errorString();
+        return false;
+    }
+
+    //
+    // The panel is never shown, so update() from the widgets does not
+    // schedule any painting.
+    //
+    foreach (LED* led, panel_->findChildren<LED*>())
+        leds_.insert(led->objectName(), led);
+    foreach (GPIOButton* button, panel_->findChildren<GPIOButton*>())
+        buttons_.insert(button->objectName(), button);
+
+    qDebug() << "Loaded" << ui_file << "with" << leds_.size() << "LEDs and"
+             << buttons_.size() << "buttons";
+
+    return true;
+}
+
+bool PanelRunner::
+listen(const QString& socket_name)
+{
+    QLocalServer::removeServer(socket_name);
+
+    if (!server_->listen(socket_name)) {
+        qWarning() << "Unable to listen on" << socket_name << ":" << server_->errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void PanelRunner::
+set_state_file(const QString& state_file)
+{
+    state_file_ = state_file;
+}
+
+void PanelRunner::
+set_poll_interval(int poll_interval)
+{
+    poll_timer_->start(poll_interval);
+}
+
+void PanelRunner::
+new_connection()
+{
+    QLocalSocket* client;
+
+    while ((client = server_->nextPendingConnection()) != 0) {
+        connect(client, SIGNAL(readyRead()), this, SLOT(client_ready()));
+        connect(client, SIGNAL(disconnected()), this, SLOT(client_gone()));
+    }
+}
+
+void PanelRunner::
+client_ready()
+{
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+    QString reply;
+
+    while (client->canReadLine()) {
+        QString line = QString::fromLatin1(client->readLine()).trimmed();
+        QStringList args = line.split(' ', QString::SkipEmptyParts);
+
+        if (args.isEmpty())
+            continue;
+
+        reply = command(client, args);
+        if (!reply.isEmpty())
+            client->write(reply.toLatin1() + "\n");
+    }
+}
+
+void PanelRunner::
+client_gone()
+{
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+
+    for (int i = waits_.size() - 1; i >= 0; i--)
+        if (waits_[i].client == client)
+            waits_.removeAt(i);
+
+    client->deleteLater();
+}
+
+//
+// Run one command.  An empty reply means the answer will be sent later
+// (only used by "wait").
+//
+QString PanelRunner::
+command(QLocalSocket* client, const QStringList& args)
+{
+    const QString& cmd = args[0];
+
+    if (cmd == "list") {
+        QString out;
+        foreach (LED* led, leds_)
+            out += QString("LED %1 %2\n").arg(led->objectName()).arg(led->gpio_pin());
+        foreach (GPIOButton* button, buttons_)
+            out += QString("GPIOButton %1 %2\n").arg(button->objectName()).arg(button->gpio_pin());
+        return out + "OK";
+    }
+
+    if (cmd == "snapshot")
+        return "OK " + snapshot();
+
+    if (args.size() < 2)
+        return "ERR missing widget name";
+
+    if (cmd == "get" || cmd == "wait") {
+        LED* led = leds_.value(args[1]);
+        if (led == 0)
+            return "ERR no LED named " + args[1];
+
+        led->gpio_refresh();
+        if (cmd == "get")
+            return QString("OK %1").arg(led->state() ? 1 : 0);
+
+        if (args.size() < 3)
+            return "ERR usage: wait <led> <0|1> [ms]";
+
+        PendingWait w;
+        w.client = client;
+        w.led = led;
+        w.state = (args[2].toInt() != 0);
+        w.timeout = (args.size() > 3) ? args[3].toInt() : -1;
+        if (led->state() == w.state)
+            return "OK";
+
+        w.elapsed.start();
+        waits_.append(w);
+        return QString();
+    }
+
+    if (cmd == "press" || cmd == "hold" || cmd == "release") {
+        GPIOButton* button = buttons_.value(args[1]);
+        if (button == 0)
+            return "ERR no GPIOButton named " + args[1];
+        if (button->get_gpio_pin_function() != GPIO_FSEL_INPUT)
+            return "ERR pin is not an input";
+
+        if (cmd == "release") {
+            button->set_gpio(false);
+        }
+        else {
+            button->set_gpio(true);
+            if (cmd == "press") {
+                int ms = (args.size() > 2) ? args[2].toInt() : button->click_duration();
+                QTimer::singleShot(ms, button, SLOT(click_timeout()));
+            }
+        }
+        return "OK";
+    }
+
+    return "ERR unknown command " + cmd;
+}
+
+QString PanelRunner::
+snapshot()
+{
+    QStringList out;
+
+    foreach (LED* led, leds_)
+        out << QString("%1=%2").arg(led->objectName()).arg(led->state() ? 1 : 0);
+
+    return out.join(" ");
+}
+
+void PanelRunner::
+poll()
+{
+    QString line;
+
+    foreach (LED* led, leds_)
+        led->gpio_refresh();
+
+    for (int i = waits_.size() - 1; i >= 0; i--) {
+        PendingWait& w = waits_[i];
+        if (w.led->state() == w.state)
+            w.client->write("OK\n");
+        else if (w.timeout >= 0 && w.elapsed.elapsed() >= w.timeout)
+            w.client->write("ERR timeout\n");
+        else
+            continue;
+        waits_.removeAt(i);
+    }
+
+    if (state_file_.isEmpty())
+        return;
+
+    line = snapshot();
+    if (line != last_snapshot_) {
+        write_state_file(line);
+        last_snapshot_ = line;
+    }
+}
+
+void PanelRunner::
+write_state_file(const QString& line)
+{
+    QFile file(state_file_);
+
+    if (file.open(QFile::WriteOnly | QFile::Truncate))
+        file.write(line.toLatin1() + "\n");
+}
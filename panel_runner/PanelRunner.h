@@ -0,0 +1,91 @@
+#ifndef _PANEL_RUNNER_H_
+#define _PANEL_RUNNER_H_
+
+#include <QObject>
+#include <QMap>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QUiLoader>
+
+class QWidget;
+class QTimer;
+class QLocalServer;
+class QLocalSocket;
+class LED;
+class GPIOButton;
+
+//
+// Loads a .ui panel built from the LED/GPIOButton designer widgets without
+// showing it, and exposes the widgets over a QLocalServer so that test scripts
+// can drive them on a machine with no display (QT_QPA_PLATFORM=offscreen).
+//
+// The protocol is one command per line, answered by one or more lines, the
+// last of which starts with "OK" or "ERR":
+//
+//   list                      one line per widget: <LED|GPIOButton> <name> <pin>
+//   get <led>                 OK <0|1>
+//   snapshot                  OK <led>=<0|1> ...
+//   press <button> [ms]       pulse the input high for ms (default click_duration)
+//   hold <button>             drive the input high
+//   release <button>          drive the input low
+//   wait <led> <0|1> [ms]     OK once the LED reaches the state, ERR on timeout
+//
+// If a state file is given, the snapshot line is rewritten every time an LED
+// changes.
+//
+
+class PanelUiLoader : public QUiLoader
+{
+public:
+    explicit PanelUiLoader(QObject* parent=0);
+
+    QWidget* createWidget(const QString& className, QWidget* parent=0,
+                          const QString& name=QString());
+};
+
+class PanelRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PanelRunner(QObject* parent=0);
+    ~PanelRunner();
+
+    bool load(const QString& ui_file);
+    bool listen(const QString& socket_name);
+    void set_state_file(const QString& state_file);
+    void set_poll_interval(int poll_interval);
+
+private slots:
+    void new_connection();
+    void client_ready();
+    void client_gone();
+    void poll();
+
+private:
+    struct PendingWait {
+        QLocalSocket* client;
+        LED* led;
+        bool state;
+        int timeout;
+        QElapsedTimer elapsed;
+    };
+
+    QString command(QLocalSocket* client, const QStringList& args);
+    QString snapshot();
+    void write_state_file(const QString& line);
+
+    QWidget* panel_;
+    QLocalServer* server_;
+    QTimer* poll_timer_;
+    QString state_file_;
+    QString last_snapshot_;
+
+    QMap<QString, LED*> leds_;
+    QMap<QString, GPIOButton*> buttons_;
+    QList<PendingWait> waits_;
+};
+
+#endif
@@ -0,0 +1,61 @@
+//
+// panel-runner: drive a LED/GPIOButton .ui panel without a display.
+//
+// Usage: panel-runner [-s socket] [-f state_file] [-p poll_ms] panel.ui
+//
+// Example, on a CI machine with no X server:
+//   panel-runner -s gpio-panel ../led_qtdesigner_plugin/app.ui &
+//   echo "wait led0 1 5000" | socat - UNIX-CONNECT:/tmp/gpio-panel
+//
+
+#include <QApplication>
+#include <QStringList>
+#include <QDebug>
+#include <stdio.h>
+#include <stdlib.h>
+#include "PanelRunner.h"
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-s socket] [-f state_file] [-p poll_ms] panel.ui\n", argv0);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[])
+{
+    // Don't need (or want) a display: fall back to the offscreen platform
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty() && qgetenv("DISPLAY").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    QStringList args = app.arguments();
+    QString socket_name = "gpio-panel";
+    QString state_file;
+    QString ui_file;
+    int poll_ms = 1;
+
+    for (int i = 1; i < args.size(); i++) {
+        if (args[i] == "-s" && i + 1 < args.size())
+            socket_name = args[++i];
+        else if (args[i] == "-f" && i + 1 < args.size())
+            state_file = args[++i];
+        else if (args[i] == "-p" && i + 1 < args.size())
+            poll_ms = args[++i].toInt();
+        else if (args[i].startsWith("-"))
+            usage(argv[0]);
+        else
+            ui_file = args[i];
+    }
+
+    if (ui_file.isEmpty())
+        usage(argv[0]);
+
+    PanelRunner runner;
+    runner.set_state_file(state_file);
+    runner.set_poll_interval(poll_ms);
+
+    if (!runner.load(ui_file) || !runner.listen(socket_name))
+        return EXIT_FAILURE;
+
+    return app.exec();
+}
@@ -0,0 +1,31 @@
+######################################################################
+# Headless runner for LED/GPIOButton panels (see PanelRunner.h)
+######################################################################
+
+greaterThan(QT_MAJOR_VERSION, 4) {
+    QT += widgets designer uitools network
+}
+
+lessThan(QT_MAJOR_VERSION, 5) {
+    CONFIG += designer uitools
+    QT += network
+}
+
+CONFIG += console release
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = panel-runner
+
+INCLUDEPATH += . ../gpio_common ../led_qtdesigner_plugin ../button_qtdesiger_plugin
+
+# Input
+HEADERS += \
+    PanelRunner.h \
+    ../led_qtdesigner_plugin/LED.h \
+    ../button_qtdesiger_plugin/GPIOButton.h
+SOURCES += \
+    main.cpp \
+    PanelRunner.cpp \
+    ../led_qtdesigner_plugin/LED.cpp \
+    ../button_qtdesiger_plugin/GPIOButton.cpp
@@ -889,6 +889,50 @@ static QemuMutex qemu_global_mutex;
 static QemuCond qemu_io_proceeded_cond;
 static unsigned iothread_requesting_mutex;
 
+/* Lock statistics, only updated with the lock held.  The lock has one
+ * owner at a time, so iothread_held_since is when the current owner took
+ * it, whichever thread that is.
+ */
+static bool iothread_timing;
+static uint64_t iothread_acquired;
+static uint64_t iothread_wait_ns;
+static uint64_t iothread_held_ns;
+static int64_t iothread_held_since;
+
+static void qemu_global_mutex_acquired(int64_t wait_start)
+{
+    int64_t now;
+
+    if (iothread_timing) {
+        now = get_clock();
+        iothread_acquired++;
+        iothread_wait_ns += now - wait_start;
+        iothread_held_since = now;
+    }
+}
+
+static void qemu_global_mutex_releasing(void)
+{
+    if (iothread_timing && iothread_held_since) {
+        iothread_held_ns += get_clock() - iothread_held_since;
+    }
+    iothread_held_since = 0;
+}
+
+/* Wait on cond, which gives up the global mutex meanwhile.  Taking it
+ * back counts as an acquisition, but the time asleep is not time spent
+ * waiting for the mutex, so it is not counted as waiting.
+ */
+static void qemu_global_cond_wait(QemuCond *cond)
+{
+    qemu_global_mutex_releasing();
+    qemu_cond_wait(cond, &qemu_global_mutex);
+    if (iothread_timing) {
+        iothread_acquired++;
+        iothread_held_since = get_clock();
+    }
+}
+
 static QemuThread io_thread;
 
 /* cpu creation */
@@ -937,7 +981,7 @@ void run_on_cpu(CPUState *cpu, void (*func)(void *data), void *data)
     while (!atomic_mb_read(&wi.done)) {
         CPUState *self_cpu = current_cpu;
 
-        qemu_cond_wait(&qemu_work_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(&qemu_work_cond);
         current_cpu = self_cpu;
     }
 }
@@ -1012,11 +1056,11 @@ static void qemu_wait_io_event_common(CPUState *cpu)
 static void qemu_tcg_wait_io_event(CPUState *cpu)
 {
     while (all_cpu_threads_idle()) {
-        qemu_cond_wait(cpu->halt_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(cpu->halt_cond);
     }
 
     while (iothread_requesting_mutex) {
-        qemu_cond_wait(&qemu_io_proceeded_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(&qemu_io_proceeded_cond);
     }
 
     CPU_FOREACH(cpu) {
@@ -1027,7 +1071,7 @@ static void qemu_tcg_wait_io_event(CPUState *cpu)
 static void qemu_kvm_wait_io_event(CPUState *cpu)
 {
     while (cpu_thread_is_idle(cpu)) {
-        qemu_cond_wait(cpu->halt_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(cpu->halt_cond);
     }
 
     qemu_kvm_eat_signals(cpu);
@@ -1137,7 +1181,7 @@ static void *qemu_tcg_cpu_thread_fn(void *arg)
 
     /* wait for initial kick-off after machine start */
     while (first_cpu->stopped) {
-        qemu_cond_wait(first_cpu->halt_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(first_cpu->halt_cond);
 
         /* process any pending work */
         CPU_FOREACH(cpu) {
@@ -1231,6 +1275,8 @@ bool qemu_mutex_iothread_locked(void)
 
 void qemu_mutex_lock_iothread(void)
 {
+    int64_t start = iothread_timing ? get_clock() : 0;
+
     atomic_inc(&iothread_requesting_mutex);
     /* In the simple case there is no need to bump the VCPU thread out of
      * TCG code execution.
@@ -1248,14 +1294,40 @@ void qemu_mutex_lock_iothread(void)
         qemu_cond_broadcast(&qemu_io_proceeded_cond);
     }
     iothread_locked = true;
+    qemu_global_mutex_acquired(start);
 }
 
 void qemu_mutex_unlock_iothread(void)
 {
+    qemu_global_mutex_releasing();
     iothread_locked = false;
     qemu_mutex_unlock(&qemu_global_mutex);
 }
 
+void qemu_mutex_iothread_timing(bool enable)
+{
+    iothread_timing = enable;
+    iothread_held_since = enable ? get_clock() : 0;
+}
+
+/* The hold in progress is credited up to now, so that a sample does not
+ * miss it and the next one get it all at once
+ */
+void qemu_mutex_iothread_stats(uint64_t *acquired, uint64_t *wait_ns,
+                               uint64_t *held_ns)
+{
+    int64_t now;
+
+    if (iothread_timing && iothread_held_since) {
+        now = get_clock();
+        iothread_held_ns += now - iothread_held_since;
+        iothread_held_since = now;
+    }
+    *acquired = iothread_acquired;
+    *wait_ns = iothread_wait_ns;
+    *held_ns = iothread_held_ns;
+}
+
 static int all_vcpus_paused(void)
 {
     CPUState *cpu;
@@ -1291,7 +1363,7 @@ void pause_all_vcpus(void)
     }
 
     while (!all_vcpus_paused()) {
-        qemu_cond_wait(&qemu_pause_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(&qemu_pause_cond);
         CPU_FOREACH(cpu) {
             qemu_cpu_kick(cpu);
         }
@@ -1338,7 +1410,7 @@ static void qemu_tcg_init_vcpu(CPUState *cpu)
         cpu->hThread = qemu_thread_get_handle(cpu->thread);
 #endif
         while (!cpu->created) {
-            qemu_cond_wait(&qemu_cpu_cond, &qemu_global_mutex);
+            qemu_global_cond_wait(&qemu_cpu_cond);
         }
         tcg_cpu_thread = cpu->thread;
     } else {
@@ -1359,7 +1431,7 @@ static void qemu_kvm_start_vcpu(CPUState *cpu)
     qemu_thread_create(cpu->thread, thread_name, qemu_kvm_cpu_thread_fn,
                        cpu, QEMU_THREAD_JOINABLE);
     while (!cpu->created) {
-        qemu_cond_wait(&qemu_cpu_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(&qemu_cpu_cond);
     }
 }
 
@@ -1375,7 +1447,7 @@ static void qemu_dummy_start_vcpu(CPUState *cpu)
     qemu_thread_create(cpu->thread, thread_name, qemu_dummy_cpu_thread_fn, cpu,
                        QEMU_THREAD_JOINABLE);
     while (!cpu->created) {
-        qemu_cond_wait(&qemu_cpu_cond, &qemu_global_mutex);
+        qemu_global_cond_wait(&qemu_cpu_cond);
     }
 }
 
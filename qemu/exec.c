@@ -88,6 +88,9 @@ static MemoryRegion io_mem_unassigned;
  */
 #define RAM_RESIZEABLE (1 << 2)
 
+/* RAM is not saved or migrated: its contents belong to someone else */
+#define RAM_NOMIGRATE  (1 << 3)
+
 #endif
 
 struct CPUTailQ cpus = QTAILQ_HEAD_INITIALIZER(cpus);
@@ -1429,6 +1432,43 @@ const char *qemu_ram_get_idstr(RAMBlock *rb)
     return rb->idstr;
 }
 
+/* Whether the block's memory is QEMU's alone to remap: not supplied by
+ * the caller of memory_region_init_ram_ptr, nor shared with other
+ * processes.
+ */
+bool qemu_ram_is_private(RAMBlock *rb)
+{
+    return !(rb->flags & (RAM_PREALLOC | RAM_SHARED));
+}
+
+/* Whether the block's memory was supplied by the caller of
+ * memory_region_init_ram_ptr.
+ */
+bool qemu_ram_is_prealloc(RAMBlock *rb)
+{
+    return rb->flags & RAM_PREALLOC;
+}
+
+/* Leave the block out of savevm and migration, for memory whose contents
+ * are owned outside the guest, such as a segment shared with host programs.
+ * The device that maps it restores what the guest sees from its own state.
+ */
+void qemu_ram_set_nomigrate(ram_addr_t addr)
+{
+    RAMBlock *block;
+
+    rcu_read_lock();
+    block = find_ram_block(addr);
+    assert(block);
+    block->flags |= RAM_NOMIGRATE;
+    rcu_read_unlock();
+}
+
+bool qemu_ram_is_migratable(RAMBlock *rb)
+{
+    return !(rb->flags & RAM_NOMIGRATE);
+}
+
 /* Called with iothread lock held.  */
 void qemu_ram_set_idstr(ram_addr_t addr, const char *name, DeviceState *dev)
 {
@@ -3748,6 +3788,9 @@ bool cpu_physical_memory_is_io(hwaddr phys_addr)
     return res;
 }
 
+/* Only the migration code walks the blocks this way, so blocks left out
+ * of migration are skipped
+ */
 int qemu_ram_foreach_block(RAMBlockIterFunc func, void *opaque)
 {
     RAMBlock *block;
@@ -3755,6 +3798,9 @@ int qemu_ram_foreach_block(RAMBlockIterFunc func, void *opaque)
 
     rcu_read_lock();
     QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
+        if (!qemu_ram_is_migratable(block)) {
+            continue;
+        }
         ret = func(block->idstr, block->host, block->offset,
                    block->used_length, opaque);
         if (ret) {
@@ -370,6 +370,38 @@ STEXI
 @item delvm @var{tag}|@var{id}
 @findex delvm
 Delete the snapshot identified by @var{tag} or @var{id}.
+ETEXI
+
+    {
+        .name       = "cow_snapshot_take",
+        .args_type  = "filename:F",
+        .params     = "filename",
+        .help       = "snapshot the VM for cow_snapshot_restore, with RAM backed copy-on-write by filename",
+        .mhandler.cmd = hmp_cow_snapshot_take,
+    },
+
+STEXI
+@item cow_snapshot_take @var{filename}
+@findex cow_snapshot_take
+Snapshot the virtual machine so that @code{cow_snapshot_restore} can put
+it back quickly. Guest RAM is written to @var{filename}, which then backs
+it copy-on-write; device state is kept in memory and writable disks get an
+internal snapshot called @code{cow-snapshot}.
+ETEXI
+
+    {
+        .name       = "cow_snapshot_restore",
+        .args_type  = "",
+        .params     = "",
+        .help       = "restore the snapshot taken with cow_snapshot_take",
+        .mhandler.cmd = hmp_cow_snapshot_restore,
+    },
+
+STEXI
+@item cow_snapshot_restore
+@findex cow_snapshot_restore
+Put the virtual machine back to the snapshot taken with
+@code{cow_snapshot_take}. Only the RAM pages written since are read back.
 ETEXI
 
     {
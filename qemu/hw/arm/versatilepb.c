@@ -30,6 +30,8 @@
 
 #define RPI_GPIO_BASE 0x20200000 /* Peripheral base address for
                                     Raspberry Pi 1 (BCM2835) */
+#define RPI_GPIO_SIC_IRQ 10      /* Unused secondary interrupt controller
+                                    line for the GPIO event detect IRQ */
 
 /* Primary interrupt controller.  */
 
@@ -371,7 +373,7 @@ static void versatile_init(MachineState *machine, int board_id)
         fprintf(stderr, "qemu: Error registering flash memory.\n");
     }
 
-    sysbus_create_simple("rpi_gpio", RPI_GPIO_BASE, NULL);
+    sysbus_create_simple("rpi_gpio", RPI_GPIO_BASE, sic[RPI_GPIO_SIC_IRQ]);
 
     versatile_binfo.ram_size = machine->ram_size;
     versatile_binfo.kernel_filename = machine->kernel_filename;
@@ -0,0 +1,430 @@
+/*
+ * HD44780 character LCD on the pins of the rpi_gpio device.
+ *
+ *   -device rpi-hd44780,rs=7,e=8,d4=17,d5=18,d6=27,d7=22[,d0=..,d3=..][,cols=16,rows=2]
+ *
+ * Pins are BCM numbers.  With only d4-d7 connected the controller is driven
+ * in 4 bit mode, exactly as by wiringPi's lcd.c; RS and the data lines are
+ * latched on the falling edge of E.  Reads (R/W) are not modelled.
+ *
+ * The visible characters, cursor and user defined characters are published
+ * in a SysV shared memory segment (ftok("/proc/cpuinfo", shm-id), 0x85 by
+ * default) for the HD44780 Qt designer widget and test scripts.  The layout
+ * must match gpio_common/shared_hd44780_state.h.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/hw.h"
+#include "hw/qdev.h"
+#include "hw/gpio/rpi_gpio.h"
+#include "qemu/atomic.h"
+#include "qemu/error-report.h"
+#include "qapi/error.h"
+#include "trace.h"
+#include <sys/shm.h>
+
+#define TYPE_RPI_HD44780 "rpi-hd44780"
+#define RPI_HD44780(obj) OBJECT_CHECK(RPIHD44780State, (obj), TYPE_RPI_HD44780)
+
+#define HD44780_MAX_ROWS  4
+#define HD44780_MAX_COLS  40
+#define HD44780_DDRAM     80
+#define HD44780_CGRAM     64
+
+enum {
+    HD44780_RS,
+    HD44780_E,
+    HD44780_D0,     /* D0-D7 follow */
+    HD44780_LINES = HD44780_D0 + 8,
+};
+
+typedef struct shared_hd44780_state {
+    uint32_t seq;               /* Odd while QEMU is updating */
+    uint8_t rows;
+    uint8_t cols;
+    uint8_t display;            /* Display control: display on, cursor, blink */
+    uint8_t cursor;
+    uint8_t blink;
+    uint8_t cursor_row;         /* 0xff when the cursor is off screen */
+    uint8_t cursor_col;
+    uint8_t pad;
+    uint8_t text[HD44780_MAX_ROWS][HD44780_MAX_COLS];
+    uint8_t cgram[8][8];        /* User defined characters, 5 bits per row */
+} shared_hd44780_state;
+
+typedef struct RPIHD44780State {
+    DeviceState parent_obj;
+
+    int32_t pin[HD44780_LINES];
+    uint32_t cols;
+    uint32_t rows;
+    uint32_t shm_id;
+
+    uint32_t lines;             /* Current level of each role */
+    bool bus8;                  /* All of d0-d7 are connected */
+    bool dl8;                   /* Function set: 8 bit interface */
+    bool two_line;              /* Function set: N */
+    bool nibble_pending;
+    uint8_t nibble;
+    uint8_t ddram[HD44780_DDRAM];
+    uint8_t cgram[HD44780_CGRAM];
+    uint8_t ac;                 /* Address counter */
+    bool ac_cgram;
+    bool inc;                   /* Entry mode: I/D */
+    bool entry_shift;           /* Entry mode: S */
+    uint8_t display_ctrl;
+    uint8_t shift;              /* Display shift, in characters */
+
+    shared_hd44780_state *shm;
+} RPIHD44780State;
+
+/* DDRAM is two 40 byte lines at 0x00 and 0x40, or one 80 byte line */
+static int hd44780_line_len(RPIHD44780State *s)
+{
+    return s->two_line ? 40 : 80;
+}
+
+static int hd44780_ddram_index(RPIHD44780State *s, uint8_t addr)
+{
+    if (!s->two_line) {
+        return addr % HD44780_DDRAM;
+    }
+    return ((addr & 0x40) ? 40 : 0) + (addr & 0x3f) % 40;
+}
+
+static void hd44780_step_ac(RPIHD44780State *s)
+{
+    int len = hd44780_line_len(s);
+    int line = s->two_line ? (s->ac & 0x40) : 0;
+    int pos = s->two_line ? (s->ac & 0x3f) % 40 : s->ac % HD44780_DDRAM;
+
+    if (s->ac_cgram) {
+        s->ac = (s->ac + (s->inc ? 1 : -1)) & (HD44780_CGRAM - 1);
+        return;
+    }
+
+    /* In two line mode the counter runs from the end of one line onto
+       the start of the other */
+    pos += s->inc ? 1 : -1;
+    if (pos == len) {
+        pos = 0;
+        line ^= s->two_line ? 0x40 : 0;
+    } else if (pos < 0) {
+        pos = len - 1;
+        line ^= s->two_line ? 0x40 : 0;
+    }
+    s->ac = line | pos;
+}
+
+static void hd44780_shift_display(RPIHD44780State *s, bool left)
+{
+    int len = hd44780_line_len(s);
+
+    s->shift = (s->shift + (left ? 1 : len - 1)) % len;
+}
+
+/* Copy what is on the glass into the shared segment */
+static void hd44780_publish(RPIHD44780State *s)
+{
+    shared_hd44780_state *p = s->shm;
+    int len = hd44780_line_len(s);
+    int r, c, base, pos;
+
+    if (!p) {
+        return;
+    }
+
+    atomic_set(&p->seq, p->seq + 1);
+    smp_wmb();
+
+    p->rows = s->rows;
+    p->cols = s->cols;
+    p->display = (s->display_ctrl >> 2) & 1;
+    p->cursor = (s->display_ctrl >> 1) & 1;
+    p->blink = s->display_ctrl & 1;
+    p->cursor_row = p->cursor_col = 0xff;
+
+    /* Rows 2 and 3 of a four row display continue rows 0 and 1 */
+    for (r = 0; r < s->rows; r++) {
+        base = (r & 1) && s->two_line ? 0x40 : 0;
+        for (c = 0; c < s->cols; c++) {
+            pos = ((r >> 1) * s->cols + c + s->shift) % len;
+            if (!s->two_line && (r & 1)) {
+                pos = (pos + 40) % len;
+            }
+            p->text[r][c] = s->ddram[hd44780_ddram_index(s, base | pos)];
+            if (!s->ac_cgram &&
+                hd44780_ddram_index(s, s->ac) == hd44780_ddram_index(s, base | pos)) {
+                p->cursor_row = r;
+                p->cursor_col = c;
+            }
+        }
+    }
+    memcpy(p->cgram, s->cgram, sizeof(p->cgram));
+
+    smp_wmb();
+    atomic_set(&p->seq, p->seq + 1);
+}
+
+static void hd44780_command(RPIHD44780State *s, uint8_t cmd)
+{
+    if (cmd & 0x80) {
+        s->ac = cmd & 0x7f;
+        s->ac_cgram = false;
+    } else if (cmd & 0x40) {
+        s->ac = cmd & 0x3f;
+        s->ac_cgram = true;
+    } else if (cmd & 0x20) {
+        s->dl8 = (cmd & 0x10) != 0;
+        s->two_line = (cmd & 0x08) != 0;
+        s->nibble_pending = false;
+    } else if (cmd & 0x10) {
+        if (cmd & 0x08) {
+            hd44780_shift_display(s, !(cmd & 0x04));
+        } else {
+            bool inc = s->inc;
+
+            s->inc = (cmd & 0x04) != 0;
+            hd44780_step_ac(s);
+            s->inc = inc;
+        }
+    } else if (cmd & 0x08) {
+        s->display_ctrl = cmd & 0x07;
+    } else if (cmd & 0x04) {
+        s->inc = (cmd & 0x02) != 0;
+        s->entry_shift = (cmd & 0x01) != 0;
+    } else if (cmd & 0x02) {
+        s->ac = 0;
+        s->ac_cgram = false;
+        s->shift = 0;
+    } else if (cmd & 0x01) {
+        memset(s->ddram, ' ', sizeof(s->ddram));
+        s->ac = 0;
+        s->ac_cgram = false;
+        s->shift = 0;
+        s->inc = true;
+    }
+}
+
+static void hd44780_data(RPIHD44780State *s, uint8_t data)
+{
+    if (s->ac_cgram) {
+        s->cgram[s->ac & (HD44780_CGRAM - 1)] = data & 0x1f;
+    } else {
+        s->ddram[hd44780_ddram_index(s, s->ac)] = data;
+        if (s->entry_shift) {
+            hd44780_shift_display(s, s->inc);
+        }
+    }
+    hd44780_step_ac(s);
+}
+
+/* Falling edge of E: latch RS and the data lines */
+static void hd44780_strobe(RPIHD44780State *s)
+{
+    bool rs = (s->lines >> HD44780_RS) & 1;
+    uint8_t bus = (s->lines >> HD44780_D0) & 0xff;
+    uint8_t value;
+
+    if (!s->bus8) {
+        bus &= 0xf0;    /* D0-D3 are not connected */
+    }
+
+    if (s->dl8) {
+        value = bus;
+    } else if (!s->nibble_pending) {
+        s->nibble = bus & 0xf0;
+        s->nibble_pending = true;
+        return;
+    } else {
+        value = s->nibble | (bus >> 4);
+        s->nibble_pending = false;
+    }
+
+    trace_rpi_hd44780_write(rs, value);
+    if (rs) {
+        hd44780_data(s, value);
+    } else {
+        hd44780_command(s, value);
+    }
+    hd44780_publish(s);
+}
+
+static void hd44780_line(void *opaque, int n, int level)
+{
+    RPIHD44780State *s = opaque;
+    bool was_high = (s->lines >> n) & 1;
+
+    if (level) {
+        s->lines |= 1u << n;
+    } else {
+        s->lines &= ~(1u << n);
+    }
+
+    if (n == HD44780_E && was_high && !level) {
+        hd44780_strobe(s);
+    }
+}
+
+/* Power on state: 8 bit interface, one line, display off, incrementing */
+static void rpi_hd44780_reset(void *opaque)
+{
+    RPIHD44780State *s = opaque;
+
+    memset(s->ddram, ' ', sizeof(s->ddram));
+    s->dl8 = true;
+    s->two_line = false;
+    s->nibble_pending = false;
+    s->ac = 0;
+    s->ac_cgram = false;
+    s->inc = true;
+    s->entry_shift = false;
+    s->display_ctrl = 0;
+    s->shift = 0;
+    /* Released pins read high, but E only counts once the SoC drives it:
+       making the pin an output low is not a strobe */
+    s->lines = ~(1u << HD44780_E);
+    hd44780_publish(s);
+}
+
+/* The segment shows what was on the glass before the load */
+static int rpi_hd44780_post_load(void *opaque, int version_id)
+{
+    RPIHD44780State *s = opaque;
+
+    hd44780_publish(s);
+    return 0;
+}
+
+static const VMStateDescription vmstate_rpi_hd44780 = {
+    .name = "rpi-hd44780",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .post_load = rpi_hd44780_post_load,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT32(lines, RPIHD44780State),
+        VMSTATE_BOOL(dl8, RPIHD44780State),
+        VMSTATE_BOOL(two_line, RPIHD44780State),
+        VMSTATE_BOOL(nibble_pending, RPIHD44780State),
+        VMSTATE_UINT8(nibble, RPIHD44780State),
+        VMSTATE_UINT8_ARRAY(ddram, RPIHD44780State, HD44780_DDRAM),
+        VMSTATE_UINT8_ARRAY(cgram, RPIHD44780State, HD44780_CGRAM),
+        VMSTATE_UINT8(ac, RPIHD44780State),
+        VMSTATE_BOOL(ac_cgram, RPIHD44780State),
+        VMSTATE_BOOL(inc, RPIHD44780State),
+        VMSTATE_BOOL(entry_shift, RPIHD44780State),
+        VMSTATE_UINT8(display_ctrl, RPIHD44780State),
+        VMSTATE_UINT8(shift, RPIHD44780State),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static void rpi_hd44780_realize(DeviceState *dev, Error **errp)
+{
+    RPIHD44780State *s = RPI_HD44780(dev);
+    DeviceState *gpio;
+    bool ambiguous;
+    key_t key;
+    int shmid, i;
+    void *p;
+
+    if (s->pin[HD44780_RS] < 0 || s->pin[HD44780_E] < 0) {
+        error_setg(errp, "rpi-hd44780: rs and e are required");
+        return;
+    }
+    for (i = HD44780_D0 + 4; i < HD44780_LINES; i++) {
+        if (s->pin[i] < 0) {
+            error_setg(errp, "rpi-hd44780: d4-d7 are required");
+            return;
+        }
+    }
+    s->bus8 = true;
+    for (i = 0; i < HD44780_LINES; i++) {
+        if (s->pin[i] >= RPI_GPIO_NUM_PINS) {
+            error_setg(errp, "rpi-hd44780: pin %d is not a GPIO", s->pin[i]);
+            return;
+        }
+        if (s->pin[i] < 0) {
+            s->bus8 = false;
+        }
+    }
+    if (s->cols < 1 || s->cols > HD44780_MAX_COLS ||
+        s->rows < 1 || s->rows > HD44780_MAX_ROWS ||
+        s->cols * s->rows > HD44780_DDRAM) {
+        error_setg(errp, "rpi-hd44780: unsupported %ux%u geometry",
+                   s->cols, s->rows);
+        return;
+    }
+
+    gpio = DEVICE(object_resolve_path_type("", TYPE_RPI_GPIO, &ambiguous));
+    if (!gpio) {
+        error_setg(errp, "rpi-hd44780: the machine has no " TYPE_RPI_GPIO);
+        return;
+    }
+
+    qdev_init_gpio_in(dev, hd44780_line, HD44780_LINES);
+    for (i = 0; i < HD44780_LINES; i++) {
+        if (s->pin[i] >= 0) {
+            qdev_connect_gpio_out(gpio, s->pin[i], qdev_get_gpio_in(dev, i));
+        }
+    }
+
+    /* The display still works without the segment, it just can't be seen */
+    key = ftok("/proc/cpuinfo", s->shm_id);
+    shmid = shmget(key, sizeof(shared_hd44780_state), 0666 | IPC_CREAT);
+    p = (shmid == -1) ? (void *)-1 : shmat(shmid, NULL, 0);
+    if (p == (void *)-1) {
+        error_report("rpi-hd44780: no shared memory segment: %s",
+                     strerror(errno));
+    } else {
+        s->shm = p;
+    }
+
+    qemu_register_reset(rpi_hd44780_reset, s);
+    rpi_hd44780_reset(s);
+}
+
+static Property rpi_hd44780_properties[] = {
+    DEFINE_PROP_INT32("rs", RPIHD44780State, pin[HD44780_RS], -1),
+    DEFINE_PROP_INT32("e",  RPIHD44780State, pin[HD44780_E], -1),
+    DEFINE_PROP_INT32("d0", RPIHD44780State, pin[HD44780_D0 + 0], -1),
+    DEFINE_PROP_INT32("d1", RPIHD44780State, pin[HD44780_D0 + 1], -1),
+    DEFINE_PROP_INT32("d2", RPIHD44780State, pin[HD44780_D0 + 2], -1),
+    DEFINE_PROP_INT32("d3", RPIHD44780State, pin[HD44780_D0 + 3], -1),
+    DEFINE_PROP_INT32("d4", RPIHD44780State, pin[HD44780_D0 + 4], -1),
+    DEFINE_PROP_INT32("d5", RPIHD44780State, pin[HD44780_D0 + 5], -1),
+    DEFINE_PROP_INT32("d6", RPIHD44780State, pin[HD44780_D0 + 6], -1),
+    DEFINE_PROP_INT32("d7", RPIHD44780State, pin[HD44780_D0 + 7], -1),
+    DEFINE_PROP_UINT32("cols", RPIHD44780State, cols, 16),
+    DEFINE_PROP_UINT32("rows", RPIHD44780State, rows, 2),
+    DEFINE_PROP_UINT32("shm-id", RPIHD44780State, shm_id, 0x85),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void rpi_hd44780_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->realize = rpi_hd44780_realize;
+    dc->props = rpi_hd44780_properties;
+    dc->vmsd = &vmstate_rpi_hd44780;
+    dc->desc = "HD44780 character LCD on rpi_gpio pins";
+    set_bit(DEVICE_CATEGORY_DISPLAY, dc->categories);
+}
+
+static const TypeInfo rpi_hd44780_info = {
+    .name          = TYPE_RPI_HD44780,
+    .parent        = TYPE_DEVICE,
+    .instance_size = sizeof(RPIHD44780State),
+    .class_init    = rpi_hd44780_class_init,
+};
+
+static void rpi_hd44780_register_types(void)
+{
+    type_register_static(&rpi_hd44780_info);
+}
+
+type_init(rpi_hd44780_register_types)
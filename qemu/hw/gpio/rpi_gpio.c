@@ -4,9 +4,22 @@
 
 #include "qemu/osdep.h"
 #include "hw/sysbus.h"
+#include "qemu/timer.h"
+#include "sysemu/replay.h"
+#include "trace.h"
+#include "qapi/error.h"
+#include "qemu/host-utils.h"
+#include "qemu/atomic.h"
+#include "qapi/visitor.h"
+#include "hw/gpio/rpi_gpio.h"
+#include "hw/gpio/rpi_gpio_vcd.h"
 #include <sys/shm.h>
 #include <errno.h>
 #include <string.h>
+#ifdef CONFIG_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 /* Macros to enable debug messages */
 #ifdef DEBUG_RPI_GPIO
@@ -20,9 +33,49 @@ do { fprintf(stderr, "rpi_gpio: error: " fmt , ## __VA_ARGS__); exit(1);} while
 do { fprintf(stderr, "rpi_gpio: error: " fmt , ## __VA_ARGS__);} while (0)
 #endif
 
-#define TYPE_RPI_GPIO "rpi_gpio"
 #define RPI_GPIO(obj) OBJECT_CHECK(RPI_GPIO_State, (obj), TYPE_RPI_GPIO)
 
+/* Paravirtual access (pv property).  Two pages of ordinary RAM follow
+   the registers, so the guest reads and sets pins without trapping into
+   QEMU:
+     RPI_GPIO_PV_OFFSET      the shared_gpio_state segment, read only.  A
+                             pin's level is (GPLEVx & ~PV_MASKx) |
+                             (PV_LEVx & PV_MASKx), as GPLEVx would read.
+     RPI_GPIO_PV_OUT_OFFSET  the guest's OUTSTATE0/1 words.  The device
+                             takes the bits that changed, so they can be
+                             updated in place.
+   The segment stays QEMU's and the host's: only they write it, and
+   output changes reach host readers through the SEQ seqlock.
+   RPI_GPIO_PV_CTRL reads back RPI_GPIO_PV_MAGIC when the pages are there;
+   writing 1 to it rings the doorbell (the pages are synced with the device
+   now) and keeps the output page sampled every edge-poll-us, 0 stops that.
+*/
+#define RPI_GPIO_REGS_SIZE 0x1000
+#define RPI_GPIO_PV_CTRL   0xc0
+#define RPI_GPIO_PV_MAGIC  0x52505056   /* "RPPV" */
+#define RPI_GPIO_PV_OFFSET 0x1000
+#define RPI_GPIO_PV_OUT_OFFSET 0x2000
+#define RPI_GPIO_PV_SIZE   0x1000
+
+/* Waveform generators.  Each slot toggles one output pin from a virtual
+   clock timer, high for MARK ns then low for SPACE ns, so software PWM
+   and tones need no guest CPU.  A MARK or SPACE of 0 holds the pin low
+   or high, other times below RPI_GPIO_WAVE_MIN_NS are raised to it; new
+   times take effect at the next edge.  While the pin is not an output
+   the generator keeps time but leaves OUTSTATE alone.  Moving a running
+   generator to another pin drives the old one low; disabling it leaves
+   the pin where it is.  RPI_GPIO_WAVE_INFO reads back the number of slots.
+     +0x0 CTRL   bit 31 enable, bits 5-0 BCM pin
+     +0x4 MARK
+     +0x8 SPACE
+*/
+#define RPI_GPIO_WAVE_INFO   0xc4
+#define RPI_GPIO_WAVE_BASE   0x100
+#define RPI_GPIO_WAVE_SLOTS  8
+#define RPI_GPIO_WAVE_STRIDE 0x10
+#define RPI_GPIO_WAVE_ENABLE (1u << 31)
+#define RPI_GPIO_WAVE_MIN_NS 1000   /* Shorter edges would starve the main loop */
+
 /* shared_gpio_state includes the registers to be shared with the host */
 typedef struct shared_gpio_state {
 
@@ -36,14 +89,54 @@ typedef struct shared_gpio_state {
   uint32_t GPLEV1;     /* Input level register for pins 32-53 */
   uint32_t OUTSTATE0;  /* Derived output state for pins  0-31 based on SET and CLR registers */
   uint32_t OUTSTATE1;  /* Derived output state for pins 32-53 based on SET and CLR registers */
+  uint64_t MMIO_READS;   /* Guest register reads, each one an exit from translated code */
+  uint64_t MMIO_WRITES;  /* Guest register writes */
+  uint64_t OUTPUT_EDGES; /* Level changes on output pins */
+  uint32_t SEQ;          /* Odd while GPFSELx/OUTSTATEx are updated; futex for readers waiting on a change */
+  uint32_t WAITERS;      /* Host readers blocked on SEQ */
+  int64_t CHANGE_NS;     /* Host CLOCK_MONOTONIC of the last change, under SEQ */
+  int64_t INPUT_NS;      /* Host CLOCK_MONOTONIC of the last GPLEVx write, if the host stamps it */
+  uint32_t PV_MASK0;     /* Under pv: GPLEV0 bits the device decides (not inputs, or driven by other models) */
+  uint32_t PV_MASK1;     /* and GPLEV1 bits */
+  uint32_t PV_LEV0;      /* Their levels */
+  uint32_t PV_LEV1;
 
 } shared_gpio_state;
 
+/* Statistics, read with qom-get on the device (and the rpi_gpio_* trace
+   events for individual accesses):
+     reg-reads, reg-writes  guest accesses per register
+     pin-toggles            level changes per pin
+     input-latency          histogram of host time from a host input change
+                            to the guest reading GPLEVx: bucket i counts
+                            latencies of 2^(i-1) to 2^i - 1 ns
+   The start of a change is the INPUT_NS stamp in the shared segment when
+   the host writer sets one, otherwise when the device first sampled it.
+   Everything from RPI_GPIO_WAVE_BASE up (the wave generators) is counted
+   as one register.
+*/
+#define RPI_GPIO_STAT_REGS      (RPI_GPIO_WAVE_BASE / 4 + 1)
+#define RPI_GPIO_STAT_WAVE      (RPI_GPIO_STAT_REGS - 1)
+#define RPI_GPIO_LATENCY_BUCKETS 40
+
+typedef struct RPIGPIOWave {
+    struct RPI_GPIO_State *s;
+    QEMUTimer *timer;
+    uint32_t ctrl;
+    uint32_t mark;
+    uint32_t space;
+    uint32_t level;     /* Generator output: 1 during the mark */
+    int64_t next;       /* Virtual time of the next edge */
+} RPIGPIOWave;
+
 /* RPI_GPIO_State represents the device and its memory structure. */
 /* Refer to section 6.1 of the Broadcom BCM2835 ARM Peripherials Guide */
 typedef struct RPI_GPIO_State {
     SysBusDevice parent_obj;
+    MemoryRegion container;
     MemoryRegion iomem;
+    MemoryRegion pv_ram;    /* Guest view of the shared page when pv is set */
+    MemoryRegion pv_out_ram;/* and the page the guest writes its outputs to */
     uint32_t GPFSEL0;   /* 0x00 Function Select Pins 0-9   */
     uint32_t GPFSEL1;   /* 0x04 Function Select Pins 10-19 */
     uint32_t GPFSEL2;   /* 0x08 Function Select Pins 20-29 */
@@ -88,17 +181,181 @@ typedef struct RPI_GPIO_State {
     uint32_t test;      /* 0xb0 */
     uint32_t OUTSTATE0; /* Derived output state for pins  0-31 based on SET and CLR registers */
     uint32_t OUTSTATE1; /* Derived output state for pins  32-53 based on SET and CLR registers */
-    uint32_t writectr;
-    qemu_irq out[54];   /* qdev currently wants an interrupt line for every output.  BCM2835 only has 3 multiplexed lines.  Let's pretend it's 54 for now. */
+    uint64_t reg_reads[RPI_GPIO_STAT_REGS];
+    uint64_t reg_writes[RPI_GPIO_STAT_REGS];
+    uint64_t pin_toggles[RPI_GPIO_NUM_PINS];
+    uint64_t input_latency[RPI_GPIO_LATENCY_BUCKETS];
+    int64_t input_ns;       /* Host time of a host input change the guest has not read yet, 0 if none */
+    int64_t input_stamp;    /* Last INPUT_NS used for one */
+    uint32_t host_lev[2];   /* Host input levels last sampled (and recorded to / replayed from the replay log) */
+    uint32_t lev_traced[2]; /* GPLEVx value of the last rpi_gpio_lev_read event */
+    char *vcd_path;         /* "vcd" property: dump pin activity to this file */
+    RPIGPIOVcd *vcd;
+    uint32_t in_mask[2];    /* Pins selected as inputs, per bank */
+    uint32_t out_mask[2];   /* Pins selected as outputs, per bank */
+    uint32_t pin_level[2];  /* Level on each pin: OUTSTATE for outputs, GPLEV otherwise */
+    uint32_t drive_level[2];/* Level the SoC drives: OUTSTATE for outputs, 1 otherwise (out[] lines) */
+    uint32_t dev_mask[2];   /* Pins driven by other device models through the GPIO inputs */
+    uint32_t dev_lev[2];    /* and their levels */
+    uint32_t edge_poll_us;  /* "edge-poll-us" property: how often host inputs (and the pv page) are sampled while detection (or the page) is enabled */
+    QEMUTimer *edge_timer;
+    qemu_irq irq;           /* Event detect interrupt (any GPEDS bit set) */
+    bool pv;                /* "pv" property: map the shared page into the guest */
+    bool pv_active;         /* Guest has enabled the page through RPI_GPIO_PV_CTRL */
+    uint32_t *pv_out;       /* OUTSTATE0/1 in the output page */
+    uint32_t pv_seen[2];    /* and their values when last synced */
+    uint32_t shm_id;        /* "shm-id" property: ftok project id of the shared segment */
+    RPIGPIOWave wave[RPI_GPIO_WAVE_SLOTS];
+    qemu_irq out[RPI_GPIO_NUM_PINS];   /* qdev currently wants an interrupt line for every output.  BCM2835 only has 3 multiplexed lines.  Let's pretend it's 54 for now. */
     shared_gpio_state *shm;  /* pointer to shared struct */
     const unsigned char *id;
 } RPI_GPIO_State;
 
+static void rpi_gpio_update_fsel(RPI_GPIO_State *s);
+
+static void rpi_gpio_drive_reset(RPI_GPIO_State *s);
+
+static void rpi_gpio_publish(RPI_GPIO_State *s);
+
+static void rpi_gpio_edge_timer_arm(RPI_GPIO_State *s);
+
+static void rpi_gpio_pv_pull(RPI_GPIO_State *s);
+
+static void rpi_gpio_pv_push(RPI_GPIO_State *s);
+
+/* Take outputs the guest set through the pv page but the device has not
+   seen yet, which the output page does not keep */
+static void rpi_gpio_pre_save(void *opaque)
+{
+    rpi_gpio_pv_pull((RPI_GPIO_State *)opaque);
+}
+
+/* Besides the device, put back what host programs see in the shared
+   segment: the outputs, and the inputs the device last took from it.
+   Under pv the segment is not migrated, so the PV_* words the guest reads
+   in it are rebuilt here too, from the function selects, GPLEV and the
+   lines driven by other models, which are all in the vmstate.
+   Loading follows a reset, which stopped the edge timer */
+static int rpi_gpio_post_load(void *opaque, int version_id)
+{
+    RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
+
+    rpi_gpio_update_fsel(s);
+    rpi_gpio_drive_reset(s);
+    s->pin_level[0] = (s->OUTSTATE0 & s->out_mask[0]) | (s->GPLEV0 & ~s->out_mask[0]);
+    s->pin_level[1] = (s->OUTSTATE1 & s->out_mask[1]) | (s->GPLEV1 & ~s->out_mask[1]);
+    rpi_gpio_publish(s);
+    rpi_gpio_pv_push(s);
+    s->shm->GPLEV0 = s->host_lev[0];
+    s->shm->GPLEV1 = s->host_lev[1];
+    rpi_gpio_edge_timer_arm(s);
+    return 0;
+}
+
+static bool rpi_gpio_outputs_needed(void *opaque)
+{
+    RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
+
+    return (s->OUTSTATE0 | s->OUTSTATE1 | s->host_lev[0] | s->host_lev[1]) != 0;
+}
+
+static const VMStateDescription vmstate_rpi_gpio_outputs = {
+    .name = "rpi_gpio/outputs",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = rpi_gpio_outputs_needed,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT32(OUTSTATE0, RPI_GPIO_State),
+        VMSTATE_UINT32(OUTSTATE1, RPI_GPIO_State),
+        VMSTATE_UINT32_ARRAY(host_lev, RPI_GPIO_State, 2),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static bool rpi_gpio_lines_needed(void *opaque)
+{
+    RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
+
+    return (s->dev_mask[0] | s->dev_mask[1]) != 0;
+}
+
+static const VMStateDescription vmstate_rpi_gpio_lines = {
+    .name = "rpi_gpio/lines",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = rpi_gpio_lines_needed,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT32_ARRAY(dev_mask, RPI_GPIO_State, 2),
+        VMSTATE_UINT32_ARRAY(dev_lev, RPI_GPIO_State, 2),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static bool rpi_gpio_pv_needed(void *opaque)
+{
+    RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
+
+    return s->pv_active;
+}
+
+static const VMStateDescription vmstate_rpi_gpio_pv = {
+    .name = "rpi_gpio/pv",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = rpi_gpio_pv_needed,
+    .fields = (VMStateField[]) {
+        VMSTATE_BOOL(pv_active, RPI_GPIO_State),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static const VMStateDescription vmstate_rpi_gpio_wave = {
+    .name = "rpi_gpio_wave",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT32(ctrl, RPIGPIOWave),
+        VMSTATE_UINT32(mark, RPIGPIOWave),
+        VMSTATE_UINT32(space, RPIGPIOWave),
+        VMSTATE_UINT32(level, RPIGPIOWave),
+        VMSTATE_INT64(next, RPIGPIOWave),
+        VMSTATE_TIMER_PTR(timer, RPIGPIOWave),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static bool rpi_gpio_waves_needed(void *opaque)
+{
+    RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
+    int i;
+
+    for (i = 0; i < RPI_GPIO_WAVE_SLOTS; i++) {
+        if (s->wave[i].ctrl & RPI_GPIO_WAVE_ENABLE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const VMStateDescription vmstate_rpi_gpio_waves = {
+    .name = "rpi_gpio/waves",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = rpi_gpio_waves_needed,
+    .fields = (VMStateField[]) {
+        VMSTATE_STRUCT_ARRAY(wave, RPI_GPIO_State, RPI_GPIO_WAVE_SLOTS, 1,
+                             vmstate_rpi_gpio_wave, RPIGPIOWave),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
 /* Device desciption required by QDev */
 static const VMStateDescription vmstate_rpi_gpio = {
     .name = "rpi_gpio",
     .version_id = 0,
     .minimum_version_id = 0,
+    .pre_save = rpi_gpio_pre_save,
+    .post_load = rpi_gpio_post_load,
     .fields = (VMStateField[]) {
       VMSTATE_UINT32(GPFSEL0, RPI_GPIO_State),
       VMSTATE_UINT32(GPFSEL1, RPI_GPIO_State),
@@ -130,6 +387,13 @@ static const VMStateDescription vmstate_rpi_gpio = {
       VMSTATE_UINT32(GPPUDCLK0, RPI_GPIO_State),
       VMSTATE_UINT32(GPPUDCLK1, RPI_GPIO_State),
       VMSTATE_END_OF_LIST()
+    },
+    .subsections = (const VMStateDescription*[]) {
+        &vmstate_rpi_gpio_pv,
+        &vmstate_rpi_gpio_waves,
+        &vmstate_rpi_gpio_lines,
+        &vmstate_rpi_gpio_outputs,
+        NULL
     }
 };
 
@@ -146,91 +410,438 @@ static uint32_t rpi_get_pin_function(RPI_GPIO_State *s, int pin){
 
 }
 
+/* Recompute the per bank input and output pin masks after a GPFSELx change */
+static void rpi_gpio_update_fsel(RPI_GPIO_State *s)
+{
+  int i;
+  uint32_t fsel;
+
+  s->in_mask[0] = s->in_mask[1] = 0;
+  s->out_mask[0] = s->out_mask[1] = 0;
+  for (i=0; i<54; i++){
+    fsel = rpi_get_pin_function(s,i);
+    if (fsel == 0) s->in_mask[i/32] |= (1 << (i%32));
+    else if (fsel == 1) s->out_mask[i/32] |= (1 << (i%32));
+  }
+}
+
+/* Set the event detect status bits for a change of pin levels from
+   old[] to new[] and update the interrupt line.
+   Edge detection is synchronous to the emulated clock, so the async
+   enables (GPARENx/GPAFENx) behave like the normal ones.
+*/
+static void rpi_gpio_detect(RPI_GPIO_State *s, const uint32_t *old, const uint32_t *new)
+{
+  uint32_t rise0 = ~old[0] & new[0], fall0 = old[0] & ~new[0];
+  uint32_t rise1 = ~old[1] & new[1], fall1 = old[1] & ~new[1];
+
+  s->GPEDS0 |= (rise0 & (s->GPREN0 | s->GPAREN0)) | (fall0 & (s->GPFEN0 | s->GPAFEN0)) |
+               (new[0] & s->GPHEN0) | (~new[0] & s->GPLEN0);
+  s->GPEDS1 |= (rise1 & (s->GPREN1 | s->GPAREN1)) | (fall1 & (s->GPFEN1 | s->GPAFEN1)) |
+               (new[1] & s->GPHEN1) | (~new[1] & s->GPLEN1);
+  s->GPEDS1 &= 0x003fffff;
+
+  qemu_set_irq(s->irq, (s->GPEDS0 | s->GPEDS1) != 0);
+}
+
+/* What the SoC drives onto each pin, as seen by other device models:
+   the output level for outputs; anything else is released.
+*/
+static void rpi_gpio_drive(RPI_GPIO_State *s, uint32_t *drive)
+{
+  drive[0] = (s->OUTSTATE0 & s->out_mask[0]) | ~s->out_mask[0];
+  drive[1] = ((s->OUTSTATE1 & s->out_mask[1]) | ~s->out_mask[1]) & 0x003fffff;
+}
+
+/* Take the current drive levels as the ones the out[] lines already
+   show, without raising them (after reset or migration).
+*/
+static void rpi_gpio_drive_reset(RPI_GPIO_State *s)
+{
+  rpi_gpio_drive(s, s->drive_level);
+}
+
+/* Recompute the level on each pin (outputs show OUTSTATE, everything
+   else shows GPLEV), run event detection, send changes to the VCD
+   writer and tell the models on the out[] lines what the SoC drives.
+*/
+static void rpi_gpio_update_levels(RPI_GPIO_State *s)
+{
+  uint32_t level[2], drive[2], changed;
+  int b, pin;
+
+  /* The pv pages are synced with the device below: first take what the
+     guest wrote to them */
+  rpi_gpio_pv_pull(s);
+
+  level[0] = (s->OUTSTATE0 & s->out_mask[0]) | (s->GPLEV0 & ~s->out_mask[0]);
+  level[1] = (s->OUTSTATE1 & s->out_mask[1]) | (s->GPLEV1 & ~s->out_mask[1]);
+
+  rpi_gpio_detect(s, s->pin_level, level);
+
+  if (level[0] != s->pin_level[0] || level[1] != s->pin_level[1]){
+    s->shm->OUTPUT_EDGES += ctpop32((level[0] ^ s->pin_level[0]) & s->out_mask[0]) +
+                            ctpop32((level[1] ^ s->pin_level[1]) & s->out_mask[1]);
+    for (b = 0; b < 2; b++){
+      changed = level[b] ^ s->pin_level[b];
+      while (changed){
+        pin = ctz32(changed);
+        changed &= changed - 1;
+        if (b * 32 + pin < RPI_GPIO_NUM_PINS){
+          s->pin_toggles[b * 32 + pin]++;
+          trace_rpi_gpio_pin(b * 32 + pin, (level[b] >> pin) & 1);
+        }
+      }
+    }
+    s->pin_level[0] = level[0];
+    s->pin_level[1] = level[1];
+    if (s->vcd){
+      rpi_gpio_vcd_sample(s->vcd, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL), level);
+    }
+  }
+
+  /* A model's handler may drive its pin straight back, so the new drive
+     levels are recorded before any line is raised */
+  rpi_gpio_drive(s, drive);
+  for (b = 0; b < 2; b++){
+    changed = drive[b] ^ s->drive_level[b];
+    s->drive_level[b] = drive[b];
+    while (changed){
+      pin = ctz32(changed);
+      changed &= changed - 1;
+      qemu_set_irq(s->out[b * 32 + pin], (drive[b] >> pin) & 1);
+    }
+  }
+
+  rpi_gpio_pv_push(s);
+}
+
+static bool rpi_gpio_detect_enabled(RPI_GPIO_State *s)
+{
+  return (s->GPREN0 | s->GPREN1 | s->GPFEN0 | s->GPFEN1 |
+          s->GPHEN0 | s->GPHEN1 | s->GPLEN0 | s->GPLEN1 |
+          s->GPAREN0 | s->GPAREN1 | s->GPAFEN0 | s->GPAFEN1) != 0;
+}
+
+/* Host inputs only reach the device when the guest reads a register.
+   While any event detection is enabled, also sample them periodically
+   so that an edge raises the interrupt without the guest polling.
+   The same goes for outputs written through the paravirtual page.
+*/
+static void rpi_gpio_edge_timer_arm(RPI_GPIO_State *s)
+{
+  if ((rpi_gpio_detect_enabled(s) || s->pv_active) && !timer_pending(s->edge_timer)){
+    timer_mod(s->edge_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+              (int64_t)s->edge_poll_us * SCALE_US);
+  }
+}
+
+/* With the paravirtual pages enabled the guest sets its outputs by
+   writing OUTSTATEx in the output page.  Fold the bits it changed since
+   the page was last synced into the device state, and publish them,
+   before anything else looks at it; bits for pins that are not outputs
+   are dropped.
+*/
+static void rpi_gpio_pv_pull(RPI_GPIO_State *s)
+{
+  uint32_t out[2], changed[2];
+
+  if (!s->pv_active) return;
+
+  out[0] = atomic_read(&s->pv_out[0]);
+  out[1] = atomic_read(&s->pv_out[1]);
+  changed[0] = (out[0] ^ s->pv_seen[0]) & s->out_mask[0];
+  changed[1] = (out[1] ^ s->pv_seen[1]) & s->out_mask[1];
+  s->pv_seen[0] = out[0];
+  s->pv_seen[1] = out[1];
+  if (!(changed[0] | changed[1])) return;
+
+  s->OUTSTATE0 = (s->OUTSTATE0 & ~changed[0]) | (out[0] & changed[0]);
+  s->OUTSTATE1 = (s->OUTSTATE1 & ~changed[1]) | (out[1] & changed[1]);
+  rpi_gpio_publish(s);
+}
+
+/* Bring the pv pages up to date with the device: the levels the guest
+   cannot take from the host's GPLEVx, and the outputs as they now are.
+   The guest runs on this thread, so it never sees them half written.
+*/
+static void rpi_gpio_pv_push(RPI_GPIO_State *s)
+{
+  shared_gpio_state *shm = s->shm;
+
+  if (!s->pv_active) return;
+
+  shm->PV_MASK0 = ~s->in_mask[0] | s->dev_mask[0];
+  shm->PV_MASK1 = ~s->in_mask[1] | s->dev_mask[1];
+  shm->PV_LEV0 = s->GPLEV0 & shm->PV_MASK0;
+  shm->PV_LEV1 = s->GPLEV1 & shm->PV_MASK1;
+  s->pv_seen[0] = s->pv_out[0] = s->OUTSTATE0;
+  s->pv_seen[1] = s->pv_out[1] = s->OUTSTATE1;
+}
+
+/* Copy the function selects and outputs to the shared segment.  Host
+   readers take consistent snapshots with the SEQ seqlock, and the ones
+   blocked on it (WAITERS) are woken when something actually changed.
+*/
+static void rpi_gpio_publish(RPI_GPIO_State *s)
+{
+  shared_gpio_state *shm = s->shm;
+
+  if (shm->GPFSEL0 == s->GPFSEL0 && shm->GPFSEL1 == s->GPFSEL1 &&
+      shm->GPFSEL2 == s->GPFSEL2 && shm->GPFSEL3 == s->GPFSEL3 &&
+      shm->GPFSEL4 == s->GPFSEL4 && shm->GPFSEL5 == s->GPFSEL5 &&
+      shm->OUTSTATE0 == s->OUTSTATE0 && shm->OUTSTATE1 == s->OUTSTATE1){
+    return;
+  }
+
+  atomic_set(&shm->SEQ, shm->SEQ + 1);
+  smp_wmb();
+  shm->GPFSEL0 = s->GPFSEL0;
+  shm->GPFSEL1 = s->GPFSEL1;
+  shm->GPFSEL2 = s->GPFSEL2;
+  shm->GPFSEL3 = s->GPFSEL3;
+  shm->GPFSEL4 = s->GPFSEL4;
+  shm->GPFSEL5 = s->GPFSEL5;
+  shm->OUTSTATE0 = s->OUTSTATE0;
+  shm->OUTSTATE1 = s->OUTSTATE1;
+  shm->CHANGE_NS = get_clock();
+  smp_wmb();
+  atomic_set(&shm->SEQ, shm->SEQ + 1);
+
+  /* Pairs with the reader's increment of WAITERS before it rechecks SEQ */
+  smp_mb();
+  if (atomic_read(&shm->WAITERS)){
+#ifdef CONFIG_LINUX
+    syscall(__NR_futex, &shm->SEQ, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+  }
+}
+
 /* Write Update function called after a write detection performs the following tasks:
       1.  Calculates OUTSTATE fields according to GPSETx and GPCLRx registers
       2.  Updates the shared_gpio_state
+   A write can change any number of pins, so this works a bank at a time
+   on the cached output masks rather than pin by pin.
 */
 static void rpi_gpio_update(RPI_GPIO_State *s)
 {
-  int i;
-  uint32_t mask;
-
-  for (i=0; i<32; i++){
-    mask = (1 << i);
-    if (rpi_get_pin_function(s,i) == 1){    /* make sure its an output */
-      if (s->GPSET0 & mask){          /* set flag is set */
-        s->OUTSTATE0 |= mask;            /* set the state bit */
-        s->GPSET0 &= ~mask;           /* clear the set bit */
-      }
-      else if (s->GPCLR0 & mask){     /* clear flag is set */
-        s->OUTSTATE0 &= ~mask;            /* set the state bit */
-        s->GPCLR0 &= ~mask;           /* clear the set bit */
-      }
-    }
+  uint32_t set, clr;
+
+  /* Set takes precedence; bits for pins that are not outputs stay
+     pending until the pin becomes one */
+  set = s->GPSET0 & s->out_mask[0];
+  clr = s->GPCLR0 & s->out_mask[0] & ~set;
+  s->OUTSTATE0 = (s->OUTSTATE0 | set) & ~clr;
+  s->GPSET0 &= ~set;
+  s->GPCLR0 &= ~clr;
+
+  set = s->GPSET1 & s->out_mask[1];
+  clr = s->GPCLR1 & s->out_mask[1] & ~set;
+  s->OUTSTATE1 = (s->OUTSTATE1 | set) & ~clr;
+  s->GPSET1 &= ~set;
+  s->GPCLR1 &= ~clr;
+
+  rpi_gpio_publish(s);
+  rpi_gpio_update_levels(s);
+
+}
+
+/* Drive a generator's pin for the phase that starts at `now' and
+   schedule the edge that ends it.  Edges are timed from the previous
+   deadline rather than from when the timer actually ran, so the period
+   does not drift.
+*/
+static void rpi_gpio_wave_step(RPIGPIOWave *w, int64_t now)
+{
+  RPI_GPIO_State *s = w->s;
+  int pin = w->ctrl & 0x3f;
+  uint32_t *outstate = (pin < 32) ? &s->OUTSTATE0 : &s->OUTSTATE1;
+
+  if (w->mark == 0) w->level = 0;
+  else if (w->space == 0) w->level = 1;
+  else w->level = !w->level;
+
+  if (s->out_mask[pin / 32] & (1u << (pin & 31))){
+    if (w->level) *outstate |= (1u << (pin & 31));
+    else *outstate &= ~(1u << (pin & 31));
   }
-  for (i=32; i<54; i++){
-    mask = (1 << (i-32));
-    if (rpi_get_pin_function(s,i) == 1){    /* make sure its an output */
-      if (s->GPSET1 & mask){          /* set flag is set */
-        s->OUTSTATE1 |= mask;            /* set the state bit */
-        s->GPSET1 &= ~mask;           /* clear the set bit */
-      }
-      else if (s->GPCLR1 & mask){     /* clear flag is set */
-        s->OUTSTATE1 &= ~mask;            /* set the state bit */
-        s->GPCLR1 &= ~mask;           /* clear the set bit */
-      }
-    }
+
+  if (w->mark && w->space){
+    w->next = now + (w->level ? w->mark : w->space);
+    timer_mod(w->timer, w->next);
+  }
+  else{
+    timer_del(w->timer);
+  }
+}
+
+static void rpi_gpio_wave_cb(void *opaque)
+{
+    RPIGPIOWave *w = (RPIGPIOWave *)opaque;
+
+    rpi_gpio_pv_pull(w->s);
+    rpi_gpio_wave_step(w, w->next);
+    rpi_gpio_update(w->s);
+}
+
+/* (Re)start a generator with its mark.  Called when it is enabled, and
+   when new times mean it has to start or stop toggling.
+*/
+static void rpi_gpio_wave_restart(RPIGPIOWave *w)
+{
+  w->level = 0;
+  rpi_gpio_wave_step(w, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+}
+
+static uint32_t rpi_gpio_wave_read(RPI_GPIO_State *s, hwaddr offset)
+{
+  RPIGPIOWave *w = &s->wave[offset / RPI_GPIO_WAVE_STRIDE];
+
+  switch (offset % RPI_GPIO_WAVE_STRIDE){
+    case 0x0: return w->ctrl;
+    case 0x4: return w->mark;
+    case 0x8: return w->space;
   }
+  return 0;
+}
 
-  s->shm->GPFSEL0 = s->GPFSEL0;
-  s->shm->GPFSEL1 = s->GPFSEL1;
-  s->shm->GPFSEL2 = s->GPFSEL2;
-  s->shm->GPFSEL3 = s->GPFSEL3;
-  s->shm->GPFSEL4 = s->GPFSEL4;
-  s->shm->GPFSEL5 = s->GPFSEL5;
-  s->shm->OUTSTATE0 = s->OUTSTATE0;
-  s->shm->OUTSTATE1 = s->OUTSTATE1;
+static void rpi_gpio_wave_write(RPI_GPIO_State *s, hwaddr offset, uint32_t value)
+{
+  RPIGPIOWave *w = &s->wave[offset / RPI_GPIO_WAVE_STRIDE];
+  uint32_t old = w->ctrl;
+  int pin;
+
+  switch (offset % RPI_GPIO_WAVE_STRIDE){
+    case 0x0:
+      w->ctrl = value & (RPI_GPIO_WAVE_ENABLE | 0x3f);
+      if ((w->ctrl & 0x3f) >= 54) w->ctrl &= ~RPI_GPIO_WAVE_ENABLE;
+      pin = old & 0x3f;
+      if ((old & RPI_GPIO_WAVE_ENABLE) && (w->ctrl & RPI_GPIO_WAVE_ENABLE) &&
+          (w->ctrl & 0x3f) != pin &&
+          (s->out_mask[pin / 32] & (1u << (pin & 31)))){
+        if (pin < 32) s->OUTSTATE0 &= ~(1u << pin);
+        else s->OUTSTATE1 &= ~(1u << (pin - 32));
+      }
+      if (w->ctrl & RPI_GPIO_WAVE_ENABLE) rpi_gpio_wave_restart(w);
+      else timer_del(w->timer);
+      return;
+    case 0x4:
+      w->mark = (value && value < RPI_GPIO_WAVE_MIN_NS) ? RPI_GPIO_WAVE_MIN_NS : value;
+      break;
+    case 0x8:
+      w->space = (value && value < RPI_GPIO_WAVE_MIN_NS) ? RPI_GPIO_WAVE_MIN_NS : value;
+      break;
+    default:
+      return;
+  }
 
+  /* Already toggling and still should be: leave it to the next edge */
+  if ((w->ctrl & RPI_GPIO_WAVE_ENABLE) &&
+      (!w->mark || !w->space || !timer_pending(w->timer))){
+    rpi_gpio_wave_restart(w);
+  }
 }
 
 /* Read Update function called after a read detection is used to
    copy the GPLEVx registers (which may have been updated by the
-   emulation host) to the device state
+   emulation host) to the device state.
+
+   The host writes the shared levels at arbitrary points of guest
+   execution, so under record/replay the levels seen here are saved to
+   (or taken from) the replay log whenever they change.
 */
 static void rpi_gpio_update_from_shared(RPI_GPIO_State *s)
 {
 
-  int i, mask;
+  uint32_t lev[2];
+
+  rpi_gpio_pv_pull(s);
+
+  lev[0] = s->shm->GPLEV0;
+  lev[1] = s->shm->GPLEV1;
 
-  for (i=0; i<32; i++){
-    mask = (1 << i);
-    if (rpi_get_pin_function(s,i) == 0){ /* only check input pins */
-      if ((mask & s->shm->GPLEV0) > 0) s->GPLEV0 |= mask;
-      else s->GPLEV0 &= ~mask;
+  if (replay_mode == REPLAY_MODE_PLAY){
+    if (replay_gpio_input_load(0, s->host_lev, 2) &&
+        trace_event_get_state(TRACE_RPI_GPIO_INPUT_CHANGE)){
+      trace_rpi_gpio_input_change(s->host_lev[0], s->host_lev[1], get_clock(),
+                                  qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
     }
+    lev[0] = s->host_lev[0];
+    lev[1] = s->host_lev[1];
   }
-  for (i=32; i<54; i++){
-    mask = (1 << i);
-    if (rpi_get_pin_function(s,i) == 0){ /* only check input pins */
-      if ((mask & s->shm->GPLEV1) > 0) s->GPLEV1 |= mask;
-      else s->GPLEV1 &= ~mask;
+  else if (lev[0] != s->host_lev[0] || lev[1] != s->host_lev[1]){
+    if (replay_mode == REPLAY_MODE_RECORD){
+      replay_gpio_input_save(0, lev, 2);
+    }
+    s->host_lev[0] = lev[0];
+    s->host_lev[1] = lev[1];
+    if (trace_event_get_state(TRACE_RPI_GPIO_INPUT_CHANGE)){
+      trace_rpi_gpio_input_change(lev[0], lev[1], get_clock(),
+                                  qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    }
+    if (!s->input_ns){
+      /* A stamp we already used was for an earlier change: the host may
+         not have written this one's yet */
+      s->input_ns = atomic_read(&s->shm->INPUT_NS);
+      if (s->input_ns <= s->input_stamp || s->input_ns > get_clock()){
+        s->input_ns = get_clock();
+      }
+      else{
+        s->input_stamp = s->input_ns;
+      }
     }
   }
 
+  /* Pins driven by other device models ignore the host */
+  lev[0] = (lev[0] & ~s->dev_mask[0]) | (s->dev_lev[0] & s->dev_mask[0]);
+  lev[1] = (lev[1] & ~s->dev_mask[1]) | (s->dev_lev[1] & s->dev_mask[1]);
+
+  /* only update input pins */
+  s->GPLEV0 = (s->GPLEV0 & ~s->in_mask[0]) | (lev[0] & s->in_mask[0]);
+  s->GPLEV1 = (s->GPLEV1 & ~s->in_mask[1]) | (lev[1] & s->in_mask[1]);
+
+  rpi_gpio_update_levels(s);
+
 }
 
 
-/* Called by QDev upon read detection
-   Returns the device state field corresponding to the read address
-*/
-static uint64_t rpi_gpio_read(void *opaque, hwaddr offset,
-                          unsigned size)
+static void rpi_gpio_edge_timer_cb(void *opaque)
 {
     RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
 
-    rpi_gpio_update_from_shared(s);  //First update any input pins from the shared_gpio_state
+    rpi_gpio_update_from_shared(s);
+    rpi_gpio_edge_timer_arm(s);
+}
+
+/* Index of a register in the reg_reads/reg_writes statistics */
+static int rpi_gpio_stat_index(hwaddr offset)
+{
+  return offset < RPI_GPIO_WAVE_BASE ? offset / 4 : RPI_GPIO_STAT_WAVE;
+}
+
+/* The guest read GPLEVx: time how long ago the host changed an input */
+static void rpi_gpio_input_read(RPI_GPIO_State *s)
+{
+  int64_t ns;
+  int bucket;
+
+  if (!s->input_ns) return;
+
+  ns = get_clock() - s->input_ns;
+  s->input_ns = 0;
+  bucket = ns > 0 ? 64 - clz64(ns) : 0;
+  if (bucket >= RPI_GPIO_LATENCY_BUCKETS) bucket = RPI_GPIO_LATENCY_BUCKETS - 1;
+  s->input_latency[bucket]++;
+  trace_rpi_gpio_input_latency(ns);
+}
 
-    DPRINTF("rpi_gpio_debug:  rpi_gpio_read - offset=%02x, size=%d\n", (int)offset, size);
+/* Returns the device state field corresponding to the read address */
+static uint64_t rpi_gpio_read_reg(RPI_GPIO_State *s, hwaddr offset)
+{
+    if (offset >= RPI_GPIO_WAVE_BASE &&
+        offset < RPI_GPIO_WAVE_BASE + RPI_GPIO_WAVE_SLOTS * RPI_GPIO_WAVE_STRIDE) {
+        return rpi_gpio_wave_read(s, offset - RPI_GPIO_WAVE_BASE);
+    }
 
     switch (offset) {
       case 0x00:
@@ -246,8 +857,10 @@ static uint64_t rpi_gpio_read(void *opaque, hwaddr offset,
       case 0x14:
           return s->GPFSEL5;
       case 0x34:
+          rpi_gpio_input_read(s);
           return s->GPLEV0;
       case 0x38:
+          rpi_gpio_input_read(s);
           return s->GPLEV1;
       case 0x40:
           return s->GPEDS0;
@@ -283,6 +896,10 @@ static uint64_t rpi_gpio_read(void *opaque, hwaddr offset,
           return s->GPPUDCLK0;
       case 0x9c:
           return s->GPPUDCLK1;
+      case RPI_GPIO_PV_CTRL:
+          return s->pv ? RPI_GPIO_PV_MAGIC : 0;
+      case RPI_GPIO_WAVE_INFO:
+          return RPI_GPIO_WAVE_SLOTS;
       case 0x1c: /* GPSET0 (Write-Only) */
       case 0x20: /* GPSET1 (Write-Only) */
       case 0x28: /* GPCLR0 (Write-Only) */
@@ -310,6 +927,31 @@ err_out:
     return 0;
 }
 
+/* Called by QDev upon read detection */
+static uint64_t rpi_gpio_read(void *opaque, hwaddr offset,
+                          unsigned size)
+{
+    RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
+    uint64_t value;
+
+    s->shm->MMIO_READS++;
+    s->reg_reads[rpi_gpio_stat_index(offset)]++;
+    rpi_gpio_update_from_shared(s);  //First update any input pins from the shared_gpio_state
+
+    value = rpi_gpio_read_reg(s, offset);
+    trace_rpi_gpio_read(offset, value);
+
+    /* Reads that see new input levels, for the latency breakdown */
+    if ((offset == 0x34 || offset == 0x38) &&
+        trace_event_get_state(TRACE_RPI_GPIO_LEV_READ) &&
+        value != s->lev_traced[(offset - 0x34) / 4]) {
+        s->lev_traced[(offset - 0x34) / 4] = value;
+        trace_rpi_gpio_lev_read((offset - 0x34) / 4, value, get_clock(),
+                                qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    }
+    return value;
+}
+
 /* Called by QDev upon write detection
    Updates the device state according to the manipulated memory state
 */
@@ -318,9 +960,27 @@ static void rpi_gpio_write(void *opaque, hwaddr offset,
 {
     RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
 
-    s->writectr++;
-    DPRINTF("rpi_gpio_write - offset=%02x, size=%d, value=%d, writectr=%i\n", (int)offset, size, (uint32_t)value,s->writectr);
+    s->shm->MMIO_WRITES++;
+    s->reg_writes[rpi_gpio_stat_index(offset)]++;
+    trace_rpi_gpio_write(offset, value);
+
+    /* Writes that raise an output, for the latency breakdown */
+    if ((offset == 0x1c || offset == 0x20) &&
+        trace_event_get_state(TRACE_RPI_GPIO_SET_WRITE) &&
+        (value & s->out_mask[(offset - 0x1c) / 4] &
+         ~(offset == 0x1c ? s->OUTSTATE0 : s->OUTSTATE1))) {
+        trace_rpi_gpio_set_write((offset - 0x1c) / 4, value, get_clock(),
+                                 qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    }
 
+    rpi_gpio_pv_pull(s);  /* Pick up outputs the guest set through the page */
+
+    if (offset >= RPI_GPIO_WAVE_BASE &&
+        offset < RPI_GPIO_WAVE_BASE + RPI_GPIO_WAVE_SLOTS * RPI_GPIO_WAVE_STRIDE) {
+        rpi_gpio_wave_write(s, offset - RPI_GPIO_WAVE_BASE, value);
+        rpi_gpio_update(s);
+        return;
+    }
 
     switch (offset) {
       case 0x00:
@@ -354,10 +1014,10 @@ static void rpi_gpio_write(void *opaque, hwaddr offset,
           s->GPCLR1 = (value & 0xffffffff);
           break;
       case 0x40:
-          s->GPEDS0 = (value & 0xffffffff);
+          s->GPEDS0 &= ~(value & 0xffffffff);   /* Write 1 to clear */
           break;
       case 0x44:
-          s->GPEDS1 = (value & 0xffffffff);
+          s->GPEDS1 &= ~(value & 0xffffffff);
           break;
       case 0x4c:
           s->GPREN0 = (value & 0xffffffff);
@@ -404,6 +1064,13 @@ static void rpi_gpio_write(void *opaque, hwaddr offset,
       case 0x9c:
           s->GPPUDCLK1 = (value & 0xffffffff);
           break;
+      case RPI_GPIO_PV_CTRL:
+          if (!s->pv){
+              goto err_out;
+          }
+          s->pv_active = (value & 1) != 0;  /* Doorbell */
+          rpi_gpio_pv_push(s);
+          break;
       case 0x34: /* GPLEV0 (Read-Only) */
       case 0x38: /* GPLEV1 (Read-Only) */
       case 0x18: /* res0 */
@@ -422,7 +1089,11 @@ static void rpi_gpio_write(void *opaque, hwaddr offset,
       default:
           goto err_out;
     }
+    if (offset <= 0x14){
+        rpi_gpio_update_fsel(s); /* GPFSELx changed */
+    }
     rpi_gpio_update(s); /* Set output levels and update shared_gpio_state */
+    rpi_gpio_edge_timer_arm(s);
     return;
 err_out:
     qemu_log_mask(LOG_GUEST_ERROR,
@@ -432,6 +1103,7 @@ err_out:
 static void rpi_gpio_reset(DeviceState *dev)
 {
     RPI_GPIO_State *s = RPI_GPIO(dev);
+    int i;
 
     s->GPFSEL0   = 0;
     s->GPFSEL1   = 0;
@@ -462,28 +1134,53 @@ static void rpi_gpio_reset(DeviceState *dev)
     s->GPPUD     = 0;
     s->GPPUDCLK0 = 0;
     s->GPPUDCLK1 = 0;
-    s->writectr  = 0;
+    s->OUTSTATE0 = 0;
+    s->OUTSTATE1 = 0;
+    s->host_lev[0] = 0;
+    s->host_lev[1] = 0;
+    s->pv_active = false;
+    rpi_gpio_update_fsel(s);
+    rpi_gpio_drive_reset(s);
+
+    timer_del(s->edge_timer);
+    qemu_set_irq(s->irq, 0);
+
+    for (i = 0; i < RPI_GPIO_WAVE_SLOTS; i++) {
+        timer_del(s->wave[i].timer);
+        s->wave[i].ctrl  = 0;
+        s->wave[i].mark  = 0;
+        s->wave[i].space = 0;
+        s->wave[i].level = 0;
+    }
 
 }
 
-/* QDev-required set function */
+/* QDev-required set function
+   Another device model drives a pin.  The level is remembered (and from
+   then on overrides the host's) so it shows up whenever the pin is an input.
+*/
 static void rpi_gpio_set(void * opaque, int line, int level)
 {
   RPI_GPIO_State *s = (RPI_GPIO_State *)opaque;
+  int b = line / 32;
+  uint32_t mask = 1u << (line % 32);
+
+  s->dev_mask[b] |= mask;
+  if (level) s->dev_lev[b] |= mask;
+  else s->dev_lev[b] &= ~mask;
 
   if (rpi_get_pin_function(s,line) == 0){
 
     /* We have an input; Set the level */
     if (line<32){
-      uint32_t mask = 1 << line;
       s->GPLEV0 &= ~mask;
       if (level) s->GPLEV0 |= mask;
     }
     else{
-      uint32_t mask = 1 << (line-32);
       s->GPLEV1 &= ~mask;
       if (level) s->GPLEV1 |= mask;
     }
+    rpi_gpio_update_levels(s);
   }
 }
 
@@ -496,15 +1193,25 @@ static const MemoryRegionOps rpi_gpio_ops = {
 
 /* Use the POSIX shm functions to create a shared memory region
    and map it into QEMU's memory.  Return the pointer.
+   The paravirtual page needs a whole page; a smaller segment left over
+   from a run without it (or from a build without the counters) cannot
+   grow, so it is replaced.
 */
-static shared_gpio_state *get_shared_ptr(void);
-static shared_gpio_state *get_shared_ptr(void){
+static shared_gpio_state *get_shared_ptr(uint32_t id, size_t size);
+static shared_gpio_state *get_shared_ptr(uint32_t id, size_t size){
 
   key_t key;
   int shmid=-1;
 
-  key = ftok("/proc/cpuinfo",0x84);
-  shmid = shmget(key, sizeof(shared_gpio_state), 0666 | IPC_CREAT);
+  key = ftok("/proc/cpuinfo",id);
+  shmid = shmget(key, size, 0666 | IPC_CREAT);
+  if (shmid == -1 && errno == EINVAL){
+    shmid = shmget(key, 0, 0666);
+    if (shmid != -1){
+      shmctl(shmid, IPC_RMID, NULL);
+    }
+    shmid = shmget(key, size, 0666 | IPC_CREAT);
+  }
 
   if (shmid != -1){
     DPRINTF("Created shared memory segment for rpi_gpio state\n");
@@ -523,31 +1230,188 @@ static int rpi_gpio_initfn(SysBusDevice *sbd)
 {
     DeviceState *dev = DEVICE(sbd);
     RPI_GPIO_State *s = RPI_GPIO(dev);
+    int i;
 
+    memory_region_init(&s->container, OBJECT(s), "rpi_gpio",
+                       RPI_GPIO_PV_OUT_OFFSET + RPI_GPIO_PV_SIZE);
     memory_region_init_io(&s->iomem, OBJECT(s), &rpi_gpio_ops, s,
-                          "rpi_gpio", 0x00B1);
-    sysbus_init_mmio(sbd, &s->iomem);
-    qdev_init_gpio_in(dev, rpi_gpio_set, 54);
-    qdev_init_gpio_out(dev, s->out, 54);
+                          "rpi_gpio.regs", RPI_GPIO_REGS_SIZE);
+    memory_region_add_subregion(&s->container, 0, &s->iomem);
+    sysbus_init_mmio(sbd, &s->container);
+    qdev_init_gpio_in(dev, rpi_gpio_set, RPI_GPIO_NUM_PINS);
+    qdev_init_gpio_out(dev, s->out, RPI_GPIO_NUM_PINS);
+    sysbus_init_irq(sbd, &s->irq);
+    s->edge_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, rpi_gpio_edge_timer_cb, s);
+    for (i = 0; i < RPI_GPIO_WAVE_SLOTS; i++) {
+        s->wave[i].s = s;
+        s->wave[i].timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, rpi_gpio_wave_cb,
+                                        &s->wave[i]);
+    }
+    if (s->edge_poll_us == 0){
+        s->edge_poll_us = 1;
+    }
 
-    s->shm = get_shared_ptr();
+    if (s->shm_id == 0 || s->shm_id > 0xff){
+        error_report("rpi_gpio: shm-id must be 1-255");
+        return -1;
+    }
+    s->shm = get_shared_ptr(s->shm_id, s->pv ? RPI_GPIO_PV_SIZE : sizeof(shared_gpio_state));
+
+    if (s->pv){
+        /* Guest accesses to the page bypass the device, so inputs could
+           not be logged or replayed */
+        if (replay_mode != REPLAY_MODE_NONE){
+            error_report("rpi_gpio: pv cannot be used with record/replay");
+            return -1;
+        }
+        if (s->shm == (void *)-1){
+            error_report("rpi_gpio: pv needs the shared memory segment: %s",
+                         strerror(errno));
+            return -1;
+        }
+        memory_region_init_ram_ptr(&s->pv_ram, OBJECT(s), "rpi_gpio.pv",
+                                   RPI_GPIO_PV_SIZE, s->shm);
+        memory_region_set_readonly(&s->pv_ram, true);
+        /* The page is the host's segment: loading it would put back old
+           counters, WAITERS and SEQ, and stale inputs.  What the guest
+           sees in it is rebuilt from the device state in post_load */
+        vmstate_exclude_ram(&s->pv_ram);
+        memory_region_add_subregion(&s->container, RPI_GPIO_PV_OFFSET,
+                                    &s->pv_ram);
+        memory_region_init_ram(&s->pv_out_ram, OBJECT(s), "rpi_gpio.pv-out",
+                               RPI_GPIO_PV_SIZE, &error_fatal);
+        vmstate_register_ram(&s->pv_out_ram, dev);
+        memory_region_add_subregion(&s->container, RPI_GPIO_PV_OUT_OFFSET,
+                                    &s->pv_out_ram);
+        s->pv_out = memory_region_get_ram_ptr(&s->pv_out_ram);
+    }
+
+    if (s->vcd_path){
+        Error *err = NULL;
+
+        s->vcd = rpi_gpio_vcd_open(s->vcd_path, 54, s->pin_level, &err);
+        if (!s->vcd){
+            error_report_err(err);
+            return -1;
+        }
+    }
 
     return 0;
 }
 
+/* Pin activity can be dumped for a waveform viewer such as GTKWave:
+     -global rpi_gpio.vcd=gpio.vcd
+   Timestamps are QEMU_CLOCK_VIRTUAL nanoseconds.
+   While event detection is enabled, host inputs are sampled every
+   edge-poll-us microseconds of virtual time:
+     -global rpi_gpio.edge-poll-us=20
+   The paravirtual pages (see RPI_GPIO_PV_CTRL) are off by default:
+     -global rpi_gpio.pv=on
+   Each QEMU on a host needs its own shared memory segment (the project
+   id given to ftok("/proc/cpuinfo", ...)); host programs find it through
+   RPI_GPIO_SHM_ID (see gpio_common/shared_gpio_state.h):
+     -global rpi_gpio.shm-id=0x90
+*/
+static Property rpi_gpio_properties[] = {
+    DEFINE_PROP_STRING("vcd", RPI_GPIO_State, vcd_path),
+    DEFINE_PROP_UINT32("edge-poll-us", RPI_GPIO_State, edge_poll_us, 100),
+    DEFINE_PROP_BOOL("pv", RPI_GPIO_State, pv, false),
+    DEFINE_PROP_UINT32("shm-id", RPI_GPIO_State, shm_id, 0x84),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
 static void rpi_gpio_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
     SysBusDeviceClass *k = SYS_BUS_DEVICE_CLASS(klass);
 
     k->init = rpi_gpio_initfn;
+    dc->props = rpi_gpio_properties;
     dc->vmsd = &vmstate_rpi_gpio;
     dc->reset = &rpi_gpio_reset;
 }
 
+/* Register names for the reg-reads and reg-writes statistics */
+static const char *const rpi_gpio_reg_names[RPI_GPIO_STAT_REGS] = {
+    [0x00 / 4] = "GPFSEL0",   [0x04 / 4] = "GPFSEL1",   [0x08 / 4] = "GPFSEL2",
+    [0x0c / 4] = "GPFSEL3",   [0x10 / 4] = "GPFSEL4",   [0x14 / 4] = "GPFSEL5",
+    [0x1c / 4] = "GPSET0",    [0x20 / 4] = "GPSET1",
+    [0x28 / 4] = "GPCLR0",    [0x2c / 4] = "GPCLR1",
+    [0x34 / 4] = "GPLEV0",    [0x38 / 4] = "GPLEV1",
+    [0x40 / 4] = "GPEDS0",    [0x44 / 4] = "GPEDS1",
+    [0x4c / 4] = "GPREN0",    [0x50 / 4] = "GPREN1",
+    [0x58 / 4] = "GPFEN0",    [0x5c / 4] = "GPFEN1",
+    [0x64 / 4] = "GPHEN0",    [0x68 / 4] = "GPHEN1",
+    [0x70 / 4] = "GPLEN0",    [0x74 / 4] = "GPLEN1",
+    [0x7c / 4] = "GPAREN0",   [0x80 / 4] = "GPAREN1",
+    [0x88 / 4] = "GPAFEN0",   [0x8c / 4] = "GPAFEN1",
+    [0x94 / 4] = "GPPUD",     [0x98 / 4] = "GPPUDCLK0", [0x9c / 4] = "GPPUDCLK1",
+    [RPI_GPIO_PV_CTRL / 4] = "PV_CTRL", [RPI_GPIO_WAVE_INFO / 4] = "WAVE_INFO",
+    [RPI_GPIO_STAT_WAVE] = "WAVE",
+};
+
+/* reg-reads and reg-writes: an object of register name: count.  Accesses
+   to offsets without a register show up under their offset. */
+static void rpi_gpio_get_reg_stats(Object *obj, Visitor *v, const char *name,
+                                   void *opaque, Error **errp)
+{
+    uint64_t *counts = opaque;
+    Error *err = NULL;
+    char buf[8];
+    const char *reg;
+    int i;
+
+    visit_start_struct(v, name, NULL, 0, &err);
+    for (i = 0; i < RPI_GPIO_STAT_REGS && !err; i++) {
+        reg = rpi_gpio_reg_names[i];
+        if (!reg) {
+            if (!counts[i]) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), "0x%02x", i * 4);
+            reg = buf;
+        }
+        visit_type_uint64(v, reg, &counts[i], &err);
+    }
+    if (!err) {
+        visit_end_struct(v, &err);
+    }
+    error_propagate(errp, err);
+}
+
+/* pin-toggles and input-latency: a list of counts */
+static void rpi_gpio_get_counts(Object *obj, Visitor *v, const char *name,
+                                void *opaque, Error **errp)
+{
+    RPI_GPIO_State *s = RPI_GPIO(obj);
+    uint64_t *counts = opaque;
+    int i, n = counts == s->pin_toggles ? RPI_GPIO_NUM_PINS : RPI_GPIO_LATENCY_BUCKETS;
+    Error *err = NULL;
+
+    visit_start_list(v, name, &err);
+    if (err) {
+        error_propagate(errp, err);
+        return;
+    }
+    for (i = 0; i < n && !err; i++) {
+        visit_type_uint64(v, NULL, &counts[i], &err);
+    }
+    visit_end_list(v);
+    error_propagate(errp, err);
+}
+
 static void rpi_gpio_init(Object *obj)
 {
-  DPRINTF("Initialized RPI_GPIO device\n");
+  RPI_GPIO_State *s = RPI_GPIO(obj);
+
+  object_property_add(obj, "reg-reads", "struct", rpi_gpio_get_reg_stats,
+                      NULL, NULL, s->reg_reads, NULL);
+  object_property_add(obj, "reg-writes", "struct", rpi_gpio_get_reg_stats,
+                      NULL, NULL, s->reg_writes, NULL);
+  object_property_add(obj, "pin-toggles", "uint64List", rpi_gpio_get_counts,
+                      NULL, NULL, s->pin_toggles, NULL);
+  object_property_add(obj, "input-latency", "uint64List", rpi_gpio_get_counts,
+                      NULL, NULL, s->input_latency, NULL);
 }
 
 static const TypeInfo rpi_gpio_info = {
@@ -0,0 +1,214 @@
+/*
+ * Value Change Dump (VCD) writer for the rpi_gpio device
+ *
+ * The device queues a sample of all pin levels whenever one of them changes.
+ * Formatting and file I/O happen on a separate thread so that enabling the
+ * dump does not perturb guest timing; the device side only takes an
+ * uncontended lock and copies 16 bytes.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qemu/host-utils.h"
+#include "qemu/thread.h"
+#include "qemu/notify.h"
+#include "sysemu/sysemu.h"
+#include "hw/gpio/rpi_gpio_vcd.h"
+
+#define RPI_GPIO_VCD_RING   65536   /* samples, must be a power of 2 */
+#define RPI_GPIO_VCD_BATCH  1024    /* samples formatted per lock */
+#define RPI_GPIO_VCD_BANKS  2
+
+typedef struct RPIGPIOVcdSample {
+    int64_t time_ns;
+    uint32_t level[RPI_GPIO_VCD_BANKS];
+} RPIGPIOVcdSample;
+
+struct RPIGPIOVcd {
+    FILE *file;
+    int npins;
+
+    QemuThread thread;
+    QemuMutex lock;
+    QemuCond cond;
+    bool stop;
+
+    /* Ring buffer, protected by lock */
+    RPIGPIOVcdSample ring[RPI_GPIO_VCD_RING];
+    unsigned head;
+    unsigned tail;
+    uint64_t dropped;
+
+    /* Writer thread state */
+    int64_t last_time;
+    uint32_t last[RPI_GPIO_VCD_BANKS];
+
+    Notifier exit;
+};
+
+static char rpi_gpio_vcd_id(int pin)
+{
+    return '!' + pin;
+}
+
+/* The definitions, then every signal's value at #0, so a viewer shows
+ * each pin from the start even if it never changes
+ */
+static void rpi_gpio_vcd_header(RPIGPIOVcd *vcd)
+{
+    int pin;
+
+    fprintf(vcd->file, "$version QEMU rpi_gpio $end\n");
+    fprintf(vcd->file, "$timescale 1ns $end\n");
+    fprintf(vcd->file, "$scope module rpi_gpio $end\n");
+    for (pin = 0; pin < vcd->npins; pin++) {
+        fprintf(vcd->file, "$var wire 1 %c gpio%d $end\n",
+                rpi_gpio_vcd_id(pin), pin);
+    }
+    fprintf(vcd->file, "$upscope $end\n");
+    fprintf(vcd->file, "$enddefinitions $end\n");
+    fprintf(vcd->file, "#0\n$dumpvars\n");
+    for (pin = 0; pin < vcd->npins; pin++) {
+        fprintf(vcd->file, "%d%c\n", (vcd->last[pin / 32] >> (pin % 32)) & 1,
+                rpi_gpio_vcd_id(pin));
+    }
+    fprintf(vcd->file, "$end\n");
+}
+
+static void rpi_gpio_vcd_emit(RPIGPIOVcd *vcd, const RPIGPIOVcdSample *s)
+{
+    uint32_t changed;
+    int pin, bank;
+
+    for (bank = 0; bank < RPI_GPIO_VCD_BANKS; bank++) {
+        changed = s->level[bank] ^ vcd->last[bank];
+        if (!changed) {
+            continue;
+        }
+        if (s->time_ns != vcd->last_time) {
+            fprintf(vcd->file, "#%" PRId64 "\n", s->time_ns);
+            vcd->last_time = s->time_ns;
+        }
+        while (changed) {
+            pin = ctz32(changed);
+            changed &= changed - 1;
+            if (bank * 32 + pin < vcd->npins) {
+                fprintf(vcd->file, "%d%c\n", (s->level[bank] >> pin) & 1,
+                        rpi_gpio_vcd_id(bank * 32 + pin));
+            }
+        }
+        vcd->last[bank] = s->level[bank];
+    }
+}
+
+static void *rpi_gpio_vcd_thread(void *opaque)
+{
+    RPIGPIOVcd *vcd = opaque;
+    RPIGPIOVcdSample batch[RPI_GPIO_VCD_BATCH];
+    unsigned n, i;
+
+    for (;;) {
+        qemu_mutex_lock(&vcd->lock);
+        while (vcd->head == vcd->tail && !vcd->stop) {
+            qemu_cond_wait(&vcd->cond, &vcd->lock);
+        }
+        if (vcd->head == vcd->tail) {
+            qemu_mutex_unlock(&vcd->lock);
+            break;
+        }
+        for (n = 0; n < RPI_GPIO_VCD_BATCH && vcd->tail != vcd->head; n++) {
+            batch[n] = vcd->ring[vcd->tail];
+            vcd->tail = (vcd->tail + 1) & (RPI_GPIO_VCD_RING - 1);
+        }
+        qemu_mutex_unlock(&vcd->lock);
+
+        for (i = 0; i < n; i++) {
+            rpi_gpio_vcd_emit(vcd, &batch[i]);
+        }
+    }
+
+    fflush(vcd->file);
+    return NULL;
+}
+
+void rpi_gpio_vcd_sample(RPIGPIOVcd *vcd, int64_t time_ns, const uint32_t *level)
+{
+    unsigned next;
+    bool was_empty;
+
+    qemu_mutex_lock(&vcd->lock);
+    next = (vcd->head + 1) & (RPI_GPIO_VCD_RING - 1);
+    if (next == vcd->tail) {
+        vcd->dropped++;
+        qemu_mutex_unlock(&vcd->lock);
+        return;
+    }
+    was_empty = (vcd->head == vcd->tail);
+    vcd->ring[vcd->head].time_ns = time_ns;
+    memcpy(vcd->ring[vcd->head].level, level, sizeof(vcd->ring[0].level));
+    vcd->head = next;
+    if (was_empty) {
+        qemu_cond_signal(&vcd->cond);
+    }
+    qemu_mutex_unlock(&vcd->lock);
+}
+
+void rpi_gpio_vcd_close(RPIGPIOVcd *vcd)
+{
+    qemu_mutex_lock(&vcd->lock);
+    vcd->stop = true;
+    qemu_cond_signal(&vcd->cond);
+    qemu_mutex_unlock(&vcd->lock);
+
+    qemu_thread_join(&vcd->thread);
+
+    if (vcd->dropped) {
+        fprintf(stderr, "rpi_gpio: VCD writer dropped %" PRIu64 " samples\n",
+                vcd->dropped);
+    }
+    fclose(vcd->file);
+    qemu_cond_destroy(&vcd->cond);
+    qemu_mutex_destroy(&vcd->lock);
+    g_free(vcd);
+}
+
+static void rpi_gpio_vcd_exit(Notifier *n, void *data)
+{
+    RPIGPIOVcd *vcd = container_of(n, RPIGPIOVcd, exit);
+
+    rpi_gpio_vcd_close(vcd);
+}
+
+RPIGPIOVcd *rpi_gpio_vcd_open(const char *path, int npins, const uint32_t *level,
+                              Error **errp)
+{
+    RPIGPIOVcd *vcd;
+    FILE *file;
+
+    file = fopen(path, "w");
+    if (!file) {
+        error_setg_errno(errp, errno, "rpi_gpio: cannot open VCD file '%s'",
+                         path);
+        return NULL;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    vcd = g_new0(RPIGPIOVcd, 1);
+    vcd->file = file;
+    vcd->npins = MIN(npins, RPI_GPIO_VCD_BANKS * 32);
+    memcpy(vcd->last, level, sizeof(vcd->last));
+    rpi_gpio_vcd_header(vcd);
+
+    qemu_mutex_init(&vcd->lock);
+    qemu_cond_init(&vcd->cond);
+    qemu_thread_create(&vcd->thread, "rpi_gpio_vcd", rpi_gpio_vcd_thread,
+                       vcd, QEMU_THREAD_JOINABLE);
+
+    vcd->exit.notify = rpi_gpio_vcd_exit;
+    qemu_add_exit_notifier(&vcd->exit);
+
+    return vcd;
+}
@@ -0,0 +1,308 @@
+/*
+ * MaxDetect single wire temperature/humidity sensor (DHT11, DHT22/RHT03)
+ * on a pin of the rpi_gpio device.
+ *
+ *   -device rpi-dht,id=dht0,pin=4[,model=22][,temperature=21500][,humidity=45000]
+ *
+ * Temperature is in millidegrees Celsius and humidity in thousandths of a
+ * percent RH, as for tmp105.  Both can be changed at run time:
+ *
+ *   { "execute": "qom-set", "arguments": { "path": "/machine/peripheral/dht0",
+ *     "property": "temperature", "value": -5300 } }
+ *
+ * The host wakes the sensor by holding the line low (DHT22 1ms, DHT11 18ms)
+ * and releasing it.  The reply is timed on QEMU_CLOCK_VIRTUAL: 80us low,
+ * 80us high, then 40 bits of 50us low followed by 26us (0) or 70us (1)
+ * high, and a final 50us low before the line is released again.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "hw/hw.h"
+#include "hw/qdev.h"
+#include "hw/gpio/rpi_gpio.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "qapi/visitor.h"
+
+#define TYPE_RPI_DHT "rpi-dht"
+#define RPI_DHT(obj) OBJECT_CHECK(RPIDHTState, (obj), TYPE_RPI_DHT)
+
+#define RPI_DHT_RESPONSE_NS  (30 * SCALE_US)
+
+typedef struct RPIDHTState {
+    DeviceState parent_obj;
+
+    uint32_t pin;
+    uint8_t model;          /* 11 or 22 */
+    int32_t temperature;    /* millidegrees C */
+    int32_t humidity;       /* thousandths of a percent RH */
+
+    qemu_irq out;           /* Drives the pin */
+    QEMUTimer *timer;
+    bool line;              /* Level the SoC drives */
+    int64_t fall_ns;        /* When the SoC last pulled the line low */
+    int32_t phase;          /* Next phase of the reply, -1 when idle */
+    int64_t next_ns;
+    uint8_t frame[5];
+} RPIDHTState;
+
+static const VMStateDescription vmstate_rpi_dht = {
+    .name = "rpi-dht",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .fields = (VMStateField[]) {
+        VMSTATE_INT32(temperature, RPIDHTState),
+        VMSTATE_INT32(humidity, RPIDHTState),
+        VMSTATE_BOOL(line, RPIDHTState),
+        VMSTATE_INT64(fall_ns, RPIDHTState),
+        VMSTATE_INT32(phase, RPIDHTState),
+        VMSTATE_INT64(next_ns, RPIDHTState),
+        VMSTATE_UINT8_ARRAY(frame, RPIDHTState, 5),
+        VMSTATE_TIMER_PTR(timer, RPIDHTState),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+/* Latch the current reading into the 40 bit frame */
+static void rpi_dht_frame(RPIDHTState *s)
+{
+    int32_t t = s->temperature, h = s->humidity;
+    uint16_t tw, hw;
+
+    if (s->model == 11) {
+        t = MAX(0, MIN(t, 50000));
+        h = MAX(0, MIN(h, 100000));
+        s->frame[0] = h / 1000;
+        s->frame[1] = (h / 100) % 10;
+        s->frame[2] = t / 1000;
+        s->frame[3] = (t / 100) % 10;
+    } else {
+        h = MAX(0, MIN(h, 100000));
+        hw = h / 100;
+        tw = (t < 0) ? (0x8000 | (uint16_t)(-t / 100)) : (uint16_t)(t / 100);
+        s->frame[0] = hw >> 8;
+        s->frame[1] = hw;
+        s->frame[2] = tw >> 8;
+        s->frame[3] = tw;
+    }
+    s->frame[4] = s->frame[0] + s->frame[1] + s->frame[2] + s->frame[3];
+}
+
+/* Level and length of one phase of the reply, or -1 once it is over */
+static int64_t rpi_dht_phase(RPIDHTState *s, int phase, int *level)
+{
+    int bit;
+
+    if (phase < 2) {
+        *level = phase;
+        return 80 * SCALE_US;
+    }
+    phase -= 2;
+    if (phase < 80) {
+        bit = (s->frame[phase / 16] >> (7 - (phase / 2) % 8)) & 1;
+        *level = phase & 1;
+        return !*level ? 50 * SCALE_US : bit ? 70 * SCALE_US : 26 * SCALE_US;
+    }
+    if (phase == 80) {
+        *level = 0;
+        return 50 * SCALE_US;
+    }
+    return -1;
+}
+
+static void rpi_dht_timer_cb(void *opaque)
+{
+    RPIDHTState *s = opaque;
+    int64_t len;
+    int level;
+
+    len = rpi_dht_phase(s, s->phase, &level);
+    if (len < 0) {
+        s->phase = -1;
+        qemu_irq_raise(s->out);
+        return;
+    }
+
+    s->phase++;
+    s->next_ns += len;
+    timer_mod(s->timer, s->next_ns);
+    qemu_set_irq(s->out, level);
+}
+
+/* Level the SoC drives onto the pin (the rpi_gpio out[] line) */
+static void rpi_dht_line(void *opaque, int n, int level)
+{
+    RPIDHTState *s = opaque;
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    int64_t start_ns = (s->model == 11 ? 18 : 1) * SCALE_MS;
+
+    if (level == s->line) {
+        return;
+    }
+    s->line = level;
+
+    if (!level) {
+        /* Pulled low mid reply: the host has given up and starts again */
+        if (s->phase >= 0) {
+            timer_del(s->timer);
+            s->phase = -1;
+            qemu_irq_raise(s->out);
+        }
+        s->fall_ns = now;
+        return;
+    }
+
+    if (s->phase < 0 && now - s->fall_ns >= start_ns) {
+        rpi_dht_frame(s);
+        s->phase = 0;
+        s->next_ns = now + RPI_DHT_RESPONSE_NS;
+        timer_mod(s->timer, s->next_ns);
+    }
+}
+
+static void rpi_dht_reset(void *opaque)
+{
+    RPIDHTState *s = opaque;
+
+    timer_del(s->timer);
+    s->line = true;
+    s->fall_ns = 0;
+    s->phase = -1;
+    qemu_irq_raise(s->out);
+}
+
+static void rpi_dht_get_temperature(Object *obj, Visitor *v, const char *name,
+                                    void *opaque, Error **errp)
+{
+    RPIDHTState *s = RPI_DHT(obj);
+    int64_t value = s->temperature;
+
+    visit_type_int(v, name, &value, errp);
+}
+
+static void rpi_dht_set_temperature(Object *obj, Visitor *v, const char *name,
+                                    void *opaque, Error **errp)
+{
+    RPIDHTState *s = RPI_DHT(obj);
+    Error *local_err = NULL;
+    int64_t temp;
+
+    visit_type_int(v, name, &temp, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return;
+    }
+    if (temp > 125000 || temp < -40000) {
+        error_setg(errp, "value %" PRId64 " m°C is out of range", temp);
+        return;
+    }
+    s->temperature = temp;
+}
+
+static void rpi_dht_get_humidity(Object *obj, Visitor *v, const char *name,
+                                 void *opaque, Error **errp)
+{
+    RPIDHTState *s = RPI_DHT(obj);
+    int64_t value = s->humidity;
+
+    visit_type_int(v, name, &value, errp);
+}
+
+static void rpi_dht_set_humidity(Object *obj, Visitor *v, const char *name,
+                                 void *opaque, Error **errp)
+{
+    RPIDHTState *s = RPI_DHT(obj);
+    Error *local_err = NULL;
+    int64_t hum;
+
+    visit_type_int(v, name, &hum, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return;
+    }
+    if (hum > 100000 || hum < 0) {
+        error_setg(errp, "value %" PRId64 " is out of range", hum);
+        return;
+    }
+    s->humidity = hum;
+}
+
+static void rpi_dht_realize(DeviceState *dev, Error **errp)
+{
+    RPIDHTState *s = RPI_DHT(dev);
+    DeviceState *gpio;
+    bool ambiguous;
+
+    if (s->model != 11 && s->model != 22) {
+        error_setg(errp, "rpi-dht: model must be 11 or 22");
+        return;
+    }
+    if (s->pin >= RPI_GPIO_NUM_PINS) {
+        error_setg(errp, "rpi-dht: pin must be below %d", RPI_GPIO_NUM_PINS);
+        return;
+    }
+
+    gpio = DEVICE(object_resolve_path_type("", TYPE_RPI_GPIO, &ambiguous));
+    if (!gpio) {
+        error_setg(errp, "rpi-dht: the machine has no " TYPE_RPI_GPIO);
+        return;
+    }
+
+    qdev_init_gpio_in(dev, rpi_dht_line, 1);
+    qdev_init_gpio_out(dev, &s->out, 1);
+    qdev_connect_gpio_out(gpio, s->pin, qdev_get_gpio_in(dev, 0));
+    qdev_connect_gpio_out(dev, 0, qdev_get_gpio_in(gpio, s->pin));
+
+    s->timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, rpi_dht_timer_cb, s);
+    qemu_register_reset(rpi_dht_reset, s);
+    rpi_dht_reset(s);
+}
+
+static void rpi_dht_initfn(Object *obj)
+{
+    RPIDHTState *s = RPI_DHT(obj);
+
+    s->temperature = 21500;
+    s->humidity = 45000;
+    object_property_add(obj, "temperature", "int",
+                        rpi_dht_get_temperature,
+                        rpi_dht_set_temperature, NULL, NULL, NULL);
+    object_property_add(obj, "humidity", "int",
+                        rpi_dht_get_humidity,
+                        rpi_dht_set_humidity, NULL, NULL, NULL);
+}
+
+static Property rpi_dht_properties[] = {
+    DEFINE_PROP_UINT32("pin", RPIDHTState, pin, 4),
+    DEFINE_PROP_UINT8("model", RPIDHTState, model, 22),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void rpi_dht_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->realize = rpi_dht_realize;
+    dc->props = rpi_dht_properties;
+    dc->vmsd = &vmstate_rpi_dht;
+    dc->desc = "DHT11/DHT22 sensor on an rpi_gpio pin";
+    set_bit(DEVICE_CATEGORY_MISC, dc->categories);
+}
+
+static const TypeInfo rpi_dht_info = {
+    .name          = TYPE_RPI_DHT,
+    .parent        = TYPE_DEVICE,
+    .instance_size = sizeof(RPIDHTState),
+    .instance_init = rpi_dht_initfn,
+    .class_init    = rpi_dht_class_init,
+};
+
+static void rpi_dht_register_types(void)
+{
+    type_register_static(&rpi_dht_info);
+}
+
+type_init(rpi_dht_register_types)
@@ -68,6 +68,10 @@ RAMBlock *qemu_ram_block_from_host(void *ptr, bool round_offset,
 void qemu_ram_set_idstr(ram_addr_t addr, const char *name, DeviceState *dev);
 void qemu_ram_unset_idstr(ram_addr_t addr);
 const char *qemu_ram_get_idstr(RAMBlock *rb);
+bool qemu_ram_is_private(RAMBlock *rb);
+bool qemu_ram_is_prealloc(RAMBlock *rb);
+void qemu_ram_set_nomigrate(ram_addr_t addr);
+bool qemu_ram_is_migratable(RAMBlock *rb);
 
 void cpu_physical_memory_rw(hwaddr addr, uint8_t *buf,
                             int len, int is_write);
@@ -288,6 +288,7 @@ struct TBContext {
     /* statistics */
     int tb_flush_count;
     int tb_phys_invalidate_count;
+    uint64_t tb_gen_count;
 
     int tb_invalidated_flag;
 };
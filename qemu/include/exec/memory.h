@@ -195,6 +195,7 @@ struct MemoryRegion {
     unsigned ioeventfd_nb;
     MemoryRegionIoeventfd *ioeventfds;
     NotifierList iommu_notify;
+    uint64_t dispatch_count;    /* Reads and writes through ops (MMIO exits) */
 };
 
 /**
@@ -1141,6 +1142,24 @@ void memory_global_dirty_log_stop(void);
 
 void mtree_info(fprintf_function mon_printf, void *f);
 
+/**
+ * memory_region_foreach_dispatch_count: walk the MMIO access counts
+ *
+ * Calls @fn for every region in the tree below @mr (but not aliases,
+ * whose accesses count for the region they alias) that has handled
+ * reads or writes through its ops, with the address it is mapped at
+ * relative to @mr and the number of accesses so far.
+ *
+ * @mr: the root of the tree, usually get_system_memory()
+ * @fn: called for each region
+ * @opaque: passed to @fn
+ */
+typedef void MemoryRegionCountFn(MemoryRegion *mr, hwaddr addr,
+                                 uint64_t count, void *opaque);
+void memory_region_foreach_dispatch_count(MemoryRegion *mr,
+                                          MemoryRegionCountFn *fn,
+                                          void *opaque);
+
 /**
  * memory_region_dispatch_read: perform a read directly to the specified
  * MemoryRegion.
@@ -0,0 +1,23 @@
+/*
+ * BCM2835 General Purpose IO Module for Raspberry Pi
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef HW_GPIO_RPI_GPIO_H
+#define HW_GPIO_RPI_GPIO_H
+
+#define TYPE_RPI_GPIO "rpi_gpio"
+
+#define RPI_GPIO_NUM_PINS 54
+
+/* The device has one unnamed GPIO input and output per BCM pin so that
+ * other device models can sit on the header:
+ *  - input N drives pin N.  Once a model has driven a pin, its level
+ *    replaces the one from the shared memory segment for that pin.
+ *  - output N follows what the SoC drives onto pin N: the output level
+ *    when the pin is an output, high (released and pulled up) otherwise.
+ */
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Value Change Dump (VCD) writer for the rpi_gpio device
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef HW_GPIO_RPI_GPIO_VCD_H
+#define HW_GPIO_RPI_GPIO_VCD_H
+
+typedef struct RPIGPIOVcd RPIGPIOVcd;
+
+/* Create @path and start the writer thread.  Pins are named gpio0..gpio<npins-1>
+ * and start at #0 with the levels in @level.
+ */
+RPIGPIOVcd *rpi_gpio_vcd_open(const char *path, int npins, const uint32_t *level,
+                              Error **errp);
+
+/* Queue the pin levels at virtual time @time_ns.  Never blocks: if the
+ * writer thread falls behind, the sample is dropped and counted.
+ */
+void rpi_gpio_vcd_sample(RPIGPIOVcd *vcd, int64_t time_ns, const uint32_t *level);
+
+/* Flush everything queued and close the file. */
+void rpi_gpio_vcd_close(RPIGPIOVcd *vcd);
+
+#endif
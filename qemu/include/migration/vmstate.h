@@ -949,6 +949,7 @@ struct MemoryRegion;
 void vmstate_register_ram(struct MemoryRegion *memory, DeviceState *dev);
 void vmstate_unregister_ram(struct MemoryRegion *memory, DeviceState *dev);
 void vmstate_register_ram_global(struct MemoryRegion *memory);
+void vmstate_exclude_ram(struct MemoryRegion *memory);
 
 static inline
 int64_t self_announce_delay(int round)
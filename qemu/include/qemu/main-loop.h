@@ -264,6 +264,29 @@ void qemu_mutex_lock_iothread(void);
  */
 void qemu_mutex_unlock_iothread(void);
 
+/**
+ * qemu_mutex_iothread_timing: Time the main loop mutex.
+ *
+ * While enabled, every acquisition of the main loop mutex is counted and
+ * timed: how long the thread waited for it and how long it was held.
+ * This costs two clock reads per acquisition.  Must be called with the
+ * mutex held.
+ *
+ * @enable: whether to time the mutex from now on.
+ */
+void qemu_mutex_iothread_timing(bool enable);
+
+/**
+ * qemu_mutex_iothread_stats: Read the main loop mutex statistics.
+ *
+ * Returns the totals since timing was first enabled: the number of
+ * acquisitions, nanoseconds spent waiting for the mutex and nanoseconds
+ * it was held, over all threads.  The caller's own hold so far is
+ * included.  Must be called with the mutex held.
+ */
+void qemu_mutex_iothread_stats(uint64_t *acquired, uint64_t *wait_ns,
+                               uint64_t *held_ns);
+
 /* internal interfaces */
 
 void qemu_fd_register(int fd);
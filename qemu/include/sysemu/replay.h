@@ -133,4 +133,15 @@ void replay_char_read_all_save_error(int res);
 /*! Writes character read_all execution result into the replay log. */
 void replay_char_read_all_save_buf(uint8_t *buf, int offset);
 
+/* GPIO */
+
+/*! Writes the input levels of GPIO controller id into the replay log.
+    Called when the guest samples levels that differ from the last ones
+    saved. */
+void replay_gpio_input_save(uint8_t id, const uint32_t *levels, int count);
+/*! Reads the input levels of GPIO controller id from the replay log.
+    Returns false, leaving levels untouched, if they did not change at
+    this point of the recorded execution. */
+bool replay_gpio_input_load(uint8_t id, uint32_t *levels, int count);
+
 #endif
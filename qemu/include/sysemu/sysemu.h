@@ -80,6 +80,8 @@ void hmp_savevm(Monitor *mon, const QDict *qdict);
 int load_vmstate(const char *name);
 void hmp_delvm(Monitor *mon, const QDict *qdict);
 void hmp_info_snapshots(Monitor *mon, const QDict *qdict);
+void hmp_cow_snapshot_take(Monitor *mon, const QDict *qdict);
+void hmp_cow_snapshot_restore(Monitor *mon, const QDict *qdict);
 
 void qemu_announce_self(void);
 
@@ -1219,6 +1219,7 @@ MemTxResult memory_region_dispatch_read(MemoryRegion *mr,
         *pval = unassigned_mem_read(mr, addr, size);
         return MEMTX_DECODE_ERROR;
     }
+    mr->dispatch_count++;
 
     r = memory_region_dispatch_read1(mr, addr, pval, size, attrs);
     adjust_endianness(mr, pval, size);
@@ -1261,6 +1262,7 @@ MemTxResult memory_region_dispatch_write(MemoryRegion *mr,
         unassigned_mem_write(mr, addr, data, size);
         return MEMTX_DECODE_ERROR;
     }
+    mr->dispatch_count++;
 
     adjust_endianness(mr, &data, size);
 
@@ -1289,6 +1291,31 @@ MemTxResult memory_region_dispatch_write(MemoryRegion *mr,
     }
 }
 
+static void memory_region_walk_dispatch_count(MemoryRegion *mr, hwaddr base,
+                                              MemoryRegionCountFn *fn,
+                                              void *opaque)
+{
+    MemoryRegion *subregion;
+
+    if (mr->dispatch_count) {
+        fn(mr, base, mr->dispatch_count, opaque);
+    }
+    QTAILQ_FOREACH(subregion, &mr->subregions, subregions_link) {
+        if (!subregion->alias) {
+            memory_region_walk_dispatch_count(subregion,
+                                              base + subregion->addr,
+                                              fn, opaque);
+        }
+    }
+}
+
+void memory_region_foreach_dispatch_count(MemoryRegion *mr,
+                                          MemoryRegionCountFn *fn,
+                                          void *opaque)
+{
+    memory_region_walk_dispatch_count(mr, 0, fn, opaque);
+}
+
 void memory_region_init_io(MemoryRegion *mr,
                            Object *owner,
                            const MemoryRegionOps *ops,
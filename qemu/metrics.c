@@ -0,0 +1,306 @@
+/*
+ * Periodic performance metrics stream
+ *
+ *   -chardev file,id=m,path=metrics.log
+ *   -object metrics,id=m0,chardev=m,interval=1000
+ *
+ * Every interval milliseconds (default 1000) one line of space separated
+ * key=value pairs is written to the character device, so a file or a
+ * socket chardev can feed a dashboard directly:
+ *
+ *   time         host wall clock, seconds since the epoch
+ *   tb_gen_per_s translation blocks generated per second
+ *   tb_flushes   translation cache flushes in the interval
+ *   tb_invalidated_per_s  blocks invalidated by code writes per second
+ *   bql_held_pct share of the interval the global mutex was held (a TCG
+ *                vCPU holds it while it runs guest code)
+ *   bql_wait_pct time threads spent blocked on it, summed over threads
+ *   bql_acquired_per_s    acquisitions of it per second
+ *   mmio_per_s   MMIO accesses per second, all regions together
+ *   mmio_per_s.<region>@<address>  the same for each region that has
+ *                had any, e.g. mmio_per_s.rpi_gpio.regs@0x20200000
+ *   dropped      lines lost so far because the chardev would have blocked
+ *
+ * Lines are written without blocking, as the timer runs in the main loop
+ * with the global mutex held: a reader that falls behind loses whole
+ * lines rather than stalling the guest.  A line cut short is ended on
+ * the next write, so a reader only ever sees it as a malformed line.
+ *
+ * The counters are plain increments on paths that already run under the
+ * global mutex and are only read from a main loop timer, so the cost is
+ * one walk of the memory region tree per interval and two clock reads
+ * per acquisition of the global mutex.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "cpu.h"
+#include "tcg.h"
+#include "qapi/error.h"
+#include "qapi/visitor.h"
+#include "qapi/qmp/qerror.h"
+#include "qom/object_interfaces.h"
+#include "exec/address-spaces.h"
+#include "qemu/main-loop.h"
+#include "qemu/timer.h"
+#include "sysemu/char.h"
+
+#define TYPE_METRICS "metrics"
+#define METRICS(obj) OBJECT_CHECK(Metrics, (obj), TYPE_METRICS)
+
+typedef struct Metrics {
+    Object parent;
+
+    char *chr_name;
+    uint32_t interval;
+
+    CharDriverState *chr;
+    QEMUTimer *timer;
+    int64_t last_ns;
+    uint64_t tb_gen, tb_flushes, tb_invalidated;
+    uint64_t bql_acquired, bql_wait_ns, bql_held_ns;
+    uint64_t dropped;
+    bool torn;          /* the last line was only partly written */
+    GHashTable *mmio;   /* "name@address" -> count at the last line */
+} Metrics;
+
+static unsigned metrics_running;
+
+typedef struct MetricsLine {
+    Metrics *s;
+    GString *str;
+    double seconds;
+    uint64_t mmio_total;
+} MetricsLine;
+
+static void metrics_mmio(MemoryRegion *mr, hwaddr addr, uint64_t count,
+                         void *opaque)
+{
+    MetricsLine *line = opaque;
+    char *key = g_strdup_printf("%s@0x%" HWADDR_PRIx,
+                                memory_region_name(mr), addr);
+    uint64_t *last = g_hash_table_lookup(line->s->mmio, key);
+
+    if (!last) {
+        last = g_new0(uint64_t, 1);
+        g_hash_table_insert(line->s->mmio, g_strdup(key), last);
+    }
+    line->mmio_total += count - *last;
+    g_string_append_printf(line->str, " mmio_per_s.%s=%.0f", key,
+                           (count - *last) / line->seconds);
+    *last = count;
+    g_free(key);
+}
+
+static void metrics_mmio_seed(MemoryRegion *mr, hwaddr addr, uint64_t count,
+                              void *opaque)
+{
+    Metrics *s = opaque;
+    uint64_t *last = g_new(uint64_t, 1);
+
+    *last = count;
+    g_hash_table_insert(s->mmio, g_strdup_printf("%s@0x%" HWADDR_PRIx,
+                                                 memory_region_name(mr),
+                                                 addr), last);
+}
+
+static void metrics_tick(void *opaque)
+{
+    Metrics *s = opaque;
+    TBContext *tb_ctx = &tcg_ctx.tb_ctx;
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    uint64_t acquired, wait_ns, held_ns;
+    MetricsLine line = {
+        .s = s,
+        .str = g_string_new(""),
+        .seconds = (now - s->last_ns) / 1e9,
+    };
+    GString *out;
+    int written;
+
+    qemu_mutex_iothread_stats(&acquired, &wait_ns, &held_ns);
+    memory_region_foreach_dispatch_count(get_system_memory(),
+                                         metrics_mmio, &line);
+
+    out = g_string_new(s->torn ? "\n" : "");
+    g_string_append_printf(out, "time=%.3f tb_gen_per_s=%.0f tb_flushes=%d"
+                           " tb_invalidated_per_s=%.0f",
+                           g_get_real_time() / 1e6,
+                           (tb_ctx->tb_gen_count - s->tb_gen) / line.seconds,
+                           (int)(tb_ctx->tb_flush_count - s->tb_flushes),
+                           (tb_ctx->tb_phys_invalidate_count -
+                            s->tb_invalidated) / line.seconds);
+    g_string_append_printf(out, " bql_held_pct=%.1f bql_wait_pct=%.1f"
+                           " bql_acquired_per_s=%.0f",
+                           (held_ns - s->bql_held_ns) / line.seconds / 1e7,
+                           (wait_ns - s->bql_wait_ns) / line.seconds / 1e7,
+                           (acquired - s->bql_acquired) / line.seconds);
+    g_string_append_printf(out, " mmio_per_s=%.0f%s dropped=%" PRIu64 "\n",
+                           line.mmio_total / line.seconds, line.str->str,
+                           s->dropped);
+    written = qemu_chr_fe_write(s->chr, (uint8_t *)out->str, out->len);
+    if (written < (int)out->len) {
+        s->dropped++;
+    }
+    if (written > 0) {
+        s->torn = written < (int)out->len;
+    }
+    g_string_free(out, true);
+    g_string_free(line.str, true);
+
+    s->last_ns = now;
+    s->tb_gen = tb_ctx->tb_gen_count;
+    s->tb_flushes = tb_ctx->tb_flush_count;
+    s->tb_invalidated = tb_ctx->tb_phys_invalidate_count;
+    s->bql_acquired = acquired;
+    s->bql_wait_ns = wait_ns;
+    s->bql_held_ns = held_ns;
+    timer_mod(s->timer, now / SCALE_MS + s->interval);
+}
+
+static void metrics_complete(UserCreatable *uc, Error **errp)
+{
+    Metrics *s = METRICS(uc);
+
+    if (s->chr_name == NULL) {
+        error_setg(errp, QERR_MISSING_PARAMETER, "chardev");
+        return;
+    }
+    if (s->interval == 0) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE,
+                   "interval", "a number of milliseconds above 0");
+        return;
+    }
+    s->chr = qemu_chr_find(s->chr_name);
+    if (s->chr == NULL) {
+        error_set(errp, ERROR_CLASS_DEVICE_NOT_FOUND,
+                  "Device '%s' not found", s->chr_name);
+        return;
+    }
+    if (qemu_chr_fe_claim(s->chr) != 0) {
+        error_setg(errp, QERR_DEVICE_IN_USE, s->chr_name);
+        s->chr = NULL;
+        return;
+    }
+
+    if (metrics_running++ == 0) {
+        qemu_mutex_iothread_timing(true);
+    }
+    qemu_mutex_iothread_stats(&s->bql_acquired, &s->bql_wait_ns,
+                              &s->bql_held_ns);
+    s->tb_gen = tcg_ctx.tb_ctx.tb_gen_count;
+    s->tb_flushes = tcg_ctx.tb_ctx.tb_flush_count;
+    s->tb_invalidated = tcg_ctx.tb_ctx.tb_phys_invalidate_count;
+    s->mmio = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    memory_region_foreach_dispatch_count(get_system_memory(),
+                                         metrics_mmio_seed, s);
+    s->last_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    s->timer = timer_new_ms(QEMU_CLOCK_REALTIME, metrics_tick, s);
+    timer_mod(s->timer, s->last_ns / SCALE_MS + s->interval);
+}
+
+static char *metrics_get_chardev(Object *obj, Error **errp)
+{
+    Metrics *s = METRICS(obj);
+
+    return g_strdup(s->chr_name);
+}
+
+static void metrics_set_chardev(Object *obj, const char *value, Error **errp)
+{
+    Metrics *s = METRICS(obj);
+
+    if (s->timer) {
+        error_setg(errp, QERR_PERMISSION_DENIED);
+        return;
+    }
+    g_free(s->chr_name);
+    s->chr_name = g_strdup(value);
+}
+
+static void metrics_get_interval(Object *obj, Visitor *v, const char *name,
+                                 void *opaque, Error **errp)
+{
+    Metrics *s = METRICS(obj);
+
+    visit_type_uint32(v, name, &s->interval, errp);
+}
+
+static void metrics_set_interval(Object *obj, Visitor *v, const char *name,
+                                 void *opaque, Error **errp)
+{
+    Metrics *s = METRICS(obj);
+    Error *local_err = NULL;
+    uint32_t value;
+
+    if (s->timer) {
+        error_setg(errp, QERR_PERMISSION_DENIED);
+        return;
+    }
+    visit_type_uint32(v, name, &value, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return;
+    }
+    s->interval = value;
+}
+
+static void metrics_init(Object *obj)
+{
+    Metrics *s = METRICS(obj);
+
+    s->interval = 1000;
+    object_property_add_str(obj, "chardev",
+                            metrics_get_chardev, metrics_set_chardev, NULL);
+    object_property_add(obj, "interval", "uint32",
+                        metrics_get_interval, metrics_set_interval,
+                        NULL, NULL, NULL);
+}
+
+static void metrics_finalize(Object *obj)
+{
+    Metrics *s = METRICS(obj);
+
+    if (s->timer) {
+        timer_del(s->timer);
+        timer_free(s->timer);
+        g_hash_table_destroy(s->mmio);
+        if (--metrics_running == 0) {
+            qemu_mutex_iothread_timing(false);
+        }
+    }
+    if (s->chr) {
+        qemu_chr_fe_release(s->chr);
+    }
+    g_free(s->chr_name);
+}
+
+static void metrics_class_init(ObjectClass *oc, void *data)
+{
+    UserCreatableClass *ucc = USER_CREATABLE_CLASS(oc);
+
+    ucc->complete = metrics_complete;
+}
+
+static const TypeInfo metrics_info = {
+    .name = TYPE_METRICS,
+    .parent = TYPE_OBJECT,
+    .instance_size = sizeof(Metrics),
+    .instance_init = metrics_init,
+    .instance_finalize = metrics_finalize,
+    .class_init = metrics_class_init,
+    .interfaces = (InterfaceInfo[]) {
+        { TYPE_USER_CREATABLE },
+        { }
+    },
+};
+
+static void register_types(void)
+{
+    type_register_static(&metrics_info);
+}
+
+type_init(register_types);
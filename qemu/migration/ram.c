@@ -562,7 +562,9 @@ ram_addr_t migration_bitmap_find_dirty(RAMBlock *rb,
     unsigned long next;
 
     bitmap = atomic_rcu_read(&migration_bitmap_rcu)->bmap;
-    if (ram_bulk_stage && nr > base) {
+    if (!qemu_ram_is_migratable(rb)) {
+        next = size;
+    } else if (ram_bulk_stage && nr > base) {
         next = nr + 1;
     } else {
         next = find_next_bit(bitmap, size, nr);
@@ -634,7 +636,9 @@ static void migration_bitmap_sync(void)
     qemu_mutex_lock(&migration_bitmap_mutex);
     rcu_read_lock();
     QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
-        migration_bitmap_sync_range(block->offset, block->used_length);
+        if (qemu_ram_is_migratable(block)) {
+            migration_bitmap_sync_range(block->offset, block->used_length);
+        }
     }
     rcu_read_unlock();
     qemu_mutex_unlock(&migration_bitmap_mutex);
@@ -1401,8 +1405,11 @@ uint64_t ram_bytes_total(void)
     uint64_t total = 0;
 
     rcu_read_lock();
-    QLIST_FOREACH_RCU(block, &ram_list.blocks, next)
-        total += block->used_length;
+    QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
+        if (qemu_ram_is_migratable(block)) {
+            total += block->used_length;
+        }
+    }
     rcu_read_unlock();
     return total;
 }
@@ -1582,9 +1589,12 @@ static int postcopy_each_ram_send_discard(MigrationState *ms)
 
     QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
         unsigned long first = block->offset >> TARGET_PAGE_BITS;
-        PostcopyDiscardState *pds = postcopy_discard_send_init(ms,
-                                                               first,
-                                                               block->idstr);
+        PostcopyDiscardState *pds;
+
+        if (!qemu_ram_is_migratable(block)) {
+            continue;
+        }
+        pds = postcopy_discard_send_init(ms, first, block->idstr);
 
         /*
          * Postcopy sends chunks of bitmap over the wire, but it
@@ -1749,9 +1759,12 @@ static int postcopy_chunk_hostpages(MigrationState *ms)
 
     QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
         unsigned long first = block->offset >> TARGET_PAGE_BITS;
+        PostcopyDiscardState *pds;
 
-        PostcopyDiscardState *pds =
-                         postcopy_discard_send_init(ms, first, block->idstr);
+        if (!qemu_ram_is_migratable(block)) {
+            continue;
+        }
+        pds = postcopy_discard_send_init(ms, first, block->idstr);
 
         /* First pass: Discard all partially sent host pages */
         postcopy_chunk_hostpages_pass(ms, true, block, pds);
@@ -1939,6 +1952,20 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
         bitmap_set(migration_bitmap_rcu->unsentmap, 0, ram_bitmap_pages);
     }
 
+    /* Blocks left out of migration never have a page to send */
+    QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
+        if (!qemu_ram_is_migratable(block)) {
+            bitmap_clear(migration_bitmap_rcu->bmap,
+                         block->offset >> TARGET_PAGE_BITS,
+                         block->max_length >> TARGET_PAGE_BITS);
+            if (migration_bitmap_rcu->unsentmap) {
+                bitmap_clear(migration_bitmap_rcu->unsentmap,
+                             block->offset >> TARGET_PAGE_BITS,
+                             block->max_length >> TARGET_PAGE_BITS);
+            }
+        }
+    }
+
     /*
      * Count the total number of pages used by ram blocks not including any
      * gaps due to alignment or unplugs.
@@ -1953,6 +1980,9 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
     qemu_put_be64(f, ram_bytes_total() | RAM_SAVE_FLAG_MEM_SIZE);
 
     QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
+        if (!qemu_ram_is_migratable(block)) {
+            continue;
+        }
         qemu_put_byte(f, strlen(block->idstr));
         qemu_put_buffer(f, (uint8_t *)block->idstr, strlen(block->idstr));
         qemu_put_be64(f, block->used_length);
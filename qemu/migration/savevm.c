@@ -50,6 +50,9 @@
 #include "block/snapshot.h"
 #include "block/qapi.h"
 #include "qemu/cutils.h"
+#include "qemu/rcu_queue.h"
+#include "exec/ram_addr.h"
+#include "cpu.h"
 
 #ifndef ETH_P_RARP
 #define ETH_P_RARP 0x8035
@@ -2241,3 +2244,326 @@ void vmstate_register_ram_global(MemoryRegion *mr)
 {
     vmstate_register_ram(mr, NULL);
 }
+
+/* For RAM the guest maps but whose contents are not the guest's, such as
+ * a segment shared with host programs: it is neither saved nor loaded.
+ */
+void vmstate_exclude_ram(MemoryRegion *mr)
+{
+    qemu_ram_set_nomigrate(memory_region_get_ram_addr(mr) & TARGET_PAGE_MASK);
+}
+
+/* Copy-on-write snapshots, for putting a test guest back to a known state
+ * between test cases in milliseconds rather than a boot.
+ *
+ * Taking one writes guest RAM to a file once and then maps the file
+ * MAP_PRIVATE over guest RAM, so from then on the guest gets private
+ * copies of just the pages it writes.  Restoring drops those copies with
+ * MADV_DONTNEED and the pages read through to the file again: the cost
+ * is proportional to what the test dirtied, not to the size of RAM.
+ * Device state is kept in memory and reloaded, and the disks go back to
+ * an internal snapshot without VM state (cheap on qcow2), so that the
+ * guest's page cache and its disk still agree.
+ *
+ * Shared memory backends cannot be remapped and are copied instead.
+ * Memory a device supplied with memory_region_init_ram_ptr is left alone:
+ * it belongs to the device, which may share it with host programs (the
+ * rpi_gpio pv page holds the segment's seqlock, waiters and counters),
+ * and the device puts back its part from its own state.  MADV_DONTNEED
+ * only has these semantics on Linux.
+ */
+#define COW_SNAPSHOT_NAME "cow-snapshot"
+
+typedef struct CowSnapshotBlock {
+    RAMBlock *rb;
+    void *host;
+    ram_addr_t length;      /* used_length, rounded up to host pages if mapped */
+    off_t offset;           /* in the RAM file */
+    bool mapped;            /* the file is mapped over it */
+    void *copy;             /* contents, for shared blocks */
+} CowSnapshotBlock;
+
+static struct {
+    int fd;
+    int nr_blocks;
+    CowSnapshotBlock *blocks;
+    QEMUSizedBuffer *devices;
+} cow_snapshot = { .fd = -1 };
+
+static void cow_snapshot_free(void)
+{
+    int i;
+
+    /* Mapped blocks stay mapped: the guest is still running on them */
+    for (i = 0; i < cow_snapshot.nr_blocks; i++) {
+        g_free(cow_snapshot.blocks[i].copy);
+    }
+    g_free(cow_snapshot.blocks);
+    cow_snapshot.blocks = NULL;
+    cow_snapshot.nr_blocks = 0;
+    if (cow_snapshot.fd >= 0) {
+        close(cow_snapshot.fd);
+        cow_snapshot.fd = -1;
+    }
+    if (cow_snapshot.devices) {
+        qsb_free(cow_snapshot.devices);
+        cow_snapshot.devices = NULL;
+    }
+}
+
+/* Save a RAM block to the file and map the file over it */
+static int cow_snapshot_map_block(CowSnapshotBlock *b, int fd, Error **errp)
+{
+    if (lseek(fd, b->offset, SEEK_SET) != b->offset ||
+        qemu_write_full(fd, b->host, b->rb->used_length) !=
+            (ssize_t)b->rb->used_length) {
+        error_setg_errno(errp, errno, "Could not save RAM block '%s'",
+                         b->rb->idstr);
+        return -1;
+    }
+    if (mmap(b->host, b->length, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, fd, b->offset) == MAP_FAILED) {
+        error_setg_errno(errp, errno, "Could not map RAM block '%s'",
+                         b->rb->idstr);
+        return -1;
+    }
+    return 0;
+}
+
+static int cow_snapshot_save_ram(int fd, Error **errp)
+{
+    RAMBlock *block;
+    off_t offset = 0;
+    int i = 0, ret = 0;
+
+    rcu_read_lock();
+    QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
+        cow_snapshot.nr_blocks++;
+    }
+    cow_snapshot.blocks = g_new0(CowSnapshotBlock, cow_snapshot.nr_blocks);
+
+    QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
+        CowSnapshotBlock *b = &cow_snapshot.blocks[i++];
+
+        b->rb = block;
+        b->host = block->host;
+        if (qemu_ram_is_prealloc(block)) {
+            b->length = block->used_length;
+            continue;
+        }
+        if (!qemu_ram_is_private(block)) {
+            b->length = block->used_length;
+            b->copy = g_memdup(b->host, b->length);
+            continue;
+        }
+        b->mapped = true;
+        b->length = REAL_HOST_PAGE_ALIGN(block->used_length);
+        b->offset = offset;
+        offset += b->length;
+        if (ftruncate(fd, offset) < 0) {
+            error_setg_errno(errp, errno, "Could not size the RAM file");
+            ret = -1;
+            break;
+        }
+        ret = cow_snapshot_map_block(b, fd, errp);
+        if (ret < 0) {
+            break;
+        }
+    }
+    rcu_read_unlock();
+
+    return ret;
+}
+
+/* Restoring needs the same blocks at the same addresses */
+static bool cow_snapshot_ram_unchanged(void)
+{
+    RAMBlock *block;
+    CowSnapshotBlock *b = cow_snapshot.blocks;
+    int i = 0;
+
+    rcu_read_lock();
+    QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
+        if (i == cow_snapshot.nr_blocks || b[i].rb != block ||
+            b[i].host != block->host ||
+            (b[i].mapped ? REAL_HOST_PAGE_ALIGN(block->used_length)
+                         : block->used_length) != b[i].length) {
+            break;
+        }
+        i++;
+    }
+    rcu_read_unlock();
+
+    return i == cow_snapshot.nr_blocks && !block;
+}
+
+void qmp_cow_snapshot_take(const char *filename, Error **errp)
+{
+    BlockDriverState *bs;
+    QEMUSnapshotInfo sn;
+    QEMUFile *f;
+    qemu_timeval tv;
+    Error *local_err = NULL;
+    int saved_vm_running;
+    int fd, ret;
+
+    if (!bdrv_all_can_snapshot(&bs)) {
+        error_setg(errp, "Device '%s' is writable but does not support "
+                   "snapshots", bdrv_get_device_name(bs));
+        return;
+    }
+
+    /* A file from an earlier snapshot may still back guest RAM, so it is
+       replaced rather than truncated */
+    unlink(filename);
+    fd = qemu_open(filename, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        error_setg_file_open(errp, errno, filename);
+        return;
+    }
+
+    saved_vm_running = runstate_is_running();
+    vm_stop(RUN_STATE_SAVE_VM);
+    global_state_store_running();
+
+    cow_snapshot_free();
+    cow_snapshot.fd = fd;
+
+    if (cow_snapshot_save_ram(fd, &local_err) < 0) {
+        goto fail;
+    }
+
+    cow_snapshot.devices = qsb_create(NULL, 0);
+    f = qemu_bufopen("w", cow_snapshot.devices);
+    ret = qemu_save_device_state(f);
+    qemu_fclose(f);
+    if (ret < 0) {
+        error_setg(&local_err, "Error %d while saving device state", ret);
+        goto fail;
+    }
+
+    if (bdrv_all_delete_snapshot(COW_SNAPSHOT_NAME, &bs, &local_err) < 0) {
+        goto fail;
+    }
+    memset(&sn, 0, sizeof(sn));
+    pstrcpy(sn.name, sizeof(sn.name), COW_SNAPSHOT_NAME);
+    qemu_gettimeofday(&tv);
+    sn.date_sec = tv.tv_sec;
+    sn.date_nsec = tv.tv_usec * 1000;
+    sn.vm_clock_nsec = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    if (bdrv_all_create_snapshot(&sn, NULL, 0, &bs) < 0) {
+        error_setg(&local_err, "Error while creating snapshot on '%s'",
+                   bdrv_get_device_name(bs));
+        goto fail;
+    }
+    goto the_end;
+
+ fail:
+    /* The blocks mapped so far are still good RAM, just nothing to go
+       back to */
+    cow_snapshot_free();
+    error_propagate(errp, local_err);
+ the_end:
+    if (saved_vm_running) {
+        vm_start();
+    }
+}
+
+void qmp_cow_snapshot_restore(Error **errp)
+{
+    BlockDriverState *bs;
+    MigrationIncomingState *mis;
+    CowSnapshotBlock *b;
+    QEMUFile *f;
+    int saved_vm_running;
+    int i, ret;
+
+    if (!cow_snapshot.devices) {
+        error_setg(errp, "No snapshot taken with cow-snapshot-take");
+        return;
+    }
+    if (!cow_snapshot_ram_unchanged()) {
+        error_setg(errp, "Guest RAM layout changed since the snapshot");
+        return;
+    }
+
+    saved_vm_running = runstate_is_running();
+    vm_stop(RUN_STATE_RESTORE_VM);
+
+    /* Flush all IO requests so they don't interfere with the new state */
+    bdrv_drain_all();
+    if (bdrv_all_goto_snapshot(COW_SNAPSHOT_NAME, &bs) < 0) {
+        error_setg(errp, "Could not revert '%s' to the snapshot",
+                   bdrv_get_device_name(bs));
+        goto out;
+    }
+
+    for (i = 0; i < cow_snapshot.nr_blocks; i++) {
+        b = &cow_snapshot.blocks[i];
+        if (!b->mapped && !b->copy) {
+            continue;
+        }
+        if (b->copy) {
+            memcpy(b->host, b->copy, b->length);
+        } else if (qemu_madvise(b->host, b->length, QEMU_MADV_DONTNEED) < 0) {
+            error_setg_errno(errp, errno, "Could not restore RAM block '%s'",
+                             b->rb->idstr);
+            goto out;
+        }
+        /* Nothing saw these pages change: displays must redraw them */
+        cpu_physical_memory_set_dirty_range(b->rb->offset, b->rb->used_length,
+                                            tcg_enabled() ? DIRTY_CLIENTS_ALL
+                                                          : DIRTY_CLIENTS_NOCODE);
+    }
+    if (tcg_enabled()) {
+        /* Guest code changed behind the translator's back */
+        tb_flush(first_cpu);
+    }
+
+    f = qemu_bufopen("r", cow_snapshot.devices);
+    qemu_system_reset(VMRESET_SILENT);
+    mis = migration_incoming_state_new(f);
+
+    /* The stream from qemu_save_device_state has no configuration or
+       description sections, so this is qemu_loadvm_state without them */
+    if (qemu_get_be32(f) != QEMU_VM_FILE_MAGIC ||
+        qemu_get_be32(f) != QEMU_VM_FILE_VERSION) {
+        ret = -EINVAL;
+    } else {
+        ret = qemu_loadvm_state_main(f, mis);
+        cpu_synchronize_all_post_init();
+    }
+    qemu_fclose(f);
+    migration_incoming_state_destroy();
+
+    if (ret < 0) {
+        error_setg(errp, "Error %d while loading device state", ret);
+    }
+
+out:
+    /* Like after loadvm, the guest runs on if it was running, whether or
+       not the restore worked */
+    if (saved_vm_running) {
+        vm_start();
+    }
+}
+
+void hmp_cow_snapshot_take(Monitor *mon, const QDict *qdict)
+{
+    Error *err = NULL;
+
+    qmp_cow_snapshot_take(qdict_get_str(qdict, "filename"), &err);
+    if (err) {
+        error_report_err(err);
+    }
+}
+
+void hmp_cow_snapshot_restore(Monitor *mon, const QDict *qdict)
+{
+    Error *err = NULL;
+
+    qmp_cow_snapshot_restore(&err);
+    if (err) {
+        error_report_err(err);
+    }
+}
@@ -584,6 +584,56 @@ Example:
      "arguments": { "filename": "/tmp/save" } }
 <- { "return": {} }
 
+EQMP
+
+    {
+        .name       = "cow-snapshot-take",
+        .args_type  = "filename:F",
+    .mhandler.cmd_new = qmp_marshal_cow_snapshot_take,
+    },
+
+SQMP
+cow-snapshot-take
+-----------------
+
+Take a snapshot to reset the guest to with cow-snapshot-restore. Guest
+RAM is written to a file that then backs it copy-on-write, the device
+state is kept in memory and writable disks get an internal snapshot
+called "cow-snapshot".
+
+Arguments:
+
+- "filename": the RAM file; it is replaced if it exists (json-string)
+
+Example:
+
+-> { "execute": "cow-snapshot-take",
+     "arguments": { "filename": "/tmp/guest.ram" } }
+<- { "return": {} }
+
+EQMP
+
+    {
+        .name       = "cow-snapshot-restore",
+        .args_type  = "",
+    .mhandler.cmd_new = qmp_marshal_cow_snapshot_restore,
+    },
+
+SQMP
+cow-snapshot-restore
+--------------------
+
+Reset the guest to the snapshot taken with cow-snapshot-take. Only the
+RAM pages written since are read back. A guest that was running runs on
+afterwards, even if the restore failed.
+
+Arguments: None.
+
+Example:
+
+-> { "execute": "cow-snapshot-restore" }
+<- { "return": {} }
+
 EQMP
 
     {
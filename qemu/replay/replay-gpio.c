@@ -0,0 +1,56 @@
+/*
+ * replay-gpio.c
+ *
+ * Record/replay of GPIO input levels driven from outside the VM.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ *
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "sysemu/replay.h"
+#include "replay-internal.h"
+
+void replay_gpio_input_save(uint8_t id, const uint32_t *levels, int count)
+{
+    int i;
+
+    replay_save_instructions();
+    replay_mutex_lock();
+    replay_put_event(EVENT_GPIO_INPUT);
+    replay_put_byte(id);
+    replay_put_byte(count);
+    for (i = 0; i < count; i++) {
+        replay_put_dword(levels[i]);
+    }
+    replay_mutex_unlock();
+}
+
+bool replay_gpio_input_load(uint8_t id, uint32_t *levels, int count)
+{
+    int i, n;
+
+    replay_account_executed_instructions();
+    replay_mutex_lock();
+    if (!replay_next_event_is(EVENT_GPIO_INPUT)) {
+        replay_mutex_unlock();
+        return false;
+    }
+    if (replay_get_byte() != id) {
+        replay_mutex_unlock();
+        error_report("Unexpected GPIO controller in the replay log");
+        exit(1);
+    }
+    n = replay_get_byte();
+    for (i = 0; i < n; i++) {
+        uint32_t level = replay_get_dword();
+        if (i < count) {
+            levels[i] = level;
+        }
+    }
+    replay_finish_event();
+    replay_mutex_unlock();
+    return true;
+}
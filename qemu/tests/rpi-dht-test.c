@@ -0,0 +1,104 @@
+/*
+ * QTest testcase for the rpi-dht sensor
+ *
+ * Runs wiringPi's own MaxDetect reader (wiringEmuPi/devLib/maxdetect.c)
+ * against the sensor, with its pin functions done through rpi_gpio's
+ * registers and its delays and timeouts on the virtual clock.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "rpi-gpio-shm.h"
+
+#include <glib.h>
+#include <wiringPi.h>
+
+#define RPI_GPIO_BASE   0x20200000
+#define GPFSEL0         0x00
+#define GPSET0          0x1c
+#define GPCLR0          0x28
+#define GPLEV0          0x34
+#define DHT_PIN         4
+
+/* Virtual time after the last clock_step */
+static int64_t now_ns;
+
+static int virtual_gettimeofday(struct timeval *tv)
+{
+    tv->tv_sec = now_ns / 1000000000;
+    tv->tv_usec = now_ns % 1000000000 / 1000;
+    return 0;
+}
+
+#define gettimeofday(tv, tz) virtual_gettimeofday(tv)
+#include "maxdetect.c"
+
+void pinMode(int pin, int mode)
+{
+    uint32_t fsel = readl(RPI_GPIO_BASE + GPFSEL0 + pin / 10 * 4);
+
+    fsel &= ~(7 << (pin % 10 * 3));
+    fsel |= (mode == OUTPUT) << (pin % 10 * 3);
+    writel(RPI_GPIO_BASE + GPFSEL0 + pin / 10 * 4, fsel);
+}
+
+void digitalWrite(int pin, int value)
+{
+    writel(RPI_GPIO_BASE + (value ? GPSET0 : GPCLR0), 1 << pin);
+}
+
+/* A polling loop gets a microsecond per read */
+int digitalRead(int pin)
+{
+    int value = (readl(RPI_GPIO_BASE + GPLEV0) >> pin) & 1;
+
+    now_ns = clock_step(1000);
+    return value;
+}
+
+void delay(unsigned int howLong)
+{
+    now_ns = clock_step(howLong * 1000000LL);
+}
+
+void delayMicroseconds(unsigned int howLong)
+{
+    now_ns = clock_step(howLong * 1000LL);
+}
+
+static void test_dht11_read(void)
+{
+    unsigned char buffer[4];
+
+    now_ns = clock_step(1000000);
+    g_assert(maxDetectRead(DHT_PIN, buffer));
+    g_assert_cmpint(buffer[0], ==, 45);
+    g_assert_cmpint(buffer[1], ==, 0);
+    g_assert_cmpint(buffer[2], ==, 23);
+    g_assert_cmpint(buffer[3], ==, 0);
+}
+
+int main(int argc, char **argv)
+{
+    char *args;
+    void *shm;
+    int ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    args = g_strdup_printf("-machine versatilepb -m 32 -display none "
+                           "-device rpi-dht,pin=%d,model=11,"
+                           "temperature=23000,humidity=45000", DHT_PIN);
+    shm = rpi_gpio_shm_qtest_start(args);
+    g_free(args);
+
+    qtest_add_func("/rpi_dht/dht11/maxdetect", test_dht11_read);
+    ret = g_test_run();
+
+    qtest_end();
+    shmdt(shm);
+    return ret;
+}
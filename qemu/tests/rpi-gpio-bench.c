@@ -0,0 +1,111 @@
+/*
+ * QTest microbenchmark for the rpi_gpio device and other versatilepb
+ * peripherals
+ *
+ *   QTEST_QEMU_BINARY=arm-softmmu/qemu-system-arm tests/rpi-gpio-bench [count [filter]]
+ *
+ * or "make bench-rpi-gpio".  Every access goes over the qtest socket, which
+ * costs far more than the device does, so the same access to RAM is timed
+ * first and each result is also shown with that subtracted.  count is the
+ * number of accesses per row (default 100000); filter only runs the rows
+ * whose name contains it.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "rpi-gpio-shm.h"
+
+#include <glib.h>
+
+#define RAM_BASE        0x00010000
+#define PL061_BASE      0x101e4000
+#define SP804_BASE      0x101e2000
+#define PL011_BASE      0x101f1000
+#define RPI_GPIO_BASE   0x20200000
+
+typedef struct BenchAccess {
+    const char *name;
+    uint64_t addr;
+    bool write;
+    uint32_t value;     /* Written, alternating with value ^ toggle */
+    uint32_t toggle;
+} BenchAccess;
+
+static const BenchAccess accesses[] = {
+    { "ram/readl",              RAM_BASE,               false },
+    { "ram/writel",             RAM_BASE,               true,  0, 1 },
+    /* GPSET0/GPCLR0 on pin 17 is the toggle a guest does most */
+    { "rpi_gpio/GPLEV0 readl",  RPI_GPIO_BASE + 0x34,   false },
+    { "rpi_gpio/GPSET0 writel", RPI_GPIO_BASE + 0x1c,   true,  1 << 17, 0 },
+    { "rpi_gpio/GPCLR0 writel", RPI_GPIO_BASE + 0x28,   true,  1 << 17, 0 },
+    { "rpi_gpio/GPFSEL1 writel", RPI_GPIO_BASE + 0x04,  true,  1 << 21, 0 },
+    { "pl061/DATA readl",       PL061_BASE + 0x3fc,     false },
+    { "pl061/DATA writel",      PL061_BASE + 0x3fc,     true,  0xff, 0xff },
+    { "sp804/VALUE readl",      SP804_BASE + 0x04,      false },
+    { "sp804/LOAD writel",      SP804_BASE + 0x00,      true,  0x10000, 1 },
+    { "pl011/FR readl",         PL011_BASE + 0x18,      false },
+    { "pl011/IMSC writel",      PL011_BASE + 0x38,      true,  0, 0x10 },
+};
+
+static double bench_run(const BenchAccess *a, long count)
+{
+    int64_t start;
+    long i;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < count; i++) {
+        if (a->write) {
+            writel(a->addr, (i & 1) ? a->value ^ a->toggle : a->value);
+        } else {
+            readl(a->addr);
+        }
+    }
+    return (g_get_monotonic_time() - start) * 1000.0 / count;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 2 ? argv[2] : NULL;
+    long count = argc > 1 ? atol(argv[1]) : 100000;
+    double ns, ram_read, ram_write;
+    void *shm;
+    int i;
+
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [count [filter]]\n", argv[0]);
+        return 1;
+    }
+
+    /* The pin 17 writes would otherwise reach any emulator or wiringEmuPi
+     * program on the host
+     */
+    shm = rpi_gpio_shm_qtest_start("-machine versatilepb -display none");
+
+    /* Pin 17 an output, the pl061 lines outputs */
+    writel(RPI_GPIO_BASE + 0x04, 1 << 21);
+    writel(PL061_BASE + 0x400, 0xff);
+
+    /* Warm up the connection, then take the RAM baselines */
+    bench_run(&accesses[0], count / 10 + 1);
+    ram_read = bench_run(&accesses[0], count);
+    ram_write = bench_run(&accesses[1], count);
+
+    printf("%-26s %12s %12s\n", "access", "ns/access", "over RAM");
+    for (i = 0; i < ARRAY_SIZE(accesses); i++) {
+        const BenchAccess *a = &accesses[i];
+
+        if (filter && !strstr(a->name, filter)) {
+            continue;
+        }
+        ns = i == 0 ? ram_read : i == 1 ? ram_write : bench_run(a, count);
+        printf("%-26s %12.1f %12.1f\n", a->name, ns,
+               ns - (a->write ? ram_write : ram_read));
+    }
+
+    qtest_end();
+    shmdt(shm);
+    return 0;
+}
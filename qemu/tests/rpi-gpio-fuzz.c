@@ -0,0 +1,315 @@
+/*
+ * QTest fuzz test for the rpi_gpio MMIO interface
+ *
+ * Drives a random sequence of register reads, writes (function selects,
+ * set/clear, event detect, waveform generators, reserved and unknown
+ * offsets) and virtual clock steps at the device, while a host thread
+ * flips input levels in the shared segment as fast as it can.  After every
+ * step it checks:
+ *
+ *   - OUTSTATE only changes on pins that are outputs
+ *   - GPLEV shows no level on an input the host did not touch, and none
+ *     above pin 53
+ *   - registers read back what was written (or 0 where write only,
+ *     reserved or unknown); GPEDS1 has no bits above pin 53
+ *   - the function selects published to the segment are the device's,
+ *     the seqlock is not left odd, and the MMIO counters count every access
+ *
+ * The sequence comes from the test's random seed, so a failure replays
+ * with the --seed gtester prints.  RPI_GPIO_FUZZ_OPS sets the number of
+ * steps (default 20000, 200000 with -m slow) and RPI_GPIO_FUZZ_MIN_RATE,
+ * if set, fails the test below that many steps per second, for keeping an
+ * eye on the device's speed.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "rpi-gpio-shm.h"
+
+#include <glib.h>
+
+#define RPI_GPIO_BASE   0x20200000
+#define RPI_GPIO_SIZE   0x1000
+#define GPFSEL0         0x00
+#define GPSET0          0x1c
+#define GPCLR0          0x28
+#define GPLEV0          0x34
+#define GPEDS0          0x40
+#define PV_CTRL         0xc0
+#define WAVE_INFO       0xc4
+#define WAVE_BASE       0x100
+#define WAVE_SLOTS      8
+#define WAVE_STRIDE     0x10
+#define WAVE_ENABLE     (1u << 31)
+#define WAVE_MIN_NS     1000
+
+/* Input pins the host thread flips.  Bank 1 includes bits above pin 53,
+ * which the device must ignore.
+ */
+static const uint32_t host_mask[2] = { 0x0f0f00f0, 0xf00f000f };
+
+/* The head of shared_gpio_state in hw/gpio/rpi_gpio.c */
+typedef struct SharedGpio {
+    uint32_t GPFSEL[6];
+    uint32_t GPLEV[2];
+    uint32_t OUTSTATE[2];
+    uint64_t MMIO_READS;
+    uint64_t MMIO_WRITES;
+    uint64_t OUTPUT_EDGES;
+    uint32_t SEQ;
+} SharedGpio;
+
+/* What the device should hold, from the writes so far */
+typedef struct Model {
+    uint32_t regs[WAVE_BASE / 4];
+    uint32_t wave[WAVE_SLOTS][3];
+    uint32_t out_mask[2];
+    uint32_t in_mask[2];
+    uint64_t reads, writes;
+} Model;
+
+static SharedGpio *shm;
+static volatile bool host_stop;
+
+static gpointer host_writer(gpointer opaque)
+{
+    uint32_t x = 1;
+    int i;
+
+    while (!host_stop) {
+        for (i = 0; i < 64; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            __atomic_fetch_xor(&shm->GPLEV[x & 1], x & host_mask[x & 1],
+                               __ATOMIC_RELAXED);
+        }
+        g_thread_yield();
+    }
+    return NULL;
+}
+
+/* Registers that read back what was last written: GPFSELx, the event
+ * detect enables and the pull up/down control
+ */
+static bool plain_reg(uint32_t offset)
+{
+    return offset <= 0x14 ||
+           (offset >= 0x4c && offset <= 0x8c && (offset - 0x4c) % 0xc != 8) ||
+           (offset >= 0x94 && offset <= 0x9c);
+}
+
+static void model_update_fsel(Model *m)
+{
+    uint32_t fsel;
+    int pin;
+
+    m->in_mask[0] = m->in_mask[1] = 0;
+    m->out_mask[0] = m->out_mask[1] = 0;
+    for (pin = 0; pin < 54; pin++) {
+        fsel = (m->regs[pin / 10] >> (3 * (pin % 10))) & 7;
+        if (fsel == 0) {
+            m->in_mask[pin / 32] |= 1u << (pin % 32);
+        } else if (fsel == 1) {
+            m->out_mask[pin / 32] |= 1u << (pin % 32);
+        }
+    }
+}
+
+/* What a read of offset should return, false if it can't be told */
+static bool model_read(Model *m, uint32_t offset, uint32_t *value)
+{
+    uint32_t *w;
+
+    if (offset >= WAVE_BASE && offset < WAVE_BASE + WAVE_SLOTS * WAVE_STRIDE) {
+        w = m->wave[(offset - WAVE_BASE) / WAVE_STRIDE];
+        *value = offset % WAVE_STRIDE < 0xc ? w[offset % WAVE_STRIDE / 4] : 0;
+        return true;
+    }
+    if (plain_reg(offset)) {
+        *value = m->regs[offset / 4];
+        return true;
+    }
+    switch (offset) {
+    case GPLEV0:
+    case GPLEV0 + 4:
+    case GPEDS0:
+    case GPEDS0 + 4:
+        return false;
+    case WAVE_INFO:
+        *value = WAVE_SLOTS;
+        return true;
+    default:
+        /* GPSETx, GPCLRx, PV_CTRL without pv, reserved and unknown */
+        *value = 0;
+        return true;
+    }
+}
+
+static void model_write(Model *m, uint32_t offset, uint32_t value)
+{
+    uint32_t *w;
+
+    if (offset >= WAVE_BASE && offset < WAVE_BASE + WAVE_SLOTS * WAVE_STRIDE) {
+        w = m->wave[(offset - WAVE_BASE) / WAVE_STRIDE];
+        if (offset % WAVE_STRIDE == 0) {
+            w[0] = value & (WAVE_ENABLE | 0x3f);
+            if ((w[0] & 0x3f) >= 54) {
+                w[0] &= ~WAVE_ENABLE;
+            }
+        } else if (offset % WAVE_STRIDE < 0xc) {
+            w[offset % WAVE_STRIDE / 4] = value && value < WAVE_MIN_NS ?
+                                          WAVE_MIN_NS : value;
+        }
+        return;
+    }
+    if (plain_reg(offset)) {
+        m->regs[offset / 4] = value;
+        if (offset <= 0x14) {
+            model_update_fsel(m);
+        }
+    }
+}
+
+/* Function selects: mostly inputs and outputs, some alternate functions */
+static uint32_t random_fsel(void)
+{
+    uint32_t value = (uint32_t)g_test_rand_int_range(0, 4) << 30;
+    int i, r;
+
+    for (i = 0; i < 10; i++) {
+        r = g_test_rand_int_range(0, 10);
+        value |= (r < 4 ? 0 : r < 8 ? 1 : g_test_rand_int_range(2, 8)) << (3 * i);
+    }
+    return value;
+}
+
+static uint32_t random_offset(void)
+{
+    static const uint32_t regs[] = {
+        0x00, 0x04, 0x08, 0x0c, 0x10, 0x14, 0x1c, 0x20, 0x28, 0x2c,
+        0x34, 0x38, 0x40, 0x44, 0x4c, 0x50, 0x58, 0x5c, 0x64, 0x68,
+        0x70, 0x74, 0x7c, 0x80, 0x88, 0x8c, 0x94, 0x98, 0x9c,
+        PV_CTRL, WAVE_INFO,
+    };
+    int r = g_test_rand_int_range(0, 10);
+
+    if (r < 7) {
+        return regs[g_test_rand_int_range(0, ARRAY_SIZE(regs))];
+    } else if (r < 9) {
+        return WAVE_BASE + g_test_rand_int_range(0, WAVE_SLOTS * WAVE_STRIDE / 4) * 4;
+    }
+    return g_test_rand_int_range(0, RPI_GPIO_SIZE / 4) * 4;
+}
+
+static uint32_t random_value(uint32_t offset)
+{
+    if (offset <= 0x14) {
+        return random_fsel();
+    }
+    if (offset >= WAVE_BASE && offset % WAVE_STRIDE == 0) {
+        return (g_test_rand_bit() ? WAVE_ENABLE : 0) |
+               g_test_rand_int_range(0, 64);
+    }
+    if (offset >= WAVE_BASE) {
+        /* Mark and space of up to 20us, so clock steps see edges */
+        return g_test_rand_int_range(0, 4) ? g_test_rand_int_range(0, 20000) : 0;
+    }
+    return g_test_rand_int();
+}
+
+static void check_state(Model *m, const uint32_t *old_out)
+{
+    uint32_t out, fsel;
+    int b, i;
+
+    g_assert_cmpuint(__atomic_load_n(&shm->SEQ, __ATOMIC_ACQUIRE) & 1, ==, 0);
+    for (b = 0; b < 2; b++) {
+        out = __atomic_load_n(&shm->OUTSTATE[b], __ATOMIC_RELAXED);
+        g_assert_cmphex((out ^ old_out[b]) & ~m->out_mask[b], ==, 0);
+    }
+    for (i = 0; i < 6; i++) {
+        fsel = __atomic_load_n(&shm->GPFSEL[i], __ATOMIC_RELAXED);
+        g_assert_cmphex(fsel, ==, m->regs[i]);
+    }
+    g_assert_cmpuint(shm->MMIO_READS, ==, m->reads);
+    g_assert_cmpuint(shm->MMIO_WRITES, ==, m->writes);
+}
+
+static void test_fuzz(void)
+{
+    Model m = { .reads = shm->MMIO_READS, .writes = shm->MMIO_WRITES };
+    const char *env = getenv("RPI_GPIO_FUZZ_OPS");
+    long ops = env ? atol(env) : g_test_slow() ? 200000 : 20000;
+    uint32_t offset, value, expected, old_out[2];
+    int64_t start;
+    double rate;
+    GThread *thread;
+    long i;
+    int b;
+
+    model_update_fsel(&m);
+    host_stop = false;
+    thread = g_thread_new("host-writer", host_writer, NULL);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < ops; i++) {
+        old_out[0] = shm->OUTSTATE[0];
+        old_out[1] = shm->OUTSTATE[1];
+        offset = random_offset();
+
+        switch (g_test_rand_int_range(0, 16)) {
+        case 0:
+            clock_step(g_test_rand_int_range(1, 50000));
+            break;
+        case 1 ... 6:
+            value = readl(RPI_GPIO_BASE + offset);
+            m.reads++;
+            if (model_read(&m, offset, &expected)) {
+                g_assert_cmphex(value, ==, expected);
+            } else if (offset == GPLEV0 || offset == GPLEV0 + 4) {
+                b = (offset - GPLEV0) / 4;
+                g_assert_cmphex(value & m.in_mask[b] & ~host_mask[b], ==, 0);
+                g_assert_cmphex(value & ~(b ? 0x003fffff : ~0u), ==, 0);
+            } else if (offset == GPEDS0 + 4) {
+                g_assert_cmphex(value & ~0x003fffff, ==, 0);
+            }
+            break;
+        default:
+            value = random_value(offset);
+            writel(RPI_GPIO_BASE + offset, value);
+            m.writes++;
+            model_write(&m, offset, value);
+            break;
+        }
+        check_state(&m, old_out);
+    }
+    rate = ops * 1e6 / (g_get_monotonic_time() - start);
+
+    host_stop = true;
+    g_thread_join(thread);
+
+    g_test_message("%ld steps, %.0f steps/s", ops, rate);
+    env = getenv("RPI_GPIO_FUZZ_MIN_RATE");
+    if (env) {
+        g_assert_cmpfloat(rate, >=, atof(env));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    shm = rpi_gpio_shm_qtest_start("-machine versatilepb -display none");
+    qtest_add_func("/rpi_gpio/fuzz", test_fuzz);
+    ret = g_test_run();
+
+    qtest_end();
+    shmdt(shm);
+    return ret;
+}
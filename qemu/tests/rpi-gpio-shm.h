@@ -0,0 +1,53 @@
+/*
+ * Shared memory fixture for the rpi_gpio qtests
+ *
+ * The device publishes to a SysV segment that host programs (and any
+ * emulator running on the host) share by key.  A test starts QEMU on a
+ * segment of its own, so it neither disturbs them nor sees their inputs.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef TESTS_RPI_GPIO_SHM_H
+#define TESTS_RPI_GPIO_SHM_H
+
+#include "libqtest.h"
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#define RPI_GPIO_SHM_SIZE   0x1000
+
+/* Create a segment on the first free id from 0xe0, start QEMU with args
+ * and rpi_gpio attached to it, and return it mapped.  It is marked for
+ * removal as soon as both are attached, so it goes away with the last of
+ * them however the test ends.  Detach with shmdt after qtest_end.
+ */
+static inline void *rpi_gpio_shm_qtest_start(const char *args)
+{
+    int id, shmid = -1;
+    char *cmd;
+    void *shm;
+
+    for (id = 0xe0; id <= 0xff && shmid == -1; id++) {
+        shmid = shmget(ftok("/proc/cpuinfo", id), RPI_GPIO_SHM_SIZE,
+                       0666 | IPC_CREAT | IPC_EXCL);
+    }
+    g_assert_cmpint(shmid, !=, -1);
+    shm = shmat(shmid, NULL, 0);
+    if (shm == (void *)-1) {
+        shmctl(shmid, IPC_RMID, NULL);
+        g_assert_not_reached();
+    }
+
+    /* The device attaches to it as it is big enough */
+    cmd = g_strdup_printf("%s -global rpi_gpio.shm-id=0x%x", args, id - 1);
+    qtest_start(cmd);
+    g_free(cmd);
+
+    shmctl(shmid, IPC_RMID, NULL);
+    return shm;
+}
+
+#endif
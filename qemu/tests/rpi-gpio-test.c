@@ -0,0 +1,69 @@
+/*
+ * QTest testcases for the rpi_gpio device
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "rpi-gpio-shm.h"
+
+#include <glib.h>
+
+#define RPI_GPIO_BASE   0x20200000
+#define GPEDS0          0x40
+#define GPREN0          0x4c
+#define SIC_RAWSTAT     0x10003004
+#define RPI_GPIO_SIC_IRQ 10
+
+/* The head of shared_gpio_state in hw/gpio/rpi_gpio.c */
+typedef struct SharedGpio {
+    uint32_t GPFSEL[6];
+    uint32_t GPLEV[2];
+} SharedGpio;
+
+static SharedGpio *shm;
+
+/* A snapshot is restored through a reset, which stops the timer that
+ * samples host inputs.  A rising edge after the restore must still raise
+ * the interrupt, without an MMIO access to the device to sample it.
+ */
+static void test_snapshot_edge(void)
+{
+    char *path = g_strdup_printf("/tmp/rpi-gpio-test-%d.ram", getpid());
+    QDict *response;
+
+    writel(RPI_GPIO_BASE + GPREN0, 1 << 4);
+    response = qmp("{ 'execute': 'cow-snapshot-take',"
+                   "  'arguments': { 'filename': %s } }", path);
+    g_assert(qdict_haskey(response, "return"));
+    QDECREF(response);
+
+    response = qmp("{ 'execute': 'cow-snapshot-restore' }");
+    g_assert(qdict_haskey(response, "return"));
+    QDECREF(response);
+
+    __atomic_or_fetch(&shm->GPLEV[0], 1 << 4, __ATOMIC_RELEASE);
+    clock_step(1000 * 1000);
+    g_assert_cmphex(readl(SIC_RAWSTAT) & (1 << RPI_GPIO_SIC_IRQ), !=, 0);
+    g_assert_cmphex(readl(RPI_GPIO_BASE + GPEDS0), ==, 1 << 4);
+
+    unlink(path);
+    g_free(path);
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    shm = rpi_gpio_shm_qtest_start("-machine versatilepb -m 32 -display none");
+    qtest_add_func("/rpi_gpio/snapshot-edge", test_snapshot_edge);
+    ret = g_test_run();
+
+    qtest_end();
+    shmdt(shm);
+    return ret;
+}
@@ -1158,6 +1158,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         phys_page2 = get_page_addr_code(env, virt_page2);
     }
     tb_link_page(tb, phys_pc, phys_page2);
+    tcg_ctx.tb_ctx.tb_gen_count++;
     return tb;
 }
 
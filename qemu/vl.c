@@ -2835,13 +2835,13 @@ static int machine_set_property(void *opaque,
 /*
  * Initial object creation happens before all other
  * QEMU data types are created. The majority of objects
- * can be created at this point. The rng-egd object
- * cannot be created here, as it depends on the chardev
- * already existing.
+ * can be created at this point. The rng-egd and metrics
+ * objects cannot be created here, as they depend on the
+ * chardev already existing.
  */
 static bool object_create_initial(const char *type)
 {
-    if (g_str_equal(type, "rng-egd")) {
+    if (g_str_equal(type, "rng-egd") || g_str_equal(type, "metrics")) {
         return false;
     }
 
@@ -1,58 +1,42 @@
-#include <sys/shm.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include "../gpio_common/gpio_board_map.h"
 
-typedef struct shared_gpio_state {
+// Usage: detect_gpio_output_changes [board_rev]
+//   Prints every wiringPi pin on the given board revision (default 1)
+//   whenever a function select or output changes.
 
-  unsigned int GPFSEL0;
-  unsigned int GPFSEL1;
-  unsigned int GPFSEL2;
-  unsigned int GPFSEL3;
-  unsigned int GPFSEL4;
-  unsigned int GPFSEL5;
-  unsigned int GPLEV0;
-  unsigned int GPLEV1;
-  unsigned int outstate0;
-  unsigned int outstate1;
+static char *functions[] = {"In","Out","Alt5","Alt4","Alt0","Alt1","Alt2","Alt3"};
 
-} shared_gpio_state;
+void print_state(shared_gpio_state *state, int board_rev);
 
-static char *functions[] = {"In","Out","Alt1","Alt2","Alt3","Alt4","Alt5"};
+int main(int argc, char *argv[]){
 
-void print_state(shared_gpio_state *state);
-void copy_state(shared_gpio_state* from, shared_gpio_state* to);
-
-void main(void){
-
-  key_t key;
-  int shmid=-1;
   int init=1;
+  int board_rev=1;
   shared_gpio_state *state;
-  shared_gpio_state *last_state;
+  shared_gpio_state last_state;
 
-  last_state = (shared_gpio_state *)malloc(sizeof(shared_gpio_state));
+  if (argc > 1) board_rev = atoi(argv[1]);
 
-  key = ftok("/proc/cpuinfo",0x84);
-  shmid = shmget(key, sizeof(shared_gpio_state), 0666);
-  state = shmat(shmid, (void *)0, 0);
+  state = shared_gpio_state_attach();
+  if (state == NULL){
+    fprintf(stderr, "Unable to attach to the GPIO shared memory: %s\n", strerror(errno));
+    return 1;
+  }
 
   while (1){
 
-    if (init==1 || (init==0 &&
-      ((state->GPFSEL0 != last_state->GPFSEL0) ||
-      (state->GPFSEL1 != last_state->GPFSEL1) ||
-      (state->GPFSEL2 != last_state->GPFSEL2) ||
-      (state->GPFSEL3 != last_state->GPFSEL3) ||
-      (state->GPFSEL4 != last_state->GPFSEL4) ||
-      (state->GPFSEL5 != last_state->GPFSEL5) ||
-      (state->outstate0 != last_state->outstate0) ||
-      (state->outstate1 != last_state->outstate1)))
+    if (init==1 ||
+      (memcmp(state->GPFSEL, last_state.GPFSEL, sizeof(state->GPFSEL)) != 0) ||
+      (memcmp(state->OUTSTATE, last_state.OUTSTATE, sizeof(state->OUTSTATE)) != 0)
     ){
-        print_state(state);
+        print_state(state, board_rev);
     }
-    copy_state(state,last_state);
+    memcpy(&last_state, state, sizeof(shared_gpio_state));
     init=0;
 
     sleep(1);
@@ -60,33 +44,18 @@ void main(void){
 
 }
 
-void print_state(shared_gpio_state *state){
-
-  printf("\tFunc\tLVL\tOutput\n");
-  printf("GPIO0\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL1 >> 21) & 0x7)],(state->GPLEV0 &   0x20000 ? 1 : 0),(state->outstate0 &   0x20000 ? 1 : 0));  // GPIO0 <=> BCM2385 GPIO17
-  printf("GPIO1\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL1 >> 24) & 0x7)],(state->GPLEV0 &   0x40000 ? 1 : 0),(state->outstate0 &   0x40000 ? 1 : 0));  // GPIO1 <=> BCM2385 GPIO18
-  printf("GPIO2\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL2 >>  3) & 0x7)],(state->GPLEV0 &  0x200000 ? 1 : 0),(state->outstate0 &  0x200000 ? 1 : 0));  // GPIO2 <=> BCM2385 GPIO21
-  printf("GPIO3\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL2 >>  6) & 0x7)],(state->GPLEV0 &  0x400000 ? 1 : 0),(state->outstate0 &  0x400000 ? 1 : 0));  // GPIO3 <=> BCM2385 GPIO22
-  printf("GPIO4\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL2 >>  9) & 0x7)],(state->GPLEV0 &  0x800000 ? 1 : 0),(state->outstate0 &  0x800000 ? 1 : 0));  // GPIO4 <=> BCM2385 GPIO23
-  printf("GPIO5\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL2 >> 12) & 0x7)],(state->GPLEV0 & 0x1000000 ? 1 : 0),(state->outstate0 & 0x1000000 ? 1 : 0));  // GPIO5 <=> BCM2385 GPIO24
-  printf("GPIO6\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL2 >> 15) & 0x7)],(state->GPLEV0 & 0x2000000 ? 1 : 0),(state->outstate0 & 0x2000000 ? 1 : 0));  // GPIO6 <=> BCM2385 GPIO25
-  printf("GPIO7\t%s\t%i\t%i\n",functions[(int)((state->GPFSEL0 >> 12) & 0x7)],(state->GPLEV0 &      0x10 ? 1 : 0),(state->outstate0 &      0x10 ? 1 : 0));  // GPIO7 <=> BCM2385 GPIO4
-  printf("\n");
-
-}
-
-void copy_state(shared_gpio_state* from, shared_gpio_state* to){
+void print_state(shared_gpio_state *state, int board_rev){
 
-  to->GPFSEL0=from->GPFSEL0;
-  to->GPFSEL1=from->GPFSEL1;
-  to->GPFSEL2=from->GPFSEL2;
-  to->GPFSEL3=from->GPFSEL3;
-  to->GPFSEL4=from->GPFSEL4;
-  to->GPFSEL5=from->GPFSEL5;
-  to->GPLEV0=from->GPLEV0;
-  to->GPLEV1=from->GPLEV1;
-  to->outstate0=from->outstate0;
-  to->outstate1=from->outstate1;
+  int pin, bcm;
+  const gpio_pin_info *p;
 
+  printf("\tBCM\tFunc\tLVL\tOutput\n");
+  for (pin=0; pin<GPIO_NUM_MAP_PINS; pin++){
+    if ((bcm = gpio_board_map_to_bcm(GPIO_NUMBERING_WIRINGPI, board_rev, pin)) < 0) continue;
+    p = &gpio_pin_info_table[bcm];
+    printf("GPIO%i\t%i\t%s\t%i\t%i\n", pin, bcm, functions[gpio_pin_function(state, p)],
+      gpio_pin_level(state, p), gpio_pin_output(state, p));
+  }
+  printf("\n");
 
 }
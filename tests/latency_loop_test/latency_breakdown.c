@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+// Usage: latency_breakdown [-t threshold_us] [-n outliers] events_file trace_file
+//
+//   Splits each round trip timed by latency_test -e events_file into the
+//   stages it went through, using QEMU's rpi_gpio trace events (log trace
+//   backend) in trace_file:
+//
+//     inject_to_sample   latency_test raised the input .. the device first
+//                        sampled it (rpi_gpio_input_change).  Time in which
+//                        the guest did not touch the GPIO block: it was
+//                        scheduled out, or the vCPU was not running at all
+//     sample_to_read     .. the guest read GPLEVx and saw it
+//                        (rpi_gpio_lev_read).  Usually 0, as it is the read
+//                        that samples
+//     read_to_write      .. the guest raised the output through GPSETx
+//                        (rpi_gpio_set_write).  The guest's own reaction
+//     write_to_observe   .. latency_test saw OUTSTATEx change: publishing
+//                        and host polling
+//
+//   For sample_to_read and read_to_write the virtual clock time is given
+//   too.  Where host time is much larger than virtual time the emulator
+//   spent it (translating, waiting for the global mutex, preempted by the
+//   host); where they are about equal the guest did.  That only holds with
+//   -icount: without it the virtual clock follows the host's while the
+//   vCPU runs.
+//
+//   The per stage percentiles and the trials slower than threshold_us
+//   (default 300), slowest first and at most outliers (default 20) of them,
+//   are printed as one JSON object in ns.  Record the trace with e.g.
+//
+//     qemu-system-arm ... -trace events=rpi_gpio.events -D trace.log
+//
+//   where rpi_gpio.events lists rpi_gpio_input_change, rpi_gpio_lev_read
+//   and rpi_gpio_set_write; run_benchmark does this with EMU_TRACE=1.
+
+enum { CHANGE, LEV_READ, SET_WRITE };
+
+enum { INJECT_TO_SAMPLE, SAMPLE_TO_READ, READ_TO_WRITE, WRITE_TO_OBSERVE, TOTAL,
+       SAMPLE_TO_READ_VIRTUAL, READ_TO_WRITE_VIRTUAL, STAGES };
+
+static const char *stage_names[STAGES] = {
+  "inject_to_sample", "sample_to_read", "read_to_write", "write_to_observe", "total",
+  "sample_to_read_virtual", "read_to_write_virtual"
+};
+
+typedef struct event {
+  int type;
+  uint32_t lev[2];              // GPLEVx for CHANGE, the register value in lev[bank] otherwise
+  int bank;
+  int64_t host, virt;
+} event;
+
+typedef struct trial {
+  int64_t ns[STAGES];
+} trial;
+
+static event *events;
+static int nevents;
+
+static int load_trace(const char *path){
+
+  FILE *f = fopen(path, "r");
+  char line[512], *p;
+  event e;
+  long long host, virt;
+  int cap = 0;
+
+  if (f == NULL) return -1;
+  while (fgets(line, sizeof(line), f)){
+    memset(&e, 0, sizeof(e));
+    if ((p = strstr(line, "rpi_gpio_input_change ")) &&
+        sscanf(p, "rpi_gpio_input_change GPLEV0 0x%x GPLEV1 0x%x at host %lld virtual %lld",
+               &e.lev[0], &e.lev[1], &host, &virt) == 4){
+      e.type = CHANGE;
+    }
+    else if ((p = strstr(line, "rpi_gpio_lev_read ")) &&
+             sscanf(p, "rpi_gpio_lev_read GPLEV%d 0x%x at host %lld virtual %lld",
+                    &e.bank, &e.lev[0], &host, &virt) == 4){
+      e.type = LEV_READ;
+    }
+    else if ((p = strstr(line, "rpi_gpio_set_write ")) &&
+             sscanf(p, "rpi_gpio_set_write GPSET%d 0x%x at host %lld virtual %lld",
+                    &e.bank, &e.lev[0], &host, &virt) == 4){
+      e.type = SET_WRITE;
+    }
+    else continue;
+    if (e.bank < 0 || e.bank > 1) continue;
+    if (e.type != CHANGE){
+      e.lev[e.bank] = e.lev[0];
+      if (e.bank) e.lev[0] = 0;
+    }
+    e.host = host;
+    e.virt = virt;
+
+    if (nevents == cap){
+      cap = cap ? cap * 2 : 4096;
+      if ((events = realloc(events, cap * sizeof(*events))) == NULL){
+        errno = ENOMEM;
+        fclose(f);
+        return -1;
+      }
+    }
+    events[nevents++] = e;
+  }
+  fclose(f);
+  return 0;
+}
+
+// First event of type from index i on, no later than end, with pin set
+static int find(int i, int type, int pin, int64_t end){
+
+  for (; i < nevents && events[i].host <= end; i++){
+    if (events[i].type == type && ((events[i].lev[pin / 32] >> (pin % 32)) & 1)) return i;
+  }
+  return -1;
+}
+
+static int compare_ns(const void *a, const void *b){
+
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static int compare_total(const void *a, const void *b){
+
+  int64_t x = ((const trial *)a)->ns[TOTAL], y = ((const trial *)b)->ns[TOTAL];
+
+  return (y > x) - (y < x);
+}
+
+// Nearest rank percentile of sorted samples
+static int64_t percentile(const int64_t *sorted, int n, double p){
+
+  int rank = (int)(p / 100.0 * n + 0.999999);
+
+  if (rank < 1) rank = 1;
+  if (rank > n) rank = n;
+  return sorted[rank - 1];
+}
+
+int main(int argc, char *argv[]){
+
+  FILE *f;
+  trial *trials = NULL, t;
+  int64_t *ns, sum, inject, observe, since = 0;
+  long long a, b;
+  int in, out, opt, n = 0, cap = 0, unmatched = 0, worst = 20, slowest, i, j, s, r, w, next = 0;
+  double threshold_us = 300;
+
+  while ((opt = getopt(argc, argv, "t:n:")) != -1){
+    switch (opt){
+      case 't': threshold_us = atof(optarg); break;
+      case 'n': worst = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-t threshold_us] [-n outliers] events_file trace_file\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind + 2 != argc){
+    fprintf(stderr, "Usage: %s [-t threshold_us] [-n outliers] events_file trace_file\n", argv[0]);
+    return 1;
+  }
+
+  if (load_trace(argv[optind + 1]) < 0){
+    fprintf(stderr, "Unable to read %s: %s\n", argv[optind + 1], strerror(errno));
+    return 1;
+  }
+  if ((f = fopen(argv[optind], "r")) == NULL){
+    fprintf(stderr, "Unable to read %s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+
+  while (fscanf(f, "%d %d %lld %lld", &in, &out, &a, &b) == 4){
+    inject = a;
+    observe = b;
+    if (in < 0 || in > 53 || out < 0 || out > 53) continue;
+
+    // Only look after the last trial: in between the input went low, so
+    // the first sample with it high belongs to this one even if QEMU took
+    // it a little before latency_test read the clock for inject
+    while (next < nevents && events[next].host <= since) next++;
+    since = observe;
+    if ((s = find(next, CHANGE, in, observe)) < 0 ||
+        (r = find(s, LEV_READ, in, observe)) < 0 ||
+        (w = find(r, SET_WRITE, out, observe)) < 0){
+      unmatched++;
+      continue;
+    }
+
+    t.ns[INJECT_TO_SAMPLE] = events[s].host > inject ? events[s].host - inject : 0;
+    t.ns[SAMPLE_TO_READ] = events[r].host - events[s].host;
+    t.ns[READ_TO_WRITE] = events[w].host - events[r].host;
+    t.ns[WRITE_TO_OBSERVE] = observe - events[w].host;
+    t.ns[TOTAL] = observe - inject;
+    t.ns[SAMPLE_TO_READ_VIRTUAL] = events[r].virt - events[s].virt;
+    t.ns[READ_TO_WRITE_VIRTUAL] = events[w].virt - events[r].virt;
+
+    if (n == cap){
+      cap = cap ? cap * 2 : 1024;
+      if ((trials = realloc(trials, cap * sizeof(*trials))) == NULL){
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+      }
+    }
+    trials[n++] = t;
+  }
+  fclose(f);
+
+  if (n == 0){
+    printf("{\"trials\": 0, \"unmatched\": %d, \"trace_events\": %d}\n", unmatched, nevents);
+    return 1;
+  }
+  if ((ns = malloc(n * sizeof(*ns))) == NULL){
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  printf("{\"unit\": \"ns\", \"trials\": %d, \"unmatched\": %d,\n \"stages\": {", n, unmatched);
+  for (j = 0; j < STAGES; j++){
+    for (i = 0, sum = 0; i < n; i++){
+      ns[i] = trials[i].ns[j];
+      sum += ns[i];
+    }
+    qsort(ns, n, sizeof(*ns), compare_ns);
+    printf("%s\n  \"%s\": {\"mean\": %lld, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"max\": %lld}",
+      j ? "," : "", stage_names[j], (long long)(sum / n),
+      (long long)percentile(ns, n, 50), (long long)percentile(ns, n, 90),
+      (long long)percentile(ns, n, 99), (long long)ns[n - 1]);
+  }
+  printf("},\n");
+
+  // The outliers, each with the stage that took longest
+  qsort(trials, n, sizeof(*trials), compare_total);
+  printf(" \"threshold\": %lld, \"outliers\": [", (long long)(threshold_us * 1000));
+  for (i = 0; i < n && i < worst && trials[i].ns[TOTAL] > threshold_us * 1000; i++){
+    for (j = 1, slowest = 0; j < TOTAL; j++){
+      if (trials[i].ns[j] > trials[i].ns[slowest]) slowest = j;
+    }
+    printf("%s\n  {", i ? "," : "");
+    for (j = 0; j < STAGES; j++) printf("\"%s\": %lld, ", stage_names[j], (long long)trials[i].ns[j]);
+    printf("\"slowest\": \"%s\"}", stage_names[slowest]);
+  }
+  printf("]}\n");
+
+  free(ns);
+  free(trials);
+  free(events);
+  return 0;
+}
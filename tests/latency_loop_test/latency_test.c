@@ -1,65 +1,196 @@
-#include <sys/shm.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <time.h>
+#include "../../gpio_common/shared_gpio_state.h"
+
+// Usage: latency_test [-n trials] [-w warmup] [-i in_bcm] [-o out_bcm]
+//                     [-t timeout_ms] [-g gap_us] [-r raw_file]
+//                     [-e events_file]
+//
+//   Measures the input -> output round trip through a guest that copies
+//   one pin to another (to_run_under_qemu/button_detect_0only.c copies
+//   wiringPi 4 to wiringPi 0, BCM 23 to BCM 17 on a rev 1 board, which are
+//   the defaults).  Each trial drops the input, waits for the output to
+//   follow, then raises the input and times how long the output takes to
+//   rise on CLOCK_MONOTONIC_RAW.
+//
+//   The summary is printed as one JSON object on stdout.  Latencies are in
+//   ns and the histogram has power of two buckets: "le" is the bucket's
+//   upper bound.  Trials where the output doesn't follow within the
+//   timeout are counted as lost rather than timed.  -r writes every sample,
+//   one per line, for plot.gnuplot.
+//
+//   -e writes "in_bcm out_bcm inject_ns observe_ns" for every timed trial,
+//   on CLOCK_MONOTONIC like QEMU's trace stamps, for latency_breakdown.
+
+#define HIST_BUCKETS 40
+
+static int64_t now_ns(void){
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
-#define NUM_TRIALS 1000
+// Spin until the output pin reaches level, returns 0 on timeout
+static int wait_output(volatile shared_gpio_state *state, int out, int level, int64_t deadline){
 
-typedef struct shared_gpio_state {
+  while (((state->OUTSTATE[out / 32] >> (out % 32)) & 1) != level){
+    if (now_ns() > deadline) return 0;
+  }
+  return 1;
+}
 
-  unsigned int GPFSEL0;
-  unsigned int GPFSEL1;
-  unsigned int GPFSEL2;
-  unsigned int GPFSEL3;
-  unsigned int GPFSEL4;
-  unsigned int GPFSEL5;
-  unsigned int GPLEV0;
-  unsigned int GPLEV1;
-  unsigned int outstate0;
-  unsigned int outstate1;
+static int64_t mono_ns(void){
 
-} shared_gpio_state;
+  struct timespec ts;
 
-void main(void){
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
-  shared_gpio_state *state;
-  struct timespec start, end;
-  int i;
-  int times[NUM_TRIALS];
-  double totaltime;
+// The change is stamped for rpi_gpio's input-latency statistic; returns
+// the stamp
+static int64_t set_input(volatile shared_gpio_state *state, int in, int level){
 
-  key_t key = ftok("/proc/cpuinfo",0x84);
-  int shmid = shmget(key, sizeof(shared_gpio_state), 0666);
-  state = shmat(shmid, (void *)0, 0);
+  if (level) state->GPLEV[in / 32] |= 1u << (in % 32);
+  else state->GPLEV[in / 32] &= ~(1u << (in % 32));
+  return state->INPUT_NS = mono_ns();
+}
 
-  for (i=0; i<NUM_TRIALS; i++){
+static int compare_ns(const void *a, const void *b){
 
-    state->GPLEV0 &= ~(1 << 23); //Clear GPIO 4 input
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
 
-    usleep(10);
+  return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of sorted samples
+static int64_t percentile(const int64_t *sorted, int n, double p){
 
-    state->GPLEV0 |= (1 << 23); //Set GPIO 4 input
+  int rank = (int)(p / 100.0 * n + 0.999999);
+
+  if (rank < 1) rank = 1;
+  if (rank > n) rank = n;
+  return sorted[rank - 1];
+}
 
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start); // get initial time-stamp
+int main(int argc, char *argv[]){
+
+  volatile shared_gpio_state *state = NULL;
+  int trials = 1000, warmup = 20, in = 23, out = 17, gap_us = 100;
+  int64_t timeout_ns = 1000 * 1000000LL;
+  const char *raw_file = NULL, *events_file = NULL;
+  int64_t *times, start, end, sum = 0, inject;
+  int64_t hist[HIST_BUCKETS] = {0};
+  int i, n = 0, lost = 0, opt, b, first = 1;
+  FILE *raw, *events = NULL;
+
+  while ((opt = getopt(argc, argv, "n:w:i:o:t:g:r:e:")) != -1){
+    switch (opt){
+      case 'n': trials = atoi(optarg); break;
+      case 'w': warmup = atoi(optarg); break;
+      case 'i': in = atoi(optarg); break;
+      case 'o': out = atoi(optarg); break;
+      case 't': timeout_ns = atoll(optarg) * 1000000LL; break;
+      case 'g': gap_us = atoi(optarg); break;
+      case 'r': raw_file = optarg; break;
+      case 'e': events_file = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-n trials] [-w warmup] [-i in_bcm] [-o out_bcm] [-t timeout_ms] [-g gap_us] [-r raw_file] [-e events_file]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (trials < 1 || in < 0 || in > 53 || out < 0 || out > 53){
+    fprintf(stderr, "%s: bad trial count or pin\n", argv[0]);
+    return 1;
+  }
 
-    while((state->outstate0 & (1 << 17)) == 0){}  //Wait for GPIO 0 output
+  // QEMU may still be restoring the snapshot when we're started
+  for (i = 0; i < 100 && state == NULL; i++){
+    if ((state = shared_gpio_state_attach()) == NULL) usleep(50000);
+  }
+  if (state == NULL){
+    fprintf(stderr, "Unable to attach to the GPIO shared memory: %s\n", strerror(errno));
+    return 1;
+  }
 
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);   // get final time-stamp
+  times = malloc(trials * sizeof(*times));
+  if (times == NULL){
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  if (events_file != NULL && (events = fopen(events_file, "w")) == NULL){
+    fprintf(stderr, "Unable to open %s: %s\n", events_file, strerror(errno));
+    return 1;
+  }
 
-    double t_ns = (double)(end.tv_sec - start.tv_sec) * 1.0e9 +
-              (double)(end.tv_nsec - start.tv_nsec);
+  for (i = 0; i < warmup + trials; i++){
+
+    set_input(state, in, 0);
+    if (!wait_output(state, out, 0, now_ns() + timeout_ns)){
+      lost += (i >= warmup);
+      continue;
+    }
+    usleep(gap_us);
+
+    start = now_ns();
+    inject = set_input(state, in, 1);
+    if (!wait_output(state, out, 1, start + timeout_ns)){
+      lost += (i >= warmup);
+      continue;
+    }
+    end = now_ns();
+
+    if (i >= warmup){
+      times[n++] = end - start;
+      if (events) fprintf(events, "%d %d %lld %lld\n", in, out, (long long)inject, (long long)mono_ns());
+    }
+  }
+  set_input(state, in, 0);
+  if (events) fclose(events);
+
+  if (raw_file != NULL){
+    if ((raw = fopen(raw_file, "w")) == NULL){
+      fprintf(stderr, "Unable to open %s: %s\n", raw_file, strerror(errno));
+      return 1;
+    }
+    for (i = 0; i < n; i++) fprintf(raw, "%lld\n", (long long)times[i]);
+    fclose(raw);
+  }
 
-    times[i]=t_ns;
-    totaltime += t_ns;
+  if (n == 0){
+    printf("{\"trials\": %d, \"lost\": %d}\n", trials, lost);
+    return 1;
+  }
 
+  qsort(times, n, sizeof(*times), compare_ns);
+  for (i = 0; i < n; i++){
+    sum += times[i];
+    for (b = 0; b < HIST_BUCKETS - 1 && times[i] > (1LL << b); b++);
+    hist[b]++;
   }
 
-  for (i=0; i<NUM_TRIALS; i++){
-    printf("%i\n",times[i]);
+  printf("{\"clock\": \"CLOCK_MONOTONIC_RAW\", \"unit\": \"ns\", \"trials\": %d, \"lost\": %d,\n", trials, lost);
+  printf(" \"min\": %lld, \"mean\": %lld, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"p99_9\": %lld, \"max\": %lld,\n",
+    (long long)times[0], (long long)(sum / n),
+    (long long)percentile(times, n, 50), (long long)percentile(times, n, 90),
+    (long long)percentile(times, n, 99), (long long)percentile(times, n, 99.9),
+    (long long)times[n - 1]);
+
+  printf(" \"histogram\": [");
+  for (b = 0; b < HIST_BUCKETS; b++){
+    if (hist[b] == 0) continue;
+    printf("%s{\"le\": %lld, \"count\": %lld}", first ? "" : ", ", 1LL << b, (long long)hist[b]);
+    first = 0;
   }
-	
-  printf("%f\n",(totaltime/NUM_TRIALS));
+  printf("]}\n");
 
+  free(times);
+  return 0;
 }
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../gpio_common/shared_gpio_state.h"
+
+// Usage: shm_scale_bench [-r polling_readers] [-b blocking_readers]
+//                        [-w writers] [-d seconds] [-i idle_seconds]
+//
+//   How the shared GPIO segment holds up with several host programs on it
+//   at once.  Run to_run_under_qemu/frequency_test in the guest with a large
+//   toggle count first, so the device is busy publishing.  Then:
+//
+//   - the guest's output edge rate is measured for idle_seconds (default 1)
+//     with nothing else attached, as the baseline;
+//   - polling readers (default 1) take seqlock snapshots back to back and
+//     time each one;
+//   - blocking readers (default 0) sleep in shared_gpio_state_wait and time
+//     how long after QEMU published a change they hold a copy of it;
+//   - writers (default 0) each toggle their own input pin, BCM 32 up, in
+//     GPLEV as fast as they can;
+//
+//   all of them for seconds (default 5), while the edge rate is measured
+//   again.  One JSON object is printed on stdout; times are in ns on
+//   CLOCK_MONOTONIC, which is the clock QEMU stamps CHANGE_NS with.
+
+#define MAX_SAMPLES 100000
+
+typedef struct worker {
+  uint64_t ops;                 // Snapshots, wake ups or GPLEV writes
+  uint64_t retries;             // Snapshot retries because QEMU was publishing
+  uint64_t timeouts;            // Waits that saw no change
+  uint64_t failures;            // Snapshots given up on, SEQ stayed odd or kept changing
+  int n;
+  int64_t samples[MAX_SAMPLES];
+} worker;
+
+typedef struct results {
+  volatile int go, stop;
+  worker w[];
+} results;
+
+static int64_t now_ns(void){
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void record(worker *w, int64_t ns){
+
+  if (w->n < MAX_SAMPLES) w->samples[w->n++] = ns;
+}
+
+static void poll_reader(shared_gpio_state *state, results *res, worker *w){
+
+  shared_gpio_state copy;
+  int64_t start;
+  int retries;
+
+  while (!res->go);
+  while (!res->stop){
+    start = now_ns();
+    retries = shared_gpio_state_snapshot(state, &copy);
+    if (retries < 0){
+      w->failures++;
+      continue;
+    }
+    w->retries += retries;
+    record(w, now_ns() - start);
+    w->ops++;
+  }
+}
+
+static void blocking_reader(shared_gpio_state *state, results *res, worker *w){
+
+  shared_gpio_state copy;
+  uint32_t seq;
+
+  while (!res->go);
+  while (!res->stop){
+    if (shared_gpio_state_snapshot(state, &copy) < 0){
+      w->failures++;
+      continue;
+    }
+    seq = copy.SEQ;
+    if (shared_gpio_state_wait(state, seq, 100) == seq){
+      w->timeouts++;
+      continue;
+    }
+    w->ops++;
+
+    // From the change to holding a copy of it
+    if (shared_gpio_state_snapshot(state, &copy) < 0){
+      w->failures++;
+      continue;
+    }
+    record(w, now_ns() - copy.CHANGE_NS);
+  }
+}
+
+static void writer(shared_gpio_state *state, results *res, worker *w, int bit){
+
+  while (!res->go);
+  while (!res->stop){
+    __atomic_fetch_xor(&state->GPLEV[1], 1u << bit, __ATOMIC_RELAXED);
+    w->ops++;
+  }
+  __atomic_fetch_and(&state->GPLEV[1], ~(1u << bit), __ATOMIC_RELAXED);
+}
+
+static int compare_ns(const void *a, const void *b){
+
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of sorted samples
+static int64_t percentile(const int64_t *sorted, int n, double p){
+
+  int rank = (int)(p / 100.0 * n + 0.999999);
+
+  if (rank < 1) rank = 1;
+  if (rank > n) rank = n;
+  return sorted[rank - 1];
+}
+
+// Pool the samples of workers first..first + count - 1 and print their
+// percentiles as "name": {...}
+static void print_latency(const char *name, results *res, int first, int count){
+
+  int64_t *all;
+  int i, j, n = 0;
+
+  for (i = first; i < first + count; i++) n += res->w[i].n;
+  printf(" \"%s\": ", name);
+  if (n == 0 || (all = malloc(n * sizeof(*all))) == NULL){
+    printf("null,\n");
+    return;
+  }
+  for (i = first, n = 0; i < first + count; i++){
+    for (j = 0; j < res->w[i].n; j++) all[n++] = res->w[i].samples[j];
+  }
+  qsort(all, n, sizeof(*all), compare_ns);
+  printf("{\"samples\": %d, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"max\": %lld},\n", n,
+    (long long)percentile(all, n, 50), (long long)percentile(all, n, 90),
+    (long long)percentile(all, n, 99), (long long)all[n - 1]);
+  free(all);
+}
+
+static uint64_t total(results *res, int first, int count, size_t offset){
+
+  uint64_t sum = 0;
+  int i;
+
+  for (i = first; i < first + count; i++) sum += *(uint64_t *)((char *)&res->w[i] + offset);
+  return sum;
+}
+
+int main(int argc, char *argv[]){
+
+  shared_gpio_state *state;
+  results *res;
+  int pollers = 1, blockers = 0, writers = 0, opt, i, nworkers;
+  double seconds = 5, idle = 1, loaded;
+  uint64_t edges0, idle_edges, loaded_edges;
+  int64_t start;
+  pid_t *pids;
+
+  while ((opt = getopt(argc, argv, "r:b:w:d:i:")) != -1){
+    switch (opt){
+      case 'r': pollers = atoi(optarg); break;
+      case 'b': blockers = atoi(optarg); break;
+      case 'w': writers = atoi(optarg); break;
+      case 'd': seconds = atof(optarg); break;
+      case 'i': idle = atof(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-r polling_readers] [-b blocking_readers] [-w writers] [-d seconds] [-i idle_seconds]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (pollers < 0 || blockers < 0 || writers < 0 || writers > 22 || seconds <= 0 || idle <= 0){
+    fprintf(stderr, "%s: bad worker count or duration (at most 22 writers)\n", argv[0]);
+    return 1;
+  }
+  nworkers = pollers + blockers + writers;
+
+  state = shared_gpio_state_attach();
+  if (state == NULL){
+    fprintf(stderr, "Unable to attach to the GPIO shared memory: %s\n", strerror(errno));
+    return 1;
+  }
+
+  res = mmap(NULL, sizeof(*res) + nworkers * sizeof(worker), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  pids = calloc(nworkers + 1, sizeof(*pids));
+  if (res == MAP_FAILED || pids == NULL){
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  // Baseline with nothing but us attached
+  edges0 = state->OUTPUT_EDGES;
+  start = now_ns();
+  usleep(idle * 1e6);
+  idle_edges = state->OUTPUT_EDGES - edges0;
+  idle = (now_ns() - start) / 1e9;
+
+  for (i = 0; i < nworkers; i++){
+    if ((pids[i] = fork()) == -1){
+      fprintf(stderr, "fork: %s\n", strerror(errno));
+      res->stop = res->go = 1;
+      break;
+    }
+    if (pids[i] == 0){
+      if (i < pollers) poll_reader(state, res, &res->w[i]);
+      else if (i < pollers + blockers) blocking_reader(state, res, &res->w[i]);
+      else writer(state, res, &res->w[i], i - pollers - blockers);
+      _exit(0);
+    }
+  }
+
+  edges0 = state->OUTPUT_EDGES;
+  start = now_ns();
+  res->go = 1;
+  usleep(seconds * 1e6);
+  loaded_edges = state->OUTPUT_EDGES - edges0;
+  loaded = (now_ns() - start) / 1e9;
+  res->stop = 1;
+
+  for (i = 0; i < nworkers && pids[i] > 0; i++) waitpid(pids[i], NULL, 0);
+
+  printf("{\"clock\": \"CLOCK_MONOTONIC\", \"unit\": \"ns\", \"seconds\": %.3f,\n", loaded);
+  printf(" \"polling_readers\": %d, \"blocking_readers\": %d, \"writers\": %d,\n", pollers, blockers, writers);
+  print_latency("snapshot", res, 0, pollers);
+  printf(" \"snapshots_per_s\": %.0f, \"snapshot_retries\": %llu, \"snapshot_failures\": %llu,\n",
+    total(res, 0, pollers, offsetof(worker, ops)) / loaded,
+    (unsigned long long)total(res, 0, pollers, offsetof(worker, retries)),
+    (unsigned long long)total(res, 0, pollers + blockers, offsetof(worker, failures)));
+  print_latency("wake", res, pollers, blockers);
+  printf(" \"wakeups_per_s\": %.0f, \"wait_timeouts\": %llu,\n",
+    total(res, pollers, blockers, offsetof(worker, ops)) / loaded,
+    (unsigned long long)total(res, pollers, blockers, offsetof(worker, timeouts)));
+  printf(" \"writes_per_s\": %.0f,\n", total(res, pollers + blockers, writers, offsetof(worker, ops)) / loaded);
+  printf(" \"idle_output_edges_per_s\": %.0f, \"loaded_output_edges_per_s\": %.0f}\n",
+    idle_edges / idle, loaded_edges / loaded);
+
+  return 0;
+}
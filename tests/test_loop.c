@@ -2,18 +2,32 @@
 #include <stdio.h>
 #include "../pkg/wiringEmuPi/wiringPi/wiringPi.h"
 
+// Mirror wiringPi pins 4-7 onto 0-3 with one bank read and at most two
+//	bank writes per pass, rather than eight separate register accesses.
+
 int main (void){
 
 	wiringPiSetup();
 	int i;
+	unsigned int lev, set, clr;
+	unsigned int inBit[4], outBit[4];
 
 	for (i=0; i<4; i++) pinMode(i,OUTPUT);
 	for (i=4; i<8; i++) pinMode(i,INPUT);
+	for (i=0; i<4; i++){
+		outBit[i] = 1u << wpiPinToGpio(i);
+		inBit[i]  = 1u << wpiPinToGpio(i+4);
+	}
 
 	while(1){
-		for (i=4; i<8; i++){
-			digitalWrite(i-4,digitalRead(i));
-		}		
+		lev = digitalReadBank(0);
+		set = clr = 0;
+		for (i=0; i<4; i++){
+			if (lev & inBit[i])
+				set |= outBit[i];
+			else
+				clr |= outBit[i];
+		}
+		digitalWriteMask(0, set, clr);
 	}
 }
-
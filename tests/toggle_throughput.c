@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "../gpio_common/shared_gpio_state.h"
+
+// Usage: toggle_throughput [-p out_bcm] [-d max_seconds] [-q quiet_ms]
+//                          [-w wait_seconds]
+//
+//   Host half of the toggle throughput benchmark.  Start it, then run
+//   to_run_under_qemu/frequency_test in the guest.  It waits up to
+//   wait_seconds (default 120) for the guest to start writing the GPIO
+//   registers, measures until the writes stop for quiet_ms (default 200) or
+//   max_seconds (default 60) pass, and prints one JSON object: what rpi_gpio
+//   counted (register writes, reads, and so MMIO exits, and edges on output
+//   pins) and the edges this program saw on out_bcm (default 17, wiringPi 0
+//   on a rev 1 board) by polling the shared memory, as totals and per host
+//   second.  Host seen edges fall short of the device's when the guest toggles
+//   faster than the segment is polled.
+
+static double now_s(void){
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]){
+
+  volatile shared_gpio_state *state;
+  int pin = 17, opt;
+  double max_s = 60, quiet_s = 0.2, wait_s = 120, start, end, last_write, t;
+  uint64_t writes0, reads0, edges0, writes, host_edges = 0;
+  uint32_t level, seen, polls = 0;
+
+  while ((opt = getopt(argc, argv, "p:d:q:w:")) != -1){
+    switch (opt){
+      case 'p': pin = atoi(optarg); break;
+      case 'd': max_s = atof(optarg); break;
+      case 'q': quiet_s = atoi(optarg) / 1000.0; break;
+      case 'w': wait_s = atof(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-p out_bcm] [-d max_seconds] [-q quiet_ms] [-w wait_seconds]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (pin < 0 || pin > 53){
+    fprintf(stderr, "%s: bad pin %d\n", argv[0], pin);
+    return 1;
+  }
+
+  state = shared_gpio_state_attach();
+  if (state == NULL){
+    fprintf(stderr, "Unable to attach to the GPIO shared memory: %s\n", strerror(errno));
+    return 1;
+  }
+
+  // Wait for the workload to start
+  writes0 = state->MMIO_WRITES;
+  t = now_s();
+  while (state->MMIO_WRITES == writes0){
+    if (now_s() - t >= wait_s){
+      fprintf(stderr, "%s: no GPIO register writes from the guest in %.0f s\n", argv[0], wait_s);
+      return 1;
+    }
+    usleep(1000);
+  }
+
+  writes0 = writes = state->MMIO_WRITES;
+  reads0 = state->MMIO_READS;
+  edges0 = state->OUTPUT_EDGES;
+  seen = (state->OUTSTATE[pin / 32] >> (pin % 32)) & 1;
+  start = last_write = now_s();
+
+  for (;;){
+    level = (state->OUTSTATE[pin / 32] >> (pin % 32)) & 1;
+    if (level != seen){
+      seen = level;
+      host_edges++;
+    }
+
+    // The clock is only read every so often so polling stays fast
+    if ((++polls & 0x3ff) == 0){
+      t = now_s();
+      if (state->MMIO_WRITES != writes){
+        writes = state->MMIO_WRITES;
+        last_write = t;
+      }
+      else if (t - last_write >= quiet_s) break;
+      if (t - start >= max_s) break;
+    }
+  }
+  end = last_write;
+  if (end <= start) end = start + 1e-9;
+
+  printf("{\"seconds\": %.6f, \"mmio_writes\": %llu, \"mmio_reads\": %llu, \"mmio_exits\": %llu,\n",
+    end - start, (unsigned long long)(writes - writes0), (unsigned long long)(state->MMIO_READS - reads0),
+    (unsigned long long)(writes - writes0 + state->MMIO_READS - reads0));
+  printf(" \"output_edges\": %llu, \"host_edges\": %llu,\n",
+    (unsigned long long)(state->OUTPUT_EDGES - edges0), (unsigned long long)host_edges);
+  printf(" \"writes_per_s\": %.0f, \"exits_per_s\": %.0f, \"output_edges_per_s\": %.0f, \"host_edges_per_s\": %.0f}\n",
+    (writes - writes0) / (end - start), (writes - writes0 + state->MMIO_READS - reads0) / (end - start),
+    (state->OUTPUT_EDGES - edges0) / (end - start), host_edges / (end - start));
+
+  return 0;
+}
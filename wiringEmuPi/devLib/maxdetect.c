@@ -126,10 +126,11 @@ int maxDetectRead (const int pin, unsigned char buffer [4])
   gettimeofday (&then, NULL) ;
 
 // Wake up the RHT03 by pulling the data line low, then high
-//	Low for 10mS, high for 40uS.
+//	Low for 18mS (the DHT11 needs that long, the RHT03 only 1mS), high
+//	for 40uS.
 
   pinMode      (pin, OUTPUT) ;
-  digitalWrite (pin, 0) ; delay             (10) ;
+  digitalWrite (pin, 0) ; delay             (18) ;
   digitalWrite (pin, 1) ; delayMicroseconds (40) ;
   pinMode      (pin, INPUT) ;
 
@@ -157,14 +158,14 @@ int maxDetectRead (const int pin, unsigned char buffer [4])
   timersub (&now, &then, &took) ;
 
 // Total time to do this should be:
-//	10mS + 40µS - reset
+//	18mS + 40µS - reset
 //	+ 80µS + 80µS - sensor doing its low -> high thing
 //	+ 40 * (50µS + 27µS (0) or 70µS (1) )
-//	= 15010µS
+//	= 23000µS
 // so if we take more than that, we've had a scheduling interruption and the
 // reading is probably bogus.
 
-  if ((took.tv_sec != 0) || (took.tv_usec > 16000))
+  if ((took.tv_sec != 0) || (took.tv_usec > 24000))
     return FALSE ;
 
   return checksum == localBuf [4] ;
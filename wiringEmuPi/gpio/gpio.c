@@ -33,6 +33,10 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <setjmp.h>
+#include <signal.h>
 
 #include <wiringPi.h>
 #include <wpiExtensions.h>
@@ -78,7 +82,29 @@ char *usage = "Usage: gpio -v\n"
 	      "       gpio i2cd/i2cdetect\n"
 	      "       gpio usbp high/low\n"
 	      "       gpio gbr <channel>\n"
-	      "       gpio gbw <channel> <value>" ;	// No trailing newline needed here.
+	      "       gpio gbw <channel> <value>\n"
+	      "       gpio [-g|-1] server [socket]" ;	// No trailing newline needed here.
+
+
+// Set while the server is running a command, so a bad one doesn't end it
+
+static jmp_buf *serverAbort = NULL ;
+
+
+/*
+ * failed:
+ *	Give up on the current command. Normally that's the end of the
+ *	program, but the server just moves on to the next line.
+ *********************************************************************************
+ */
+
+static void failed (void)
+{
+  if (serverAbort != NULL)
+    longjmp (*serverAbort, 1) ;
+
+  exit (1) ;
+}
 
 
 #ifdef	NOT_FOR_NOW
@@ -689,7 +715,7 @@ void doMode (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s mode pin mode\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -716,7 +742,7 @@ void doMode (int argc, char *argv [])
   else
   {
     fprintf (stderr, "%s: Invalid mode: %s. Should be in/out/pwm/clock/up/down/tri\n", argv [1], mode) ;
-    exit (1) ;
+    failed () ;
   }
 }
 
@@ -734,7 +760,7 @@ static void doPadDrive (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s drive group value\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   group = atoi (argv [2]) ;
@@ -743,13 +769,13 @@ static void doPadDrive (int argc, char *argv [])
   if ((group < 0) || (group > 2))
   {
     fprintf (stderr, "%s: drive group not 0, 1 or 2: %d\n", argv [0], group) ;
-    exit (1) ;
+    failed () ;
   }
 
   if ((val < 0) || (val > 7))
   {
     fprintf (stderr, "%s: drive value not 0-7: %d\n", argv [0], val) ;
-    exit (1) ;
+    failed () ;
   }
 
   setPadDrive (group, val) ;
@@ -770,7 +796,7 @@ static void doUsbP (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s usbp high|low\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
 // Make sure we're on a B+
@@ -780,7 +806,7 @@ static void doUsbP (int argc, char *argv [])
   if (!((model == PI_MODEL_BP) || (model == PI_MODEL_2)))
   {
     fprintf (stderr, "USB power contol is applicable to B+ and v2 boards only.\n") ;
-    exit (1) ;
+    failed () ;
   }
     
 // Make sure we start in BCM_GPIO mode
@@ -804,7 +830,7 @@ static void doUsbP (int argc, char *argv [])
   }
 
   fprintf (stderr, "Usage: %s usbp high|low\n", argv [0]) ;
-  exit (1) ;
+  failed () ;
 }
 
 
@@ -822,7 +848,7 @@ static void doGbw (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s gbw <channel> <value>\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   channel = atoi (argv [2]) ;
@@ -831,19 +857,19 @@ static void doGbw (int argc, char *argv [])
   if ((channel < 0) || (channel > 1))
   {
     fprintf (stderr, "%s: gbw: Channel number must be 0 or 1\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   if ((value < 0) || (value > 255))
   {
     fprintf (stderr, "%s: gbw: Value must be from 0 to 255\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   if (gertboardAnalogSetup (64) < 0)
   {
     fprintf (stderr, "Unable to initialise the Gertboard SPI interface: %s\n", strerror (errno)) ;
-    exit (1) ;
+    failed () ;
   }
 
   analogWrite (64 + channel, value) ;
@@ -864,7 +890,7 @@ static void doGbr (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s gbr <channel>\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   channel = atoi (argv [2]) ;
@@ -872,13 +898,13 @@ static void doGbr (int argc, char *argv [])
   if ((channel < 0) || (channel > 1))
   {
     fprintf (stderr, "%s: gbr: Channel number must be 0 or 1\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   if (gertboardAnalogSetup (64) < 0)
   {
     fprintf (stderr, "Unable to initialise the Gertboard SPI interface: %s\n", strerror (errno)) ;
-    exit (1) ;
+    failed () ;
   }
 
   printf ("%d\n", analogRead (64 + channel)) ;
@@ -898,7 +924,7 @@ static void doWrite (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s write pin value\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -930,7 +956,7 @@ static void doAwrite (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s awrite pin value\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -954,7 +980,7 @@ static void doWriteByte (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s wb value\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   val = (int)strtol (argv [2], NULL, 0) ;
@@ -976,7 +1002,7 @@ void doRead (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s read pin\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -997,7 +1023,7 @@ void doAread (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s aread pin\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   printf ("%d\n", analogRead (atoi (argv [2]))) ;
@@ -1017,7 +1043,7 @@ void doToggle (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s toggle pin\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -1039,7 +1065,7 @@ void doPwmTone (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s pwmTone <pin> <freq>\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -1062,7 +1088,7 @@ void doClock (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s clock <pin> <freq>\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -1086,7 +1112,7 @@ void doPwm (int argc, char *argv [])
   if (argc != 4)
   {
     fprintf (stderr, "Usage: %s pwm <pin> <value>\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pin = atoi (argv [2]) ;
@@ -1115,7 +1141,7 @@ static void doPwmRange (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s pwmr <range>\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   range = (unsigned int)strtoul (argv [2], NULL, 10) ;
@@ -1123,7 +1149,7 @@ static void doPwmRange (int argc, char *argv [])
   if (range == 0)
   {
     fprintf (stderr, "%s: range must be > 0\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pwmSetRange (range) ;
@@ -1136,7 +1162,7 @@ static void doPwmClock (int argc, char *argv [])
   if (argc != 3)
   {
     fprintf (stderr, "Usage: %s pwmc <clock>\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   clock = (unsigned int)strtoul (argv [2], NULL, 10) ;
@@ -1144,7 +1170,7 @@ static void doPwmClock (int argc, char *argv [])
   if ((clock < 1) || (clock > 4095))
   {
     fprintf (stderr, "%s: clock must be between 0 and 4096\n", argv [0]) ;
-    exit (1) ;
+    failed () ;
   }
 
   pwmSetClock (clock) ;
@@ -1190,6 +1216,199 @@ static void doVersion (char *argv [])
 }
 
 
+/*
+ * doCommand:
+ *	Run one of the pin commands. These are the ones that need wiringPi
+ *	set up, so they're also what the server accepts.
+ *********************************************************************************
+ */
+
+static int doCommand (int argc, char *argv [])
+{
+// Core wiringPi functions
+
+  /**/ if (strcasecmp (argv [1], "mode"   ) == 0) doMode      (argc, argv) ;
+  else if (strcasecmp (argv [1], "read"   ) == 0) doRead      (argc, argv) ;
+  else if (strcasecmp (argv [1], "write"  ) == 0) doWrite     (argc, argv) ;
+  else if (strcasecmp (argv [1], "pwm"    ) == 0) doPwm       (argc, argv) ;
+  else if (strcasecmp (argv [1], "awrite" ) == 0) doAwrite    (argc, argv) ;
+  else if (strcasecmp (argv [1], "aread"  ) == 0) doAread     (argc, argv) ;
+
+// GPIO Nicies
+
+  else if (strcasecmp (argv [1], "toggle" ) == 0) doToggle    (argc, argv) ;
+
+// Pi Specifics
+
+  else if (strcasecmp (argv [1], "pwm-bal"  ) == 0) doPwmMode    (PWM_MODE_BAL) ;
+  else if (strcasecmp (argv [1], "pwm-ms"   ) == 0) doPwmMode    (PWM_MODE_MS) ;
+  else if (strcasecmp (argv [1], "pwmr"     ) == 0) doPwmRange   (argc, argv) ;
+  else if (strcasecmp (argv [1], "pwmc"     ) == 0) doPwmClock   (argc, argv) ;
+  else if (strcasecmp (argv [1], "pwmTone"  ) == 0) doPwmTone    (argc, argv) ;
+  else if (strcasecmp (argv [1], "drive"    ) == 0) doPadDrive   (argc, argv) ;
+  else if (strcasecmp (argv [1], "readall"  ) == 0) doReadall    () ;
+  else if (strcasecmp (argv [1], "nreadall" ) == 0) doReadall    () ;
+  else if (strcasecmp (argv [1], "pins"     ) == 0) doPins       () ;
+  else if (strcasecmp (argv [1], "i2cdetect") == 0) doI2Cdetect  (argc, argv) ;
+  else if (strcasecmp (argv [1], "i2cd"     ) == 0) doI2Cdetect  (argc, argv) ;
+  else if (strcasecmp (argv [1], "reset"    ) == 0) doReset      (argv [0]) ;
+  else if (strcasecmp (argv [1], "wb"       ) == 0) doWriteByte  (argc, argv) ;
+  else if (strcasecmp (argv [1], "clock"    ) == 0) doClock      (argc, argv) ;
+  else if (strcasecmp (argv [1], "wfi"      ) == 0) doWfi        (argc, argv) ;
+  else
+    return FALSE ;
+
+  return TRUE ;
+}
+
+
+/*
+ * doServer:
+ *	gpio server [socket]
+ *	Keep wiringPi set up and run commands a line at a time, read from
+ *	stdin or from each connection to a UNIX socket, so scripts only pay
+ *	for the setup once. Commands are the ones above without the "gpio".
+ *	Over the socket each command's output is followed by OK or ERR so
+ *	the client knows when it's done.
+ *********************************************************************************
+ */
+
+#define	SERVER_MAX_ARGS	16
+
+static int serverLine (char *progName, char *line)
+{
+  char *argv [SERVER_MAX_ARGS + 1] ;
+  char *tok, *save ;
+  int argc = 0 ;
+  volatile int ok = FALSE ;
+  jmp_buf bail ;
+
+  argv [argc++] = progName ;
+  for (tok = strtok_r (line, " \t\r\n", &save) ; tok != NULL ; tok = strtok_r (NULL, " \t\r\n", &save))
+  {
+    if (argc == SERVER_MAX_ARGS)
+    {
+      fprintf (stderr, "%s: Too many arguments\n", progName) ;
+      return FALSE ;
+    }
+    argv [argc++] = tok ;
+  }
+  argv [argc] = NULL ;
+
+  if ((strcasecmp (argv [1], "quit") == 0) || (strcasecmp (argv [1], "exit") == 0))
+    return -1 ;
+
+// wfi would end the server on the first interrupt
+
+  if ((strcasecmp (argv [1], "wfi") == 0) || (strcasecmp (argv [1], "server") == 0))
+  {
+    fprintf (stderr, "%s: %s can't be used in the server\n", progName, argv [1]) ;
+    return FALSE ;
+  }
+
+  serverAbort = &bail ;
+  if (setjmp (bail) == 0)
+  {
+    if (!(ok = doCommand (argc, argv)))
+      fprintf (stderr, "%s: Unknown command: %s.\n", progName, argv [1]) ;
+  }
+  serverAbort = NULL ;
+
+  return ok ;
+}
+
+static void serverSession (char *progName, FILE *in, int ack)
+{
+  char line [1024] ;
+  char *cmd ;
+  int ok ;
+
+  while (fgets (line, sizeof (line), in) != NULL)
+  {
+    cmd = line + strspn (line, " \t\r\n") ;
+    if ((*cmd == '\0') || (*cmd == '#'))
+      continue ;
+
+    if ((ok = serverLine (progName, cmd)) < 0)
+      break ;
+
+    if (ack)
+      printf ("%s\n", ok ? "OK" : "ERR") ;
+    fflush (stdout) ;
+  }
+}
+
+static void doServer (int argc, char *argv [])
+{
+  struct sockaddr_un addr ;
+  int sock, conn, out, err ;
+  FILE *in ;
+
+  if (argc > 3)
+  {
+    fprintf (stderr, "Usage: %s server [socket]\n", argv [0]) ;
+    exit (1) ;
+  }
+
+  if (argc == 2)
+  {
+    serverSession (argv [0], stdin, FALSE) ;
+    return ;
+  }
+
+  if (strlen (argv [2]) >= sizeof (addr.sun_path))
+  {
+    fprintf (stderr, "%s: Socket path too long: %s\n", argv [0], argv [2]) ;
+    exit (1) ;
+  }
+
+  memset (&addr, 0, sizeof (addr)) ;
+  addr.sun_family = AF_UNIX ;
+  strcpy (addr.sun_path, argv [2]) ;
+  unlink (argv [2]) ;
+
+  if (((sock = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    || (bind (sock, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+    || (listen (sock, 4) < 0))
+  {
+    fprintf (stderr, "%s: Unable to listen on %s: %s\n", argv [0], argv [2], strerror (errno)) ;
+    exit (1) ;
+  }
+
+  signal (SIGPIPE, SIG_IGN) ;
+  out = dup (1) ;
+  err = dup (2) ;
+
+// One client at a time. Its output, and the complaints about its bad
+//	commands, go back down the socket.
+
+  for (;;)
+  {
+    if ((conn = accept (sock, NULL, NULL)) < 0)
+    {
+      if (errno == EINTR)
+	continue ;
+      fprintf (stderr, "%s: accept failed: %s\n", argv [0], strerror (errno)) ;
+      exit (1) ;
+    }
+
+    if ((in = fdopen (conn, "r")) == NULL)
+    {
+      close (conn) ;
+      continue ;
+    }
+
+    dup2 (conn, 1) ;
+    dup2 (conn, 2) ;
+    serverSession (argv [0], in, TRUE) ;
+    fflush (stdout) ;
+    dup2 (out, 1) ;
+    dup2 (err, 2) ;
+    fclose (in) ;
+  }
+}
+
+
 /*
  * main:
  *	Start here
@@ -1363,37 +1582,9 @@ int main (int argc, char *argv [])
     exit (EXIT_FAILURE) ;
   }
 
-// Core wiringPi functions
-
-  /**/ if (strcasecmp (argv [1], "mode"   ) == 0) doMode      (argc, argv) ;
-  else if (strcasecmp (argv [1], "read"   ) == 0) doRead      (argc, argv) ;
-  else if (strcasecmp (argv [1], "write"  ) == 0) doWrite     (argc, argv) ;
-  else if (strcasecmp (argv [1], "pwm"    ) == 0) doPwm       (argc, argv) ;
-  else if (strcasecmp (argv [1], "awrite" ) == 0) doAwrite    (argc, argv) ;
-  else if (strcasecmp (argv [1], "aread"  ) == 0) doAread     (argc, argv) ;
-
-// GPIO Nicies
-
-  else if (strcasecmp (argv [1], "toggle" ) == 0) doToggle    (argc, argv) ;
-
-// Pi Specifics
-
-  else if (strcasecmp (argv [1], "pwm-bal"  ) == 0) doPwmMode    (PWM_MODE_BAL) ;
-  else if (strcasecmp (argv [1], "pwm-ms"   ) == 0) doPwmMode    (PWM_MODE_MS) ;
-  else if (strcasecmp (argv [1], "pwmr"     ) == 0) doPwmRange   (argc, argv) ;
-  else if (strcasecmp (argv [1], "pwmc"     ) == 0) doPwmClock   (argc, argv) ;
-  else if (strcasecmp (argv [1], "pwmTone"  ) == 0) doPwmTone    (argc, argv) ;
-  else if (strcasecmp (argv [1], "drive"    ) == 0) doPadDrive   (argc, argv) ;
-  else if (strcasecmp (argv [1], "readall"  ) == 0) doReadall    () ;
-  else if (strcasecmp (argv [1], "nreadall" ) == 0) doReadall    () ;
-  else if (strcasecmp (argv [1], "pins"     ) == 0) doPins       () ;
-  else if (strcasecmp (argv [1], "i2cdetect") == 0) doI2Cdetect  (argc, argv) ;
-  else if (strcasecmp (argv [1], "i2cd"     ) == 0) doI2Cdetect  (argc, argv) ;
-  else if (strcasecmp (argv [1], "reset"    ) == 0) doReset      (argv [0]) ;
-  else if (strcasecmp (argv [1], "wb"       ) == 0) doWriteByte  (argc, argv) ;
-  else if (strcasecmp (argv [1], "clock"    ) == 0) doClock      (argc, argv) ;
-  else if (strcasecmp (argv [1], "wfi"      ) == 0) doWfi        (argc, argv) ;
-  else
+  /**/ if (strcasecmp (argv [1], "server") == 0)
+    doServer (argc, argv) ;
+  else if (!doCommand (argc, argv))
   {
     fprintf (stderr, "%s: Unknown command: %s.\n", argv [0], argv [1]) ;
     exit (EXIT_FAILURE) ;
@@ -23,6 +23,7 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
@@ -56,6 +57,11 @@ static volatile int range         [MAX_PINS] ;
 static volatile pthread_t threads [MAX_PINS] ;
 static volatile int newPin = -1 ;
 
+// Under QEMU the waveform comes from a generator in the emulated GPIO
+//	device instead of a thread (see piEmuWaveStart)
+
+static volatile int offloaded     [MAX_PINS] ;
+
 
 /*
  * softPwmThread:
@@ -102,6 +108,8 @@ static PI_THREAD (softPwmThread)
 
 void softPwmWrite (int pin, int value)
 {
+  uint64_t period, mark ;
+
   pin &= (MAX_PINS - 1) ;
 
   /**/ if (value < 0)
@@ -110,6 +118,21 @@ void softPwmWrite (int pin, int value)
     value = range [pin] ;
 
   marks [pin] = value ;
+
+// The generator takes 32-bit ns times: a period longer than that keeps
+//	its duty cycle
+
+  if (offloaded [pin])
+  {
+    period = (uint64_t)range [pin] * PULSE_TIME * 1000 ;
+    mark   = (uint64_t)value       * PULSE_TIME * 1000 ;
+    if (period > UINT32_MAX)
+    {
+      mark   = (uint64_t)value * UINT32_MAX / range [pin] ;
+      period = UINT32_MAX ;
+    }
+    piEmuWaveSet (pin, mark, period - mark) ;
+  }
 }
 
 
@@ -136,6 +159,13 @@ int softPwmCreate (int pin, int initialValue, int pwmRange)
   marks [pin] = initialValue ;
   range [pin] = pwmRange ;
 
+  if (piEmuWaveStart (pin) == 0)
+  {
+    offloaded [pin] = 1 ;
+    softPwmWrite (pin, initialValue) ;
+    return 0 ;
+  }
+
   newPin = pin ;
   res    = pthread_create (&myThread, NULL, softPwmThread, NULL) ;
 
@@ -158,8 +188,16 @@ void softPwmStop (int pin)
 {
   if (range [pin] != 0)
   {
-    pthread_cancel (threads [pin]) ;
-    pthread_join   (threads [pin], NULL) ;
+    if (offloaded [pin])
+    {
+      piEmuWaveStop (pin) ;
+      offloaded [pin] = 0 ;
+    }
+    else
+    {
+      pthread_cancel (threads [pin]) ;
+      pthread_join   (threads [pin], NULL) ;
+    }
     range [pin] = 0 ;
     digitalWrite (pin, LOW) ;
   }
@@ -41,6 +41,11 @@ static pthread_t threads [MAX_PINS] ;
 
 static int newPin = -1 ;
 
+// Under QEMU the tone comes from a generator in the emulated GPIO device
+//	instead of a thread (see piEmuWaveStart)
+
+static int offloaded     [MAX_PINS] ;
+
 
 /*
  * softToneThread:
@@ -98,6 +103,9 @@ void softToneWrite (int pin, int freq)
     freq = 5000 ;
 
   freqs [pin] = freq ;
+
+  if (offloaded [pin])
+    piEmuWaveSet (pin, freq ? 500000000 / freq : 0, freq ? 500000000 / freq : 0) ;
 }
 
 
@@ -115,11 +123,17 @@ int softToneCreate (int pin)
   pinMode      (pin, OUTPUT) ;
   digitalWrite (pin, LOW) ;
 
-  if (threads [pin] != 0)
+  if ((threads [pin] != 0) || offloaded [pin])
     return -1 ;
 
   freqs [pin] = 0 ;
 
+  if (piEmuWaveStart (pin) == 0)
+  {
+    offloaded [pin] = 1 ;
+    return 0 ;
+  }
+
   newPin = pin ;
   res    = pthread_create (&myThread, NULL, softToneThread, NULL) ;
 
@@ -140,7 +154,13 @@ int softToneCreate (int pin)
 
 void softToneStop (int pin)
 {
-  if (threads [pin] != 0)
+  if (offloaded [pin])
+  {
+    piEmuWaveStop (pin) ;
+    offloaded [pin] = 0 ;
+    digitalWrite (pin, LOW) ;
+  }
+  else if (threads [pin] != 0)
   {
     pthread_cancel (threads [pin]) ;
     pthread_join   (threads [pin], NULL) ;
@@ -53,6 +53,13 @@
 //
 //      28 Sep 2016 - Evan Platt:
 //              Added check for QEMU and configuration file
+//
+//      19 Oct 2026 - Evan Platt:
+//              Probe for QEMU and read .emupi once per process; board
+//              revision and id are cached.
+//              Optional paravirtual GPIO page under QEMU (WIRINGPI_EMU_PV).
+//              Delays under QEMU sleep to a deadline in guest time.
+//              softPwm/softTone use the rpi_gpio waveform generators under QEMU.
 
 
 #include <stdio.h>
@@ -69,12 +76,14 @@
 #include <pthread.h>
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <asm/ioctl.h>
 #include <dirent.h>
 #include <pwd.h>
+#include <limits.h>
 
 #include "softPwm.h"
 #include "softTone.h"
@@ -86,6 +95,7 @@
 #define	ENV_DEBUG	"WIRINGPI_DEBUG"
 #define	ENV_CODES	"WIRINGPI_CODES"
 #define	ENV_GPIOMEM	"WIRINGPI_GPIOMEM"
+#define	ENV_EMU_PV	"WIRINGPI_EMU_PV"
 
 
 // Mask for the bottom 64 pins which belong to the Raspberry Pi
@@ -193,6 +203,42 @@ static volatile unsigned int GPIO_PWM ;
 // Locals to hold pointers to the hardware
 
 static volatile uint32_t *gpio ;
+static volatile uint32_t *gpioPv ;	// Emulated only: see emuPvSetup ()
+static volatile uint32_t *gpioPvOut ;
+
+// Paravirtual GPIO pages
+//	With -global rpi_gpio.pv=on QEMU maps its shared_gpio_state segment
+//	(read only) one page above the registers, and a page for our outputs
+//	above that. Word offsets:
+
+#define	EMU_PV_CTRL	(0xC0 / 4)	// In the registers: reads EMU_PV_MAGIC, write 1 to enable
+#define	EMU_PV_MAGIC	0x52505056
+#define	EMU_PV_OFFSET	0x1000
+#define	EMU_PV_GPLEV	6		// In the segment: host inputs
+#define	EMU_PV_MASK	22		//	bits QEMU decides instead
+#define	EMU_PV_LEV	24		//	and their levels
+#define	EMU_PV_OUTSTATE	0		// In the output page
+
+// Levels of a bank under pv, as GPLEV would read them
+
+static inline uint32_t emuPvLevel (int bank)
+{
+  uint32_t mask = *(gpioPv + EMU_PV_MASK + bank) ;
+
+  return (*(gpioPv + EMU_PV_GPLEV + bank) & ~mask) | (*(gpioPv + EMU_PV_LEV + bank) & mask) ;
+}
+
+// Waveform generators in the emulated registers: 4 words per slot
+
+#define	EMU_WAVE_INFO	(0xC4 / 4)	// Number of slots
+#define	EMU_WAVE_BASE	(0x100 / 4)
+#define	EMU_WAVE_CTRL	0
+#define	EMU_WAVE_MARK	1
+#define	EMU_WAVE_SPACE	2
+#define	EMU_WAVE_ENABLE	0x80000000
+#define	EMU_WAVE_MAX	8
+
+static int emuWavePins [EMU_WAVE_MAX] = { -1, -1, -1, -1, -1, -1, -1, -1 } ;
 static volatile uint32_t *pwm ;
 static volatile uint32_t *clk ;
 static volatile uint32_t *pads ;
@@ -495,7 +541,6 @@ static uint8_t gpioToGPLEV [] =
 } ;
 
 
-#ifdef notYetReady
 // gpioToEDS
 //	(Word) offset to the Event Detect Status
 
@@ -522,7 +567,6 @@ static uint8_t gpioToFEN [] =
   22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,
   23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,23,
 } ;
-#endif
 
 
 // GPPUD:
@@ -717,74 +761,147 @@ static void piEmuCfgInfo(){
 }
 
 
-int piBoardRev (void)
+/*
+ * piEmuProbe:
+ *	Work out, once per process, whether we're running on an emulated Pi
+ *	and if so read the board details from ~/.emupi.
+ *
+ *	QEMU's versatilepb machine shows up on the Hardware line of
+ *	/proc/cpuinfo, which is a single small read. Scanning /dev/disk/by-id
+ *	for a QEMU drive is only needed when the Hardware line is neither a
+ *	BCM270x nor a Versatile board.
+ *********************************************************************************
+ */
+
+static struct
 {
-  DIR    *d ;
-  FILE   *cpuFd, *emucfg ;
-  struct dirent *dir ;
-  char   line [120] ;
-  char   *c ;
-  static int  boardRev = -1 ;
-  char *homedir, *emucfg_path;
+  int  probed ;
+  int  isQEMU ;
+  int  boardRev ;		// -1 if .emupi has no valid board_rev
+  char boardId [16] ;		// Old style revision code, "" if not given
+} piEmu ;
 
-  if (boardRev != -1)	// No point checking twice
-    return boardRev ;
+// Return the value part of "key = value" with trailing space removed,
+//	or NULL if the line is not for key.
 
-  // Check for QEMU platform
+static char *piEmuCfgValue (char *line, const char *key)
+{
+  char *c, *end ;
 
-  d = opendir("/dev/disk/by-id");
-  if (d){
+  if (strstr (line, key) == NULL)
+    return NULL ;
 
-    while ((dir = readdir(d)) != NULL){
+  if ((c = strchr (line, '=')) == NULL)
+    piBoardRevOops ("Bogus line in .emupi (no '=')") ;
 
-      if (strstr (dir->d_name, "QEMU") != NULL){
+  for (++c ; isspace (*c) ; ++c)
+    ;
+  for (end = c + strlen (c) ; (end > c) && isspace (end [-1]) ; --end)
+    ;
+  *end = 0 ;
 
-        // Found a QEMU drive
+  return c ;
+}
 
-        if (wiringPiDebug)
-          printf ("piboardRev: Found a QEMU filesystem.  Assuming this is a QEMU-emulated Pi.\n") ;
+static int piEmuProbe (void)
+{
+  FILE *fd ;
+  DIR  *d ;
+  struct dirent *dir ;
+  struct passwd *pw ;
+  char line [120] ;
+  char path [PATH_MAX] ;
+  char *homedir, *value ;
+  int  known = FALSE ;
 
-        if ((homedir = getenv("HOME")) == NULL) {
-          homedir = getpwuid(getuid())->pw_dir;
-        }
+  if (piEmu.probed)
+    return piEmu.isQEMU ;
 
-        emucfg_path = malloc(120);
-        strcpy(emucfg_path,homedir);
-        strcat(emucfg_path, "/.emupi");
+  piEmu.probed   = TRUE ;
+  piEmu.boardRev = -1 ;
 
-        if ((emucfg = fopen (emucfg_path, "r")) == NULL)
-          piEmuCfgInfo();
+  if ((fd = fopen ("/proc/cpuinfo", "r")) != NULL)
+  {
+    while (fgets (line, sizeof (line), fd) != NULL)
+      if (strncmp (line, "Hardware", 8) == 0)
+      {
+        if (strstr (line, "Versatile") != NULL)
+          piEmu.isQEMU = known = TRUE ;
+        else if (strstr (line, "BCM27") != NULL)
+          known = TRUE ;
+        break ;
+      }
+    fclose (fd) ;
+  }
 
-        while (fgets (line, 120, emucfg) != NULL){
+  if (!known && ((d = opendir ("/dev/disk/by-id")) != NULL))
+  {
+    while ((dir = readdir (d)) != NULL)
+      if (strstr (dir->d_name, "QEMU") != NULL)
+      {
+        piEmu.isQEMU = TRUE ;
+        break ;
+      }
+    closedir (d) ;
+  }
 
-          if (strstr (line, "board_rev") != NULL) {
+  if (!piEmu.isQEMU)
+    return FALSE ;
 
-            if (wiringPiDebug)
-              printf ("piboardRev: Found board_rev line in .wiringEmuPi: %s\n",line) ;
+  if (wiringPiDebug)
+    printf ("piEmuProbe: Found QEMU. Assuming this is a QEMU-emulated Pi.\n") ;
 
-            // Scan past the '=''
-            for (c = line ; *c ; ++c)
-              if (*c == '=')
-                break ;
-            if (*c != '=')
-              piBoardRevOops ("Bogus \"board_rev\" line in .wiringEmuPi (no '=')") ;
-            // Skip spaces
-            ++c ;
-            while (isspace (*c))
-              ++c ;
-            // Check board_rev
-            if (*c != 0x31 && *c != 0x32)
-              piBoardRevOops ("Invalid board_rev in .wiringEmuPi (must be 1 or 2)");
+  if ((homedir = getenv ("HOME")) == NULL)
+    homedir = ((pw = getpwuid (getuid ())) != NULL) ? pw->pw_dir : "" ;
 
-            return boardRev = (*c-0x30);
+  snprintf (path, sizeof (path), "%s/.emupi", homedir) ;
+  if ((fd = fopen (path, "r")) == NULL)
+    piEmuCfgInfo () ;
 
-          }
+  while (fgets (line, sizeof (line), fd) != NULL)
+  {
+    if ((value = piEmuCfgValue (line, "board_rev")) != NULL)
+    {
+      if (wiringPiDebug)
+        printf ("piEmuProbe: board_rev = %s\n", value) ;
+      if ((strcmp (value, "1") == 0) || (strcmp (value, "2") == 0))
+        piEmu.boardRev = *value - '0' ;
+    }
+    else if ((value = piEmuCfgValue (line, "board_id")) != NULL)
+    {
+      if (wiringPiDebug)
+        printf ("piEmuProbe: board_id = %s\n", value) ;
+      if (strlen (value) >= 4)
+        snprintf (piEmu.boardId, sizeof (piEmu.boardId), "%s", value + strlen (value) - 4) ;
+    }
+  }
+  fclose (fd) ;
 
-        }
+  return TRUE ;
+}
 
-      }
-    }
-    closedir(d);
+
+int piBoardRev (void)
+{
+  FILE   *cpuFd ;
+  char   line [120] ;
+  char   *c ;
+  static int  boardRev = -1 ;
+
+  if (boardRev != -1)	// No point checking twice
+    return boardRev ;
+
+// Check for QEMU platform
+
+  if (piEmuProbe ())
+  {
+    if (piEmu.boardRev == -1)
+      piBoardRevOops ("No valid \"board_rev\" line in .emupi (must be 1 or 2)") ;
+
+    if (wiringPiDebug)
+      printf ("piBoardRev: Returning revision from .emupi: %d\n", piEmu.boardRev) ;
+
+    return boardRev = piEmu.boardRev ;
   }
 
   if ((cpuFd = fopen ("/proc/cpuinfo", "r")) == NULL)
@@ -960,72 +1077,39 @@ int piBoardRev (void)
 
 void piBoardId (int *model, int *rev, int *mem, int *maker, int *warranty)
 {
-  DIR    *d ;
-  FILE *cpuFd, *emucfg ;
-  struct dirent *dir ;
+  FILE *cpuFd ;
   char line [120] ;
   char *c ;
-  unsigned int revision ;
+  unsigned int revision = 0 ;
   int bRev, bType, bProc, bMfg, bMem, bWarranty ;
   char isQEMU=0;
-  char *homedir, *emucfg_path;
+  static int boardId [5] ;
+  static int boardIdValid = FALSE ;
 
 //	Will deal with the properly later on - for now, lets just get it going...
 //  unsigned int modelNum ;
 
-  (void)piBoardRev () ;	// Call this first to make sure all's OK. Don't care about the result.
-
-  // Check for QEMU platform
-
-  d = opendir("/dev/disk/by-id");
-  if (d){
-
-    while ((dir = readdir(d)) != NULL){
-
-      if (strstr (dir->d_name, "QEMU") != NULL){
-
-        // Found a QEMU drive
-
-        isQEMU=1;
-        if (wiringPiDebug)
-          printf ("piboardId: Found a QEMU filesystem.  Assuming this is a QEMU-emulated Pi.\n") ;
-
-        if ((homedir = getenv("HOME")) == NULL) {
-          homedir = getpwuid(getuid())->pw_dir;
-        }
-
-        emucfg_path = malloc(120);
-        strcpy(emucfg_path,homedir);
-        strcat(emucfg_path, "/.emupi");
-
-        if ((emucfg = fopen (emucfg_path, "r")) == NULL)
-          piEmuCfgInfo();
-
-        while (fgets (line, 120, emucfg) != NULL){
-
-          if (strstr (line, "board_id") != NULL) {
-
-            if (wiringPiDebug)
-              printf ("piboardId: Found board_id line in .wiringEmuPi: %s\n",line) ;
+// The answer can't change while we're running, and the gpio command asks
+//	more than once.
 
-            // Scan past the '=''
-            for (c = line ; *c ; ++c)
-              if (*c == '=')
-                break ;
-            if (*c != '=')
-              piBoardRevOops ("Bogus \"board_id\" line in .wiringEmuPi (no '=')") ;
-            // Skip spaces
-            ++c ;
-            while (isspace (*c))
-              ++c ;
+  if (boardIdValid)
+  {
+    *model = boardId [0] ; *rev = boardId [1] ; *mem = boardId [2] ; *maker = boardId [3] ; *warranty = boardId [4] ;
+    return ;
+  }
 
-          }
+  (void)piBoardRev () ;	// Call this first to make sure all's OK. Don't care about the result.
 
-        }
+// Check for QEMU platform: the board id comes from .emupi and is decoded
+//	exactly like an old style Revision code
 
-      }
-    }
-    closedir(d);
+  if (piEmuProbe ())
+  {
+    isQEMU = 1 ;
+    if (piEmu.boardId [0] == 0)
+      strcpy (piEmu.boardId, (piEmu.boardRev == 1) ? "0002" : "000e") ;
+    strcpy (line, piEmu.boardId) ;
+    c = line ;
   }
 
   if (isQEMU==0){
@@ -1140,6 +1224,9 @@ void piBoardId (int *model, int *rev, int *mem, int *maker, int *warranty)
     else if (strcmp (c, "0015") == 0) { *model = PI_MODEL_AP ; *rev = PI_VERSION_1_1 ; *mem = 0 ; *maker = PI_MAKER_SONY    ; }
     else                              { *model = 0           ; *rev = 0              ; *mem =   0 ; *maker = 0 ;               }
   }
+
+  boardId [0] = *model ; boardId [1] = *rev ; boardId [2] = *mem ; boardId [3] = *maker ; boardId [4] = *warranty ;
+  boardIdValid = TRUE ;
 }
 
 
@@ -1625,6 +1712,9 @@ int digitalRead (int pin)
     else if (wiringPiMode != WPI_MODE_GPIO)
       return LOW ;
 
+    if (gpioPv != NULL)
+      return ((emuPvLevel (pin >> 5) & (1 << (pin & 31))) != 0) ? HIGH : LOW ;
+
     if ((*(gpio + gpioToGPLEV [pin]) & (1 << (pin & 31))) != 0)
       return HIGH ;
     else
@@ -1670,6 +1760,15 @@ void digitalWrite (int pin, int value)
     else if (wiringPiMode != WPI_MODE_GPIO)
       return ;
 
+    if (gpioPv != NULL)
+    {
+      if (value == LOW)
+	__sync_fetch_and_and (gpioPvOut + EMU_PV_OUTSTATE + (pin >> 5), ~(1 << (pin & 31))) ;
+      else
+	__sync_fetch_and_or  (gpioPvOut + EMU_PV_OUTSTATE + (pin >> 5),  (1 << (pin & 31))) ;
+      return ;
+    }
+
     if (value == LOW){
       *(gpio + gpioToGPCLR [pin]) = 1 << (pin & 31) ;
     }
@@ -1857,6 +1956,79 @@ unsigned int digitalReadByte (void)
 }
 
 
+/*
+ * digitalWriteMask:
+ * digitalReadBank:
+ *	Pi Specific
+ *	Set and clear any number of the BCM_GPIO pins in one bank (0: pins
+ *	0-31, 1: pins 32-53) with a single GPSET and a single GPCLR store,
+ *	or read all of a bank's levels with a single load.
+ *	Bit n of the masks is BCM_GPIO pin (bank * 32 + n) whatever the
+ *	wiringPi pin mode - use wpiPinToGpio () / physPinToGpio () to build
+ *	them. Under emulation every register access is a trip out to QEMU,
+ *	so this is much cheaper than a digitalWrite () per pin.
+ *********************************************************************************
+ */
+
+void digitalWriteMask (int bank, unsigned int set, unsigned int clr)
+{
+  int pin ;
+
+  if ((bank < 0) || (bank > 1))
+    return ;
+
+  if (wiringPiMode == WPI_MODE_GPIO_SYS)
+  {
+    for (pin = 0 ; pin < 32 ; ++pin)
+    {
+      /**/ if ((clr & (1u << pin)) != 0)
+	digitalWrite (bank * 32 + pin, LOW) ;
+      else if ((set & (1u << pin)) != 0)
+	digitalWrite (bank * 32 + pin, HIGH) ;
+    }
+    return ;
+  }
+
+  if (gpioPv != NULL)
+  {
+    volatile uint32_t *out = gpioPvOut + EMU_PV_OUTSTATE + bank ;
+    uint32_t old ;
+
+    do
+      old = *out ;
+    while (!__sync_bool_compare_and_swap (out, old, (old & ~clr) | set)) ;
+    return ;
+  }
+
+  if (clr != 0)
+    *(gpio + gpioToGPCLR [bank * 32]) = clr ;
+  if (set != 0)
+    *(gpio + gpioToGPSET [bank * 32]) = set ;
+}
+
+unsigned int digitalReadBank (int bank)
+{
+  int pin ;
+  unsigned int data = 0 ;
+
+  if ((bank < 0) || (bank > 1))
+    return 0 ;
+
+  if (wiringPiMode == WPI_MODE_GPIO_SYS)
+  {
+    for (pin = 0 ; pin < 32 ; ++pin)
+      if ((bank * 32 + pin < 54) && (sysFds [bank * 32 + pin] != -1) && (digitalRead (bank * 32 + pin) == HIGH))
+	data |= (1u << pin) ;
+    return data ;
+  }
+
+  if (gpioPv != NULL)
+    return emuPvLevel (bank) ;
+
+  return *(gpio + gpioToGPLEV [bank * 32]) ;
+}
+
+
 /*
  * digitalWriteByte2:
  * digitalReadByte2:
@@ -1908,6 +2080,354 @@ unsigned int digitalReadByte2 (void)
 }
 
 
+/*
+ * emuPvSetup:
+ *	Every access to the emulated registers is a trip out to QEMU. If asked
+ *	to (WIRINGPI_EMU_PV set) and QEMU offers it, map the paravirtual pages
+ *	instead: digitalRead/Write then become plain memory accesses. Reads see
+ *	host inputs straight away in the shared segment (read only to us).
+ *	Writes go to our own output page, which QEMU folds into the device and
+ *	publishes to the host on the next register access or every
+ *	rpi_gpio.edge-poll-us. pinMode and everything else still go through the
+ *	registers.
+ *********************************************************************************
+ */
+
+static void emuPvSetup (int fd)
+{
+  void *pv, *out ;
+
+  if ((getenv (ENV_EMU_PV) == NULL) || wiringPiTryGpioMem || !piEmuProbe ())
+    return ;
+
+  if (*(gpio + EMU_PV_CTRL) != EMU_PV_MAGIC)
+  {
+    if (wiringPiDebug)
+      printf ("wiringPi: no paravirtual GPIO page (start QEMU with -global rpi_gpio.pv=on)\n") ;
+    return ;
+  }
+
+  pv  = mmap (0, BLOCK_SIZE, PROT_READ, MAP_SHARED, fd, GPIO_BASE + EMU_PV_OFFSET) ;
+  out = mmap (0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_BASE + EMU_PV_OFFSET + BLOCK_SIZE) ;
+  if ((pv == MAP_FAILED) || (out == MAP_FAILED))
+  {
+    if (wiringPiDebug)
+      printf ("wiringPi: mmap (paravirtual GPIO) failed: %s\n", strerror (errno)) ;
+    if (pv != MAP_FAILED)
+      munmap (pv, BLOCK_SIZE) ;
+    if (out != MAP_FAILED)
+      munmap (out, BLOCK_SIZE) ;
+    return ;
+  }
+
+  *(gpio + EMU_PV_CTRL) = 1 ;
+  gpioPv    = (volatile uint32_t *)pv ;
+  gpioPvOut = (volatile uint32_t *)out ;
+
+  if (wiringPiDebug)
+    printf ("wiringPi: using the paravirtual GPIO page\n") ;
+}
+
+
+/*
+ * piEmuWaveStart:
+ * piEmuWaveSet:
+ * piEmuWaveStop:
+ *	Under QEMU the rpi_gpio device can toggle a pin itself from a virtual
+ *	clock timer: high for markNs, low for spaceNs. softPwm and softTone use
+ *	these in place of a thread per pin that would otherwise spend all its
+ *	time trapping into the emulator. A mark (or space) of 0 holds the pin
+ *	low (or high). Start returns -1 when there is no generator to use.
+ *********************************************************************************
+ */
+
+static int emuWaveSlot (int pin)
+{
+  int slot ;
+
+  /**/ if ((pin & PI_GPIO_MASK) != 0)
+    return -1 ;
+  else if (wiringPiMode == WPI_MODE_PINS)
+    pin = pinToGpio [pin] ;
+  else if (wiringPiMode == WPI_MODE_PHYS)
+    pin = physToGpio [pin] ;
+  else if (wiringPiMode != WPI_MODE_GPIO)
+    return -1 ;
+
+  for (slot = 0 ; slot < EMU_WAVE_MAX ; ++slot)
+    if (emuWavePins [slot] == pin)
+      return slot ;
+
+  return -1 ;
+}
+
+int piEmuWaveStart (int pin)
+{
+  int slot, slots ;
+  volatile uint32_t *regs ;
+
+  if ((gpio == NULL) || !piEmuProbe () || ((pin & PI_GPIO_MASK) != 0))
+    return -1 ;
+
+  /**/ if (wiringPiMode == WPI_MODE_PINS)
+    pin = pinToGpio [pin] ;
+  else if (wiringPiMode == WPI_MODE_PHYS)
+    pin = physToGpio [pin] ;
+  else if (wiringPiMode != WPI_MODE_GPIO)
+    return -1 ;
+
+  if ((slots = *(gpio + EMU_WAVE_INFO)) > EMU_WAVE_MAX)
+    slots = EMU_WAVE_MAX ;
+
+// A slot that is enabled may belong to another process
+
+  for (slot = 0 ; slot < slots ; ++slot)
+  {
+    regs = gpio + EMU_WAVE_BASE + slot * 4 ;
+    if ((emuWavePins [slot] == -1) && ((*(regs + EMU_WAVE_CTRL) & EMU_WAVE_ENABLE) == 0))
+    {
+      *(regs + EMU_WAVE_MARK)  = 0 ;
+      *(regs + EMU_WAVE_SPACE) = 0 ;
+      *(regs + EMU_WAVE_CTRL)  = EMU_WAVE_ENABLE | pin ;
+      emuWavePins [slot] = pin ;
+      return 0 ;
+    }
+  }
+
+  return -1 ;
+}
+
+void piEmuWaveSet (int pin, unsigned int markNs, unsigned int spaceNs)
+{
+  int slot = emuWaveSlot (pin) ;
+
+  if (slot < 0)
+    return ;
+
+  *(gpio + EMU_WAVE_BASE + slot * 4 + EMU_WAVE_MARK)  = markNs ;
+  *(gpio + EMU_WAVE_BASE + slot * 4 + EMU_WAVE_SPACE) = spaceNs ;
+}
+
+void piEmuWaveStop (int pin)
+{
+  int slot = emuWaveSlot (pin) ;
+
+  if (slot < 0)
+    return ;
+
+  *(gpio + EMU_WAVE_BASE + slot * 4 + EMU_WAVE_CTRL) = 0 ;
+  emuWavePins [slot] = -1 ;
+}
+
+
+/*
+ * emuEdgeDetect:
+ *	Under QEMU the stock guest kernel has no GPIO driver for the emulated
+ *	block, so /sys/class/gpio edges never fire. Instead, when the registers
+ *	are mapped, we program the event detect enables ourselves and wait on
+ *	the GPEDS bits, which the rpi_gpio device sets (and raises its interrupt
+ *	for) as soon as it sees the edge.
+ *	When the rpi_gpio_emu module (emu/guest_driver) is loaded it owns the
+ *	GPxEN and GPEDS registers instead, and we use its sysfs edges like on
+ *	a real Pi, so the two never fight over them.
+ *********************************************************************************
+ */
+
+// Without UIO the GPEDS checks back off from the device's edge sampling
+//	period (rpi_gpio.edge-poll-us, 100uS by default) to a millisecond. An
+//	edge stays latched in GPEDS, so this only delays the wake up; shorter
+//	periods just trap into QEMU for nothing while the line is idle.
+
+#define	EMU_IRQ_POLL_MIN_US	100
+#define	EMU_IRQ_POLL_MAX_US	1000
+
+static int emuUioFd = -1 ;
+
+static int emuKernelDriver = -1 ;
+
+static int emuEdgeDetect (void)
+{
+  if (emuKernelDriver == -1)
+    emuKernelDriver = (access ("/sys/bus/platform/drivers/rpi_gpio", F_OK) == 0) ;
+
+  return (gpio != NULL) && piEmuProbe () && !emuKernelDriver &&
+    ((wiringPiMode == WPI_MODE_PINS) || (wiringPiMode == WPI_MODE_GPIO) || (wiringPiMode == WPI_MODE_PHYS)) ;
+}
+
+// If the guest exposes the block's interrupt through UIO (a uio device
+//	named "rpi_gpio"), we can sleep on it rather than polling GPEDS.
+//	Each interrupt is read from the fd once, so one thread does that for
+//	every pin: it moves the GPEDS bits into emuIrqPending and wakes the
+//	waiters, which each take their own pin's bit.
+
+static pthread_once_t  emuUioOnce   = PTHREAD_ONCE_INIT ;
+static pthread_mutex_t emuIrqMutex  = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t  emuIrqCond   = PTHREAD_COND_INITIALIZER ;
+static uint32_t        emuIrqPending [2] ;
+
+static void *emuUioReader (void *arg)
+{
+  uint32_t info, eds ;
+  struct pollfd polls ;
+  int bank ;
+
+  (void)piHiPri (55) ;	// Only effective if we run as root
+
+  for (;;)
+  {
+    pthread_mutex_lock (&emuIrqMutex) ;
+    for (bank = 0 ; bank < 2 ; ++bank)
+    {
+      if ((eds = *(gpio + gpioToEDS [bank * 32])) != 0)
+      {
+	*(gpio + gpioToEDS [bank * 32]) = eds ;	// Write 1 to clear
+	emuIrqPending [bank] |= eds ;
+      }
+    }
+    pthread_cond_broadcast (&emuIrqCond) ;
+    pthread_mutex_unlock (&emuIrqMutex) ;
+
+// uio_pdrv_genirq masks the interrupt each time it fires: unmask, then
+//	sleep until the device next raises it
+
+    info = 1 ;
+    (void)write (emuUioFd, &info, sizeof (info)) ;
+    polls.fd     = emuUioFd ;
+    polls.events = POLLIN ;
+    if (poll (&polls, 1, -1) > 0)
+      (void)read (emuUioFd, &info, sizeof (info)) ;
+  }
+
+  return NULL ;
+}
+
+static void emuUioInit (void)
+{
+  char fName [64], name [32] ;
+  pthread_t threadId ;
+  FILE *fd ;
+  int i ;
+
+  emuUioFd = -1 ;
+  for (i = 0 ; i < 16 ; ++i)
+  {
+    sprintf (fName, "/sys/class/uio/uio%d/name", i) ;
+    if ((fd = fopen (fName, "r")) == NULL)
+      break ;
+    if ((fgets (name, sizeof (name), fd) != NULL) && (strncmp (name, "rpi_gpio", 8) == 0))
+    {
+      sprintf (fName, "/dev/uio%d", i) ;
+      emuUioFd = open (fName, O_RDWR) ;
+    }
+    fclose (fd) ;
+    if (emuUioFd != -1)
+      break ;
+  }
+
+  if ((emuUioFd != -1) && (pthread_create (&threadId, NULL, emuUioReader, NULL) != 0))
+  {
+    close (emuUioFd) ;
+    emuUioFd = -1 ;
+  }
+
+  if (wiringPiDebug)
+    printf ("wiringPi: emulated interrupts via %s\n", (emuUioFd != -1) ? fName : "GPEDS polling") ;
+}
+
+static int emuUioOpen (void)
+{
+  pthread_once (&emuUioOnce, emuUioInit) ;
+  return emuUioFd ;
+}
+
+static void emuEdgeSetup (int bcmGpioPin, int mode)
+{
+  uint32_t bit = 1 << (bcmGpioPin & 31) ;
+
+  if ((mode == INT_EDGE_RISING) || (mode == INT_EDGE_BOTH))
+    *(gpio + gpioToREN [bcmGpioPin]) |=  bit ;
+  else
+    *(gpio + gpioToREN [bcmGpioPin]) &= ~bit ;
+
+  if ((mode == INT_EDGE_FALLING) || (mode == INT_EDGE_BOTH))
+    *(gpio + gpioToFEN [bcmGpioPin]) |=  bit ;
+  else
+    *(gpio + gpioToFEN [bcmGpioPin]) &= ~bit ;
+
+  pthread_mutex_lock (&emuIrqMutex) ;		// Clear anything stale
+  *(gpio + gpioToEDS [bcmGpioPin]) = bit ;
+  emuIrqPending [bcmGpioPin / 32] &= ~bit ;
+  pthread_mutex_unlock (&emuIrqMutex) ;
+}
+
+// Take the pin's edge from those the UIO reader collected
+
+static int emuUioWait (int bcmGpioPin, int mS)
+{
+  uint32_t bit = 1 << (bcmGpioPin & 31) ;
+  int bank = bcmGpioPin / 32 ;
+  struct timespec deadline ;
+  int ret = 1 ;
+
+  if (mS >= 0)
+  {
+    clock_gettime (CLOCK_REALTIME, &deadline) ;
+    deadline.tv_sec  += mS / 1000 ;
+    deadline.tv_nsec += (long)(mS % 1000) * 1000000L ;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_nsec -= 1000000000L ;
+      ++deadline.tv_sec ;
+    }
+  }
+
+  pthread_mutex_lock (&emuIrqMutex) ;
+  while ((emuIrqPending [bank] & bit) == 0)
+  {
+    if (mS < 0)
+      pthread_cond_wait (&emuIrqCond, &emuIrqMutex) ;
+    else if (pthread_cond_timedwait (&emuIrqCond, &emuIrqMutex, &deadline) == ETIMEDOUT)
+    {
+      ret = 0 ;
+      break ;
+    }
+  }
+  emuIrqPending [bank] &= ~bit ;
+  pthread_mutex_unlock (&emuIrqMutex) ;
+
+  return ret ;
+}
+
+static int emuWaitForInterrupt (int bcmGpioPin, int mS)
+{
+  uint32_t bit = 1 << (bcmGpioPin & 31) ;
+  unsigned int start = millis () ;
+  int left, pollUs = EMU_IRQ_POLL_MIN_US ;
+
+  if (emuUioOpen () != -1)
+    return emuUioWait (bcmGpioPin, mS) ;
+
+  for (;;)
+  {
+    if ((*(gpio + gpioToEDS [bcmGpioPin]) & bit) != 0)
+    {
+      *(gpio + gpioToEDS [bcmGpioPin]) = bit ;	// Write 1 to clear
+      return 1 ;
+    }
+
+    left = (mS < 0) ? -1 : mS - (int)(millis () - start) ;
+    if ((mS >= 0) && (left <= 0))
+      return 0 ;
+
+    if ((mS >= 0) && (pollUs > left * 1000))
+      pollUs = left * 1000 ;
+    delayMicroseconds (pollUs) ;
+    if ((pollUs *= 2) > EMU_IRQ_POLL_MAX_US)
+      pollUs = EMU_IRQ_POLL_MAX_US ;
+  }
+}
+
+
 /*
  * waitForInterrupt:
  *	Pi Specific.
@@ -1915,6 +2435,7 @@ unsigned int digitalReadByte2 (void)
  *	This is actually done via the /sys/class/gpio interface regardless of
  *	the wiringPi access mode in-use. Maybe sometime it might get a better
  *	way for a bit more efficiency.
+ *	Under QEMU it waits on the emulated event detect registers instead.
  *********************************************************************************
  */
 
@@ -1929,6 +2450,9 @@ int waitForInterrupt (int pin, int mS)
   else if (wiringPiMode == WPI_MODE_PHYS)
     pin = physToGpio [pin] ;
 
+  if (emuEdgeDetect ())
+    return emuWaitForInterrupt (pin, mS) ;
+
   if ((fd = sysFds [pin]) == -1)
     return -2 ;
 
@@ -2008,6 +2532,16 @@ int wiringPiISR (int pin, int mode, void (*function)(void))
   else
     bcmGpioPin = pin ;
 
+// Under QEMU program the emulated edge detect registers directly
+
+  if (emuEdgeDetect ())
+  {
+    if (mode != INT_EDGE_SETUP)
+      emuEdgeSetup (bcmGpioPin, mode) ;
+    (void)emuUioOpen () ;
+    goto startThread ;
+  }
+
 // Now export the pin and set the right edge
 //	We're going to use the gpio program to do this, so it assumes
 //	a full installation of wiringPi. It's a bit 'clunky', but it
@@ -2063,6 +2597,7 @@ int wiringPiISR (int pin, int mode, void (*function)(void))
   for (i = 0 ; i < count ; ++i)
     read (sysFds [bcmGpioPin], &c, 1) ;
 
+startThread:
   isrFunctions [pin] = function ;
 
   pthread_mutex_lock (&pinMutex) ;
@@ -2093,6 +2628,43 @@ static void initialiseEpoch (void)
 }
 
 
+/*
+ * emuDelayMicroseconds:
+ *	Under QEMU the guest CPU is far slower than a real Pi, so spinning on
+ *	gettimeofday () wastes the very cycles the emulator needs and still
+ *	overshoots. The guest's clock is QEMU's virtual clock, so instead we
+ *	sleep to an absolute CLOCK_MONOTONIC deadline: with -icount ...,sleep=off
+ *	QEMU then skips straight to the deadline while the guest is idle, and the
+ *	wait is both exact in guest time and free on the host. The default 50uS
+ *	of timer slack would swamp short waits, so it is dropped per thread.
+ *********************************************************************************
+ */
+
+static void emuDelayMicroseconds (unsigned int howLong)
+{
+  static __thread int slackSet = FALSE ;
+  struct timespec deadline ;
+
+  if (!slackSet)
+  {
+    prctl (PR_SET_TIMERSLACK, 1UL, 0, 0, 0) ;
+    slackSet = TRUE ;
+  }
+
+  clock_gettime (CLOCK_MONOTONIC, &deadline) ;
+  deadline.tv_sec  += howLong / 1000000 ;
+  deadline.tv_nsec += (long)(howLong % 1000000) * 1000L ;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_nsec -= 1000000000L ;
+    ++deadline.tv_sec ;
+  }
+
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+    ;
+}
+
+
 /*
  * delay:
  *	Wait for some number of milliseconds
@@ -2103,6 +2675,17 @@ void delay (unsigned int howLong)
 {
   struct timespec sleeper, dummy ;
 
+  if (piEmuProbe ())
+  {
+    while (howLong > 1000000)		// Keep the microsecond count in range
+    {
+      emuDelayMicroseconds (1000000000) ;
+      howLong -= 1000000 ;
+    }
+    emuDelayMicroseconds (howLong * 1000) ;
+    return ;
+  }
+
   sleeper.tv_sec  = (time_t)(howLong / 1000) ;
   sleeper.tv_nsec = (long)(howLong % 1000) * 1000000 ;
 
@@ -2132,6 +2715,12 @@ void delayMicrosecondsHard (unsigned int howLong)
 {
   struct timeval tNow, tLong, tEnd ;
 
+  if (piEmuProbe ())
+  {
+    emuDelayMicroseconds (howLong) ;
+    return ;
+  }
+
   gettimeofday (&tNow, NULL) ;
   tLong.tv_sec  = howLong / 1000000 ;
   tLong.tv_usec = howLong % 1000000 ;
@@ -2149,6 +2738,8 @@ void delayMicroseconds (unsigned int howLong)
 
   /**/ if (howLong ==   0)
     return ;
+  else if (piEmuProbe ())
+    emuDelayMicroseconds (howLong) ;
   else if (howLong  < 100)
     delayMicrosecondsHard (howLong) ;
   else
@@ -2301,6 +2892,8 @@ int wiringPiSetup (void)
   if ((int32_t)gpio == -1)
     return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (GPIO) failed: %s\n", strerror (errno)) ;
 
+  emuPvSetup (fd) ;
+
 //	PWM
 
   pwm = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_PWM) ;
@@ -199,11 +199,19 @@ extern          int  getAlt              (int pin) ;
 extern          void pwmToneWrite        (int pin, int freq) ;
 extern          void digitalWriteByte    (int value) ;
 extern unsigned int  digitalReadByte     (void) ;
+extern          void digitalWriteMask    (int bank, unsigned int set, unsigned int clr) ;
+extern unsigned int  digitalReadBank     (int bank) ;
 extern          void pwmSetMode          (int mode) ;
 extern          void pwmSetRange         (unsigned int range) ;
 extern          void pwmSetClock         (int divisor) ;
 extern          void gpioClockSet        (int pin, int freq) ;
 
+// Waveform generators in the emulated GPIO device (QEMU only)
+
+extern int  piEmuWaveStart      (int pin) ;
+extern void piEmuWaveSet        (int pin, unsigned int markNs, unsigned int spaceNs) ;
+extern void piEmuWaveStop       (int pin) ;
+
 // Interrupts
 //	(Also Pi hardware specific)
 